@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+# Generates gcode inputs for benchmarking gcgg. Each generator is deterministic, so the same arguments always give the
+# same file, and numbers taken from it can be reproduced.
+#
+#   python3 bench/generate.py dense_cylinder [layers] [segments] > dense_cylinder.gcode
+#   python3 bench/generate.py parse [lines] > parse.gcode
+
+import math
+import sys
+
+
+# A cylinder of 20 mm radius, each layer a single loop of very short segments with 6-decimal coordinates. Every loop is
+# one long run for arc fitting (reg_arc_gen) to accumulate, so this is dominated by arc_accumulator::consume_segment.
+# The defaults, 10 layers of 20000 segments, come to about 200k lines.
+def dense_cylinder(out, layers=10, segments=20000):
+    radius = 20.0
+    out.append("G21")
+    out.append("G90")
+    out.append("M83")
+    out.append("G28")
+    for layer in range(layers):
+        out.append(f"G0 Z{0.2 * (layer + 1):.3f} F1200")
+        out.append(f"G0 X{100 + radius:.4f} Y100 F9000")
+        extrude = 2 * math.pi * radius / segments * 0.05
+        for i in range(1, segments + 1):
+            angle = 2 * math.pi * i / segments
+            out.append(f"G1 X{100 + radius * math.cos(angle):.6f} Y{100 + radius * math.sin(angle):.6f} E{extrude:.5f} F1800")
+
+
+# Lines shaped like a slicer's moves, with every axis and a comment, that all stay where the first one put the head.
+# Nothing moves, so interpreting them makes nothing for the passes or the planner to work on, and the run is almost all
+# parsing. The default, 600k lines, comes to about 33 MiB.
+def parse(out, lines=600000):
+    out.append("G21")
+    out.append("G90")
+    out.append("M83")
+    out.append("G1 X100.000 Y100.000 Z0.200 F1800")
+    for i in range(lines):
+        out.append(f"G1 X100.000 Y100.000 Z0.200 E0.00000 F{1800 + (i % 600)} ; line {i}")
+
+
+generators = {
+    "dense_cylinder": dense_cylinder,
+    "parse": parse,
+}
+
+
+def main():
+    if len(sys.argv) < 2 or sys.argv[1] not in generators:
+        sys.stderr.write(f"usage: {sys.argv[0]} <{'|'.join(generators)}> [arguments...]\n")
+        return 1
+
+    out = []
+    generators[sys.argv[1]](out, *(int(arg) for arg in sys.argv[2:]))
+    sys.stdout.write("\n".join(out) + "\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+# Times one or more gcgg builds on the same input, and checks that they all write the same output. To measure a change,
+# build gcgg at the commit before it and at the commit itself, and pass both:
+#
+#   python3 bench/generate.py dense_cylinder > dense_cylinder.gcode
+#   python3 bench/run.py dense_cylinder.gcode before/gcgg after/gcgg
+#
+# Every run happens in a fresh directory, so nothing is read from a job cache (cache.directory is relative) and each
+# build's stats file, if it writes one, is its own. The best of --runs runs is reported, as the others only add noise
+# from the rest of the machine.
+#
+# Builds with stats.enable on also report how fast they parsed, from the parse stage of their stats file. Builds from
+# before there were stats can be compared on an input that's almost all parsing:
+#
+#   python3 bench/generate.py parse > parse.gcode
+#   python3 bench/run.py parse.gcode before/gcgg after/gcgg
+
+import argparse
+import filecmp
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def run(binary, input_path, work_dir):
+    output_path = os.path.join(work_dir, "out.gcode")
+    start = time.perf_counter()
+    result = subprocess.run([binary, input_path, output_path], cwd=work_dir, stdout=subprocess.DEVNULL)
+    seconds = time.perf_counter() - start
+    if result.returncode != 0:
+        sys.exit(f"{binary} failed with exit code {result.returncode}")
+    return seconds, output_path
+
+
+# The parse stage's throughput in MiB/s, from a stats file, or None if the build didn't write one.
+def parse_throughput(work_dir):
+    try:
+        with open(os.path.join(work_dir, "gcgg_stats.json")) as file:
+            stats = json.load(file)
+    except FileNotFoundError:
+        return None
+    for stage in stats["stages"]:
+        if stage["name"] == "parse" and "mib_per_second" in stage:
+            return stage["mib_per_second"]
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Times gcgg builds on the same input.")
+    parser.add_argument("input", help="gcode file to compile")
+    parser.add_argument("binaries", nargs="+", help="gcgg executables to compare")
+    parser.add_argument("--runs", type=int, default=3, help="runs of each build (default 3)")
+    args = parser.parse_args()
+
+    input_path = os.path.abspath(args.input)
+    megabytes = os.path.getsize(input_path) / (1024.0 * 1024.0)
+    print(f"{args.input}: {megabytes:.2f} MiB")
+
+    outputs = []
+    with tempfile.TemporaryDirectory() as root:
+        for index, binary in enumerate(args.binaries):
+            binary = os.path.abspath(binary)
+            times = []
+            parse_rates = []
+            for run_index in range(args.runs):
+                work_dir = os.path.join(root, f"{index}_{run_index}")
+                os.mkdir(work_dir)
+                seconds, output_path = run(binary, input_path, work_dir)
+                times.append(seconds)
+                parse_rate = parse_throughput(work_dir)
+                if parse_rate is not None:
+                    parse_rates.append(parse_rate)
+            kept = os.path.join(root, f"{index}.out")
+            shutil.move(output_path, kept)
+            outputs.append(kept)
+
+            print(f"{binary}: best {min(times):.3f} s, worst {max(times):.3f} s over {args.runs} runs")
+            if parse_rates:
+                print(f"  parsed at {max(parse_rates):.2f} MiB/s at best, {min(parse_rates):.2f} MiB/s at worst")
+
+        for index in range(1, len(outputs)):
+            same = filecmp.cmp(outputs[0], outputs[index], shallow=False)
+            print(f"output of {args.binaries[index]} {'matches' if same else 'DIFFERS FROM'} {args.binaries[0]}")
+
+
+if __name__ == "__main__":
+    main()
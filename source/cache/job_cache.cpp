@@ -0,0 +1,615 @@
+#include "gcgg.hpp"
+#include "job_cache.hpp"
+
+#include "output/gcode/gcode_out.hpp"
+#include "segment/arc.hpp"
+#include "segment/arc_accumulator.hpp"
+#include "segment/extrusion.hpp"
+#include "segment/extrusion_move.hpp"
+#include "segment/hop.hpp"
+#include "segment/linear.hpp"
+#include "segment/travel.hpp"
+#include "instruction/G28.hpp"
+#include "instruction/M104.hpp"
+#include "instruction/M106.hpp"
+#include "instruction/M107.hpp"
+#include "instruction/M109.hpp"
+#include "instruction/M140.hpp"
+#include "instruction/M190.hpp"
+#include "instruction/M84.hpp"
+
+#include <filesystem>
+#include <limits>
+
+namespace
+{
+  // Entry header: magic, version, the key, and the number of commands that follow.
+  static constexpr const uint8 magic[3] = { 'g', 'g', 'c' };
+  static constexpr const usize count_offset = 3 + 1 + 8 + 8;
+  static constexpr const usize header_size = count_offset + 8;
+
+  // Each command is written as its index in here, followed by whatever it serializes.
+  static constexpr const uint64 types[] = {
+    segments::travel::type,
+    segments::linear::type,
+    segments::hop::type,
+    segments::extrusion_move::type,
+    segments::extrusion::type,
+    segments::arc::type,
+    segments::arc_accumulator::type,
+    instructions::G28::type,
+    instructions::M104::type,
+    instructions::M106::type,
+    instructions::M107::type,
+    instructions::M109::type,
+    instructions::M140::type,
+    instructions::M190::type,
+    instructions::M84::type,
+  };
+  static constexpr const usize type_count = sizeof(types) / sizeof(types[0]);
+
+  static usize get_tag(uint64 type)
+  {
+    for (usize i = 0; i < type_count; ++i)
+    {
+      if (types[i] == type)
+      {
+        return i;
+      }
+    }
+    return type_count;
+  }
+
+  static gcgg::command * make_command(uint64 type, cache::deserializer & __restrict in, platform::arena & __restrict arena)
+  {
+    switch (type)
+    {
+    case segments::travel::type:
+      return arena.make<segments::travel>(in);
+    case segments::linear::type:
+      return arena.make<segments::linear>(in);
+    case segments::hop::type:
+      return arena.make<segments::hop>(in);
+    case segments::extrusion_move::type:
+      return arena.make<segments::extrusion_move>(in);
+    case segments::extrusion::type:
+      return arena.make<segments::extrusion>(in);
+    case segments::arc::type:
+      return arena.make<segments::arc>(in);
+    case segments::arc_accumulator::type:
+      return arena.make<segments::arc_accumulator>(in);
+    case instructions::G28::type:
+      return arena.make<instructions::G28>(in);
+    case instructions::M104::type:
+      return arena.make<instructions::M104>(in);
+    case instructions::M106::type:
+      return arena.make<instructions::M106>(in);
+    case instructions::M107::type:
+      return arena.make<instructions::M107>(in);
+    case instructions::M109::type:
+      return arena.make<instructions::M109>(in);
+    case instructions::M140::type:
+      return arena.make<instructions::M140>(in);
+    case instructions::M190::type:
+      return arena.make<instructions::M190>(in);
+    case instructions::M84::type:
+      return arena.make<instructions::M84>(in);
+    default:
+      return nullptr;
+    }
+  }
+
+  // FNV-1a, fed a value at a time.
+  class hasher final
+  {
+    uint64 hash_ = _fnv::offset_basis;
+
+  public:
+    template <typename T>
+    void add(const T & __restrict value) __restrict
+    {
+      if constexpr (std::is_same_v<T, vector3<>>)
+      {
+        add(value.x);
+        add(value.y);
+        add(value.z);
+      }
+      else if constexpr (std::is_enum_v<T>)
+      {
+        add(uint64(value));
+      }
+      else
+      {
+        static_assert(std::is_arithmetic_v<T>, "only plain values can be hashed");
+        uint8 bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        for (uint8 byte : bytes)
+        {
+          hash_ ^= byte;
+          hash_ *= _fnv::prime;
+        }
+      }
+    }
+
+    uint64 get() const __restrict
+    {
+      return hash_;
+    }
+  };
+
+  // Which of the optional passes could change anything in a layer.
+  struct layer_passes final
+  {
+    bool simplify = true;
+    bool corner_arcs = true;
+    bool fit_arcs = true;
+  };
+
+  // Works out, from the interpreted commands [begin, end), which of the enabled passes could change anything in them. Each
+  // test only errs towards a pass having work, and only reads config fields that the layer's key always takes.
+  //  - simplify needs two extrusion moves in a row.
+  //  - Corner arcs need two moves (with no delay between them) that turn by more than arc.min_angle. Simplifying can turn
+  //    extrusion moves, though, so any run that it might touch counts as well.
+  //  - Arc fitting needs a run of same-typed moves, each shorter than reg_arc_gen.max_segment_length. Corner arcs can
+  //    shorten moves, so with them, the moves can be any length.
+  static layer_passes find_layer_passes(const std::vector<gcgg::command *> & __restrict commands, usize begin, usize end, const config & __restrict cfg)
+  {
+    bool extrusion_run = false;
+    bool sharp_corner = false;
+    bool fit_run = false;
+
+    const segments::movement * __restrict prev_move = nullptr; // The last move since a delay.
+    const gcgg::command * __restrict prev_cmd = nullptr;
+    usize run_length = 0;
+    for (usize i = begin; i < end; ++i)
+    {
+      const gcgg::command * __restrict cmd = commands[i];
+      if (!segments::is_move(*cmd))
+      {
+        if (cmd->is_delay())
+        {
+          prev_move = nullptr;
+        }
+        prev_cmd = cmd;
+        run_length = 0;
+        continue;
+      }
+
+      const segments::movement * __restrict move = static_cast<const segments::movement * __restrict>(cmd);
+
+      if (cmd->get_type() == segments::extrusion_move::type && prev_cmd && prev_cmd->get_type() == segments::extrusion_move::type)
+      {
+        extrusion_run = true;
+      }
+
+      if (prev_move && !sharp_corner)
+      {
+        const real angle = prev_move->get_vector().normalized().angle_between(move->get_vector().normalized());
+        sharp_corner = !(angle <= cfg.arc.min_angle);
+      }
+
+      const bool short_move = cfg.arc.generate || move->get_vector().length() < cfg.reg_arc_gen.max_segment_length;
+      if (!short_move)
+      {
+        run_length = 0;
+      }
+      else if (prev_cmd && prev_cmd->get_type() == cmd->get_type() && run_length != 0)
+      {
+        ++run_length;
+      }
+      else
+      {
+        run_length = 1;
+      }
+      fit_run = fit_run || (run_length >= segments::arc_accumulator::min_segment_count);
+
+      prev_move = move;
+      prev_cmd = cmd;
+    }
+
+    layer_passes out;
+    out.simplify = cfg.simplify.enable && extrusion_run;
+    out.corner_arcs = cfg.arc.generate && (sharp_corner || out.simplify);
+    out.fit_arcs = cfg.reg_arc_gen.enable && fit_run;
+    return out;
+  }
+
+  // The fields that the passes read, and so the ones that a processed job (or layer) depends on. Only the passes that
+  // are enabled count, and with passes given, only those that could change anything in the layer. The fields that
+  // find_layer_passes reads are always taken, so that a layer that changes with them can't keep its key.
+  static void add_pass_config(hasher & __restrict out, const config & __restrict cfg, const layer_passes & __restrict passes = {})
+  {
+    out.add(cache::version);
+
+    out.add(cfg.options.all_no_extrude_as_travel);
+    out.add(cfg.options.junction_deviation);
+
+    out.add(cfg.extrusion.epsilon);
+
+    out.add(cfg.simplify.enable);
+    if (cfg.simplify.enable && passes.simplify)
+    {
+      out.add(cfg.simplify.tolerance);
+    }
+
+    out.add(cfg.arc.generate);
+    if (cfg.arc.generate)
+    {
+      out.add(cfg.arc.min_angle);
+      if (passes.corner_arcs)
+      {
+        out.add(cfg.arc.constant_speed);
+        out.add(uint64(cfg.arc.max_segments));
+        out.add(cfg.arc.max_angle);
+        out.add(cfg.arc.max_chord_error);
+        out.add(cfg.arc.radius);
+        out.add(cfg.arc.travel_radius);
+        out.add(cfg.arc.halve_travels);
+        out.add(cfg.arc.min_radius);
+        out.add(cfg.arc.constrain_radius);
+      }
+    }
+
+    out.add(cfg.smoothing.enable);
+    if (cfg.smoothing.enable)
+    {
+      out.add(cfg.smoothing.min_angle);
+      out.add(cfg.smoothing.new_angle);
+    }
+
+    out.add(cfg.reg_arc_gen.enable);
+    if (cfg.reg_arc_gen.enable)
+    {
+      out.add(cfg.reg_arc_gen.max_segment_length);
+      if (passes.fit_arcs)
+      {
+        out.add(cfg.reg_arc_gen.max_angle);
+        out.add(cfg.reg_arc_gen.max_angle_divergence);
+        out.add(cfg.reg_arc_gen.max_deviation);
+        out.add(cfg.reg_arc_gen.max_radius);
+      }
+    }
+
+    out.add(cfg.output.subdivide_arcs);
+    out.add(cfg.output.generate_G15);
+    out.add(cfg.output.generate_G02_G03);
+    out.add(cfg.output.arcs_support_Z);
+
+    out.add(cfg.defaults.acceleration);
+    out.add(cfg.defaults.extrusion_acceleration);
+    out.add(cfg.defaults.feedrate);
+    out.add(cfg.defaults.extrusion_feedrate);
+    out.add(cfg.defaults.jerk);
+    out.add(cfg.defaults.extrusion_jerk);
+  }
+
+  static uint64 hash_config(const config & __restrict cfg)
+  {
+    hasher out;
+    add_pass_config(out, cfg);
+
+    out.add(cfg.stream.enable);
+    out.add(uint64(cfg.stream.window_size));
+    out.add(uint64(cfg.stream.block_size));
+
+    out.add(cfg.estimate.enable);
+    out.add(cfg.estimate.per_layer);
+
+    out.add(cfg.verify.enable);
+    out.add(cfg.verify.position);
+    out.add(cfg.verify.extrusion);
+
+    out.add(cfg.cache.layers);
+
+    out.add(cfg.output.format);
+    out.add(uint64(cfg.output.flush_size));
+    out.add(cfg.output.background_io);
+    out.add(cfg.output.precision.x);
+    out.add(cfg.output.precision.y);
+    out.add(cfg.output.precision.z);
+    out.add(cfg.output.precision.e);
+    out.add(cfg.output.precision.f);
+    out.add(cfg.output.precision.r);
+    out.add(cfg.output.precision.hint);
+
+    return out.get();
+  }
+
+  // Writes the command's tag, and then the command. Returns false if it's one that can't be cached.
+  static bool serialize_command(cache::serializer & __restrict out, const gcgg::command & __restrict cmd)
+  {
+    const usize tag = get_tag(cmd.get_type());
+    if (tag == type_count)
+    {
+      return false;
+    }
+
+    out.write(uint8(tag));
+    cmd.serialize(out);
+    return true;
+  }
+
+  // Layers go in a directory of their own, as there are a lot more of them.
+  static std::string get_filename(const cache::key & __restrict key, const config & __restrict cfg, cache::entry kind)
+  {
+    char name[64];
+    sprintf(name, "%016llx-%016llx.ggc", (unsigned long long)key.input, (unsigned long long)key.config);
+    std::filesystem::path path = cfg.cache.directory;
+    if (kind == cache::entry::layer)
+    {
+      path /= "layers";
+    }
+    return (path / name).string();
+  }
+}
+
+gcgg::cache::key gcgg::cache::make_key(const std::string & __restrict input_filename, const config & __restrict cfg)
+{
+  // An input that can't be read hashes as empty, which is what processing it would make of it.
+  const platform::mapped_file input = { input_filename };
+
+  key out;
+  out.input = hash(std::string_view(input.data(), input.size()));
+  out.config = hash_config(cfg);
+  return out;
+}
+
+bool gcgg::cache::make_layer_key(
+  const std::vector<gcgg::command *> & __restrict commands,
+  usize begin,
+  usize end,
+  const config & __restrict cfg,
+  key & __restrict out
+)
+{
+  cache::serializer layer;
+  for (usize i = begin; i < end; ++i)
+  {
+    if (!serialize_command(layer, *commands[i]))
+    {
+      return false;
+    }
+  }
+
+  const auto & __restrict buffer = layer.get_buffer();
+  out.input = hash(std::string_view(reinterpret_cast<const char *>(buffer.data()), buffer.size()));
+
+  hasher config_hash;
+  add_pass_config(config_hash, cfg, find_layer_passes(commands, begin, end, cfg));
+  out.config = config_hash.get();
+  return true;
+}
+
+gcgg::cache::writer::writer(const key & __restrict key, const config & __restrict cfg, entry kind) :
+  report_(kind == entry::job)
+{
+  if (!cfg.cache.enable)
+  {
+    return;
+  }
+
+  filename_ = get_filename(key, cfg, kind);
+
+  std::error_code error;
+  std::filesystem::create_directories(std::filesystem::path(filename_).parent_path(), error);
+
+  temp_filename_ = filename_ + ".tmp";
+  file_ = fopen(temp_filename_.c_str(), "wb");
+  if (!file_)
+  {
+    printf("Failed to open cache entry: %s\n", temp_filename_.c_str());
+    return;
+  }
+
+  for (uint8 c : magic)
+  {
+    serializer_.write(c);
+  }
+  serializer_.write(version);
+  serializer_.write(key.input);
+  serializer_.write(key.config);
+  serializer_.write(uint64(0)); // The count, filled in by commit.
+
+  const auto & __restrict buffer = serializer_.get_buffer();
+  if (fwrite(buffer.data(), 1, buffer.size(), file_) != buffer.size())
+  {
+    printf("Failed to write cache entry: %s\n", temp_filename_.c_str());
+    close();
+  }
+  serializer_.clear();
+}
+
+gcgg::cache::writer::~writer()
+{
+  close();
+}
+
+void gcgg::cache::writer::close() __restrict
+{
+  if (file_)
+  {
+    fclose(file_);
+    file_ = nullptr;
+
+    std::error_code error;
+    std::filesystem::remove(temp_filename_, error);
+  }
+}
+
+void gcgg::cache::writer::write(const std::vector<gcgg::command *> & __restrict commands) __restrict
+{
+  if (!file_)
+  {
+    return;
+  }
+
+  for (const auto * __restrict cmd : commands)
+  {
+    if (!serialize_command(serializer_, *cmd))
+    {
+      printf("Not caching %s: it has commands that can't be cached\n", filename_.c_str());
+      close();
+      return;
+    }
+  }
+  count_ += commands.size();
+
+  const auto & __restrict buffer = serializer_.get_buffer();
+  if (fwrite(buffer.data(), 1, buffer.size(), file_) != buffer.size())
+  {
+    printf("Failed to write cache entry: %s\n", temp_filename_.c_str());
+    close();
+  }
+  serializer_.clear();
+}
+
+bool gcgg::cache::writer::commit() __restrict
+{
+  if (!file_)
+  {
+    return false;
+  }
+
+  const uint64 count = count_;
+  const bool written =
+    fseek(file_, long(count_offset), SEEK_SET) == 0 &&
+    fwrite(&count, sizeof(count), 1, file_) == 1;
+  const bool closed = fclose(file_) == 0;
+  file_ = nullptr;
+
+  std::error_code error;
+  if (written && closed)
+  {
+    std::filesystem::rename(temp_filename_, filename_, error);
+  }
+  if (!written || !closed || error)
+  {
+    printf("Failed to write cache entry: %s\n", filename_.c_str());
+    std::filesystem::remove(temp_filename_, error);
+    return false;
+  }
+
+  if (report_)
+  {
+    printf("Cached %llu commands in %s\n", (unsigned long long)count, filename_.c_str());
+  }
+  return true;
+}
+
+gcgg::cache::reader::reader(const key & __restrict key, const config & __restrict cfg, entry kind) :
+  file_(get_filename(key, cfg, kind))
+{
+  if (!file_.is_open())
+  {
+    error_ = "no entry";
+    return;
+  }
+
+  const uint8 * begin = reinterpret_cast<const uint8 *>(file_.begin());
+  const uint8 * end = reinterpret_cast<const uint8 *>(file_.end());
+  if (usize(end - begin) < header_size)
+  {
+    error_ = "too short for a header";
+    return;
+  }
+
+  cache::deserializer header = { begin, begin + header_size };
+  bool matches = true;
+  for (uint8 c : magic)
+  {
+    matches = matches && header.read<uint8>() == c;
+  }
+  matches = matches && header.read<uint8>() == version;
+  matches = matches && header.read<uint64>() == key.input;
+  matches = matches && header.read<uint64>() == key.config;
+  if (!matches)
+  {
+    error_ = "not an entry for this job";
+    return;
+  }
+
+  count_ = usize(header.read<uint64>());
+  deserializer_ = { begin + header_size, end };
+}
+
+bool gcgg::cache::reader::read(std::vector<gcgg::command *> & __restrict out, platform::arena & __restrict arena, usize max_count) __restrict
+{
+  if (error_)
+  {
+    return false;
+  }
+
+  const usize count = min(max_count, count_ - read_);
+  out.reserve(out.size() + count);
+  for (usize i = 0; i < count; ++i)
+  {
+    const uint8 tag = deserializer_.read<uint8>();
+    gcgg::command * cmd = (tag < type_count) ? make_command(types[tag], deserializer_, arena) : nullptr;
+    if (!cmd || !deserializer_.is_valid())
+    {
+      error_ = "malformed entry";
+      return false;
+    }
+    out.push_back(cmd);
+  }
+  read_ += count;
+
+  if (at_end() && !deserializer_.at_end())
+  {
+    error_ = "malformed entry";
+    return false;
+  }
+
+  return true;
+}
+
+gcgg::cache::cached_output gcgg::cache::write_cached(const key & __restrict key, const std::string & __restrict out_filename, const config & __restrict cfg)
+{
+  reader entry = { key, cfg };
+  if (!entry.is_valid())
+  {
+    return cached_output::missing;
+  }
+
+  printf("Writing from the cache: %s\n", get_filename(key, cfg, entry::job).c_str());
+
+  const auto malformed = [&]()
+  {
+    printf("Cache entry is unreadable (%s), compiling...\n", entry.get_error());
+    return cached_output::missing;
+  };
+
+  if (!cfg.stream.enable)
+  {
+    platform::arena arena;
+    std::vector<gcgg::command *> commands;
+    if (!entry.read(commands, arena, std::numeric_limits<usize>::max()))
+    {
+      return malformed();
+    }
+
+    printf("Outputing...\n");
+    return output::write_gcode(out_filename, commands, cfg) ? cached_output::written : cached_output::failed;
+  }
+
+  output::gcode_writer writer = { out_filename, cfg };
+  if (!writer.is_open())
+  {
+    return cached_output::failed;
+  }
+
+  platform::arena arena;
+  std::vector<gcgg::command *> window;
+  while (!entry.at_end())
+  {
+    window.clear();
+    if (!entry.read(window, arena, max(cfg.stream.window_size, usize(1))))
+    {
+      return malformed();
+    }
+    writer.write(window);
+    arena.reset();
+  }
+
+  return writer.close() ? cached_output::written : cached_output::failed;
+}
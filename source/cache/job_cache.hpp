@@ -0,0 +1,123 @@
+#pragma once
+
+#include "command.hpp"
+#include "config.hpp"
+#include "platform/arena.hpp"
+#include "platform/mapped_file.hpp"
+
+namespace gcgg::cache
+{
+  // A cached job is the processed command stream, exactly as it went to output, with each command serialized by its
+  // serialize and read back by its cache::deserializer constructor. Entries are named after their key, so a changed input
+  // or config simply misses.
+  //
+  // The key can't see the code that did the processing, so this has to be bumped along with any change to the passes that
+  // changes what they produce, or to how a command serializes itself.
+  static constexpr const uint8 version = 1;
+
+  struct key final
+  {
+    uint64 input = 0; // The input's bytes.
+    uint64 config = 0; // Every config field, other than cache.enable, cache.directory and stats.
+  };
+
+  // What an entry holds: a whole job, ready for output, or a single layer of one (see cache.layers), with the passes run
+  // over it but its motion not yet planned.
+  enum class entry
+  {
+    job = 0,
+    layer,
+  };
+
+  extern key make_key(const std::string & __restrict input_filename, const config & __restrict cfg);
+
+  // The key of the layer of commands [begin, end): the commands themselves, as interpreted, and only the config fields
+  // that the passes read. Returns false if the layer has commands that can't be cached.
+  extern bool make_layer_key(
+    const std::vector<gcgg::command *> & __restrict commands,
+    usize begin,
+    usize end,
+    const config & __restrict cfg,
+    key & __restrict out
+  );
+
+  // Writes a job's commands into the cache as they're handed to it. The entry is written under a temporary name and only
+  // takes its real one on commit, so a job that fails or is cut short never leaves a partial entry behind.
+  // Does nothing unless cache.enable is set.
+  class writer final
+  {
+    std::string filename_;
+    std::string temp_filename_;
+    FILE * __restrict file_ = nullptr;
+    cache::serializer serializer_;
+    usize count_ = 0;
+    bool report_ = false;
+
+    void close() __restrict;
+
+  public:
+    writer(const key & __restrict key, const config & __restrict cfg, entry kind = entry::job);
+    ~writer();
+
+    writer(const writer &) = delete;
+    writer & operator = (const writer &) = delete;
+
+    bool is_open() const __restrict
+    {
+      return file_ != nullptr;
+    }
+
+    void write(const std::vector<gcgg::command *> & __restrict commands) __restrict;
+    // Finishes the entry. Returns false if it couldn't be written.
+    bool commit() __restrict;
+  };
+
+  // Reads a job's commands back out of the cache.
+  class reader final
+  {
+    platform::mapped_file file_;
+    cache::deserializer deserializer_;
+    usize count_ = 0; // Commands in the entry.
+    usize read_ = 0;
+    const char * error_ = nullptr;
+
+  public:
+    reader(const key & __restrict key, const config & __restrict cfg, entry kind = entry::job);
+
+    reader(const reader &) = delete;
+    reader & operator = (const reader &) = delete;
+
+    // False if there's no entry, or it's unreadable.
+    bool is_valid() const __restrict
+    {
+      return error_ == nullptr;
+    }
+
+    const char * get_error() const __restrict
+    {
+      return error_;
+    }
+
+    bool at_end() const __restrict
+    {
+      return read_ == count_;
+    }
+
+    // Makes up to max_count of the entry's commands in the arena and appends them to out. Returns false if the entry
+    // turned out to be malformed.
+    bool read(std::vector<gcgg::command *> & __restrict out, platform::arena & __restrict arena, usize max_count) __restrict;
+  };
+
+  // What came of writing a job from the cache.
+  enum class cached_output
+  {
+    missing = 0, // There's no entry, or it couldn't be read, so the job has to be compiled.
+    written,
+    failed, // The output file couldn't be written. Compiling the job wouldn't help.
+  };
+
+  // Writes a job's output straight from its cache entry, if there is one, with output::write_gcode (or a window at a time,
+  // when streaming). If the entry turns out to be unreadable, the output file may have been started on, but a compiled
+  // job overwrites it.
+  extern cached_output write_cached(const key & __restrict key, const std::string & __restrict out_filename, const config & __restrict cfg);
+}
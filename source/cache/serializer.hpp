@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace gcgg::cache
+{
+  // The hints a movement carries. A job only has a handful of different ones, so each is written once, and then referred to
+  // by its index in the palette.
+  struct hints final
+  {
+    vector3<> acceleration;
+    real acceleration_hint = 0.0;
+    vector3<> jerk;
+    real extrude_jerk = 0.0;
+
+    bool operator == (const hints & __restrict other) const __restrict
+    {
+      return
+        acceleration == other.acceleration &&
+        acceleration_hint == other.acceleration_hint &&
+        jerk == other.jerk &&
+        extrude_jerk == other.extrude_jerk;
+    }
+  };
+
+  // Hints are referred to by their index in the palette. This index means that new ones follow.
+  static constexpr const uint8 new_hints = 0xFF;
+
+  // Values are written as they are in memory: a cache is only ever read back by the build that wrote it (see
+  // cache::version).
+  class serializer final
+  {
+    std::vector<uint8> buffer_;
+    std::vector<cache::hints> palette_;
+
+  public:
+    // Where the last movement ended, and how fast. Movements compare themselves against these.
+    vector3<> position;
+    real feedrate = 0.0;
+    real exit_feedrate = 0.0;
+
+    template <typename T>
+    void write(const T & __restrict value) __restrict
+    {
+      if constexpr (std::is_same_v<T, vector3<>>)
+      {
+        write(value.x);
+        write(value.y);
+        write(value.z);
+      }
+      else
+      {
+        static_assert(std::is_arithmetic_v<T>, "only plain values can be serialized");
+        uint8 bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        buffer_.insert(buffer_.end(), bytes, bytes + sizeof(T));
+      }
+    }
+
+    void write_hints(const cache::hints & __restrict hints) __restrict
+    {
+      for (usize i = 0; i < palette_.size(); ++i)
+      {
+        if (palette_[i] == hints)
+        {
+          write(uint8(i));
+          return;
+        }
+      }
+
+      write(new_hints);
+      write(hints.acceleration);
+      write(hints.acceleration_hint);
+      write(hints.jerk);
+      write(hints.extrude_jerk);
+      if (palette_.size() < new_hints)
+      {
+        palette_.push_back(hints);
+      }
+    }
+
+    const std::vector<uint8> & get_buffer() const __restrict
+    {
+      return buffer_;
+    }
+
+    // Drops what's been written, but keeps the palette and the last movement for the next commands.
+    void clear() __restrict
+    {
+      buffer_.clear();
+    }
+  };
+
+  class deserializer final
+  {
+    const uint8 * cur_ = nullptr;
+    const uint8 * end_ = nullptr;
+    bool valid_ = true;
+    std::vector<cache::hints> palette_;
+
+  public:
+    vector3<> position;
+    real feedrate = 0.0;
+    real exit_feedrate = 0.0;
+
+    deserializer() = default;
+    deserializer(const uint8 * __restrict begin, const uint8 * __restrict end) : cur_(begin), end_(end) {}
+
+    // Reading past the end leaves the deserializer invalid, and reads zeros.
+    template <typename T>
+    T read() __restrict
+    {
+      if constexpr (std::is_same_v<T, vector3<>>)
+      {
+        const real x = read<real>();
+        const real y = read<real>();
+        const real z = read<real>();
+        return { x, y, z };
+      }
+      else
+      {
+        static_assert(std::is_arithmetic_v<T>, "only plain values can be serialized");
+        T value = T(0);
+        if (usize(end_ - cur_) < sizeof(T))
+        {
+          valid_ = false;
+          cur_ = end_;
+          return value;
+        }
+        std::memcpy(&value, cur_, sizeof(T));
+        cur_ += sizeof(T);
+        return value;
+      }
+    }
+
+    cache::hints read_hints() __restrict
+    {
+      const uint8 index = read<uint8>();
+      if (index != new_hints)
+      {
+        if (index >= palette_.size())
+        {
+          valid_ = false;
+          return {};
+        }
+        return palette_[index];
+      }
+
+      cache::hints hints;
+      hints.acceleration = read<vector3<>>();
+      hints.acceleration_hint = read<real>();
+      hints.jerk = read<vector3<>>();
+      hints.extrude_jerk = read<real>();
+      if (palette_.size() < new_hints)
+      {
+        palette_.push_back(hints);
+      }
+      return hints;
+    }
+
+    bool is_valid() const __restrict
+    {
+      return valid_;
+    }
+
+    bool at_end() const __restrict
+    {
+      return cur_ == end_;
+    }
+  };
+}
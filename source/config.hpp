@@ -1,101 +1,179 @@
-#pragma once
-
-namespace gcgg
-{
-  struct config final
-  {
-    struct
-    {
-      bool all_no_extrude_as_travel = true;
-      bool brute_force_feedrate = true;
-    } options;
-
-    struct
-    {
-      real epsilon = 0.1; // 0.02;
-    } extrusion;
-
-    struct
-    {
-      bool generate = false;
-      bool constant_speed = true; // Should the arc only allow a constant speed across it?
-      usize max_segments = 100000;
-      real max_angle = 170.0;
-      real min_angle = 30.0; // 45 degrees
-      real radius = 0.1; // The radius of the circle of the arc. Also equal to how much of a linear segment is 'cut off' from the corner.
-      real travel_radius = 0.8; // Travels can have a much larger radius.so cl
-      bool halve_travels = false;
-      real min_radius = 0.05; // might need to be smaller... or larger.
-      bool constrain_radius = true; // Should we constrain the radius to the original vertex position?
-    } arc;
-
-    struct
-    {
-      bool enable = false; // Should we try to smooth certain angles no matter what?
-      real min_angle = 20.0;
-      real new_angle = 5.0;
-    } smoothing;
-
-    struct
-    {
-      bool enable = true;
-      real max_angle = 10.0; // this is the max angle that it will consider from the difference between two points for if they are part of a circle-arc or not.
-      real max_angle_divergence = 10.0; // Max difference from an arc's mean angle that we will allow.
-      real max_segment_length = 5.0; // max segment length we will consider for arcs.
-    } reg_arc_gen;
-
-    enum class format
-    {
-      gcode = 0,
-      gcode2
-    };
-
-    struct
-    {
-      format format = format::gcode;
-      bool subdivide_arcs = true; // Should we turn arcs into sets of segments?
-
-      bool generate_G15 = false; // G15 is a custom instruction that generates a movement arc. Not the same as a controlled arc.
-      bool generate_G02_G03 = true;
-      bool arcs_support_Z = false;
-    } output;
-
-    struct
-    {
-      vector3<> acceleration = { 2000, 1500, 400 };
-      real extrusion_acceleration = 4000;
-      vector3<> feedrate = vector3<>{200.0, 150.0, 80.0} * 60.0;
-      real extrusion_feedrate = 200 * 60;
-      vector3<> jerk = { 20, 20, 20 };
-      real extrusion_jerk = 20;
-    } defaults;
-  };
-}
-
-/*
-echo:Filament settings: Disabled
-echo:  M200 D1.75
-echo:  M200 D0
-echo:Steps per unit:
-echo:  M92 X160.00 Y200.00 Z400.00 E88.78
-echo:Maximum feedrates (units/s):
-echo:  M203 X200.00 Y150.00 Z80.00 E200.00
-echo:Maximum Acceleration (units/s2):
-echo:  M201 X2000 Y1500 Z400 E4000
-echo:Acceleration (units/s2): P<print_accel> R<retract_accel> T<travel_accel>
-echo:  M204 P4000.00 R1200.00 T4000.00
-echo:Advanced: S<min_feedrate> T<min_travel_feedrate> B<min_segment_time_ms> X<max_xy_jerk> Z<max_z_jerk> E<max_e_jerk>
-echo:  M205 S0.00 T0.00 B20000 X20.00 Y20.00 Z0.00 E0.00
-echo:Home offset:
-echo:  M206 X0.00 Y0.00 Z0.00
-echo:PID settings:
-echo:
-echo:Retract: S<length> F<units/m> Z<lift>
-echo:  M207 S2.00 F12000.00 Z0.00
-echo:Recover: S<length> F<units/m>
-echo:  M208 S0.00 F12000.00
-echo:Auto-Retract: S=0 to disable, 1 to interpret extrude-only moves as retracts or recoveries
-echo:  M209 S0
-echo:Linear Advance:
-echo:  M900 K42.50 R0.00
-*/
+#pragma once
+
+namespace gcgg
+{
+  struct config final
+  {
+    struct
+    {
+      bool all_no_extrude_as_travel = true;
+      real junction_deviation = 0.0; // mm. If set, corner speeds come from junction deviation rather than per-axis jerk.
+    } options;
+
+    struct
+    {
+      real epsilon = 0.1; // 0.02;
+    } extrusion;
+
+    // Douglas-Peucker simplification of runs of extrusion moves: vertices within tolerance of the line between the
+    // vertices kept either side of them are dropped, as long as the flow rate stays within extrusion.epsilon. The
+    // filament extruded is kept exactly.
+    struct
+    {
+      bool enable = false;
+      real tolerance = 0.01; // mm
+    } simplify;
+
+    // Streaming runs the pipeline over a window of the input at a time, so memory use doesn't grow with the file.
+    // Windows are cut where merging and arc fitting couldn't have joined commands across the cut, so their output matches
+    // a full run. Corner arcs and motion planning can't see past a window, though: a corner at a cut isn't rounded, and a
+    // cut that isn't at a delay is planned as if the machine stopped there.
+    struct
+    {
+      bool enable = false;
+      usize window_size = 16384; // Interpreted commands to accumulate before cutting a window.
+      usize block_size = 256 * 1024; // Bytes of input parsed at a time.
+    } stream;
+
+    // Print time and filament estimates, worked out from the planned motion before and after the optimization passes.
+    struct
+    {
+      bool enable = false;
+      bool per_layer = false; // Also report the time and filament of every layer.
+    } estimate;
+
+    // Checks gg output against the gcode it was compiled from, once it's written (see output/gg/verify.hpp).
+    struct
+    {
+      bool enable = false;
+      real position = 0.01; // mm
+      real extrusion = 0.001; // A fraction of the filament fed up to that point.
+    } verify;
+
+    // Keeps the processed commands of every job on disk, keyed on the contents of the input and on every other field
+    // here, so that a job that's been compiled before goes straight to output (see cache/job_cache.hpp). Any field added
+    // to config has to be added to the key in cache/job_cache.cpp, too.
+    //
+    // With layers, every layer of a job that misses is also cached on its own, keyed on its interpreted commands and on
+    // the config fields of the passes that could change anything in it, so that a job that's only changed in places (or
+    // a field that only matters to some layers) is only reprocessed where it has to be. Layers end at a change of Z, where
+    // nothing could be joined across them (with arc.generate, that takes a corner that wouldn't be rounded), so the
+    // output is the same as without them. Motion is still planned over the whole job. Streaming doesn't use them.
+    struct
+    {
+      bool enable = false;
+      bool layers = false;
+      const char * directory = "gcgg_cache";
+    } cache;
+
+    // Times every stage of a job and counts what the passes did, and writes it all out as JSON once the job's done (see
+    // stats/stats.hpp). It doesn't change the output, so it isn't part of the cache key.
+    struct
+    {
+      bool enable = false;
+      const char * filename = "gcgg_stats.json";
+    } stats;
+
+    struct
+    {
+      bool generate = false;
+      bool constant_speed = true; // Should the arc only allow a constant speed across it?
+      usize max_segments = 100000;
+      real max_angle = 170.0;
+      real min_angle = 30.0; // 45 degrees
+      real max_chord_error = 0.005; // mm. How far the segments of a subdivided arc may stray from the arc.
+      real radius = 0.1; // The radius of the circle of the arc. Also equal to how much of a linear segment is 'cut off' from the corner.
+      real travel_radius = 0.8; // Travels can have a much larger radius.so cl
+      bool halve_travels = false;
+      real min_radius = 0.05; // might need to be smaller... or larger.
+      bool constrain_radius = true; // Should we constrain the radius to the original vertex position?
+    } arc;
+
+    struct
+    {
+      bool enable = false; // Should we try to smooth certain angles no matter what?
+      real min_angle = 20.0;
+      real new_angle = 5.0;
+    } smoothing;
+
+    struct
+    {
+      bool enable = true;
+      real max_angle = 10.0; // this is the max angle that it will consider from the difference between two points for if they are part of a circle-arc or not.
+      real max_angle_divergence = 10.0; // Max difference from an arc's mean angle that we will allow.
+      real max_segment_length = 5.0; // max segment length we will consider for arcs.
+      real max_deviation = 0.02; // mm. How far a fitted arc may stray from the segments it replaces.
+      real max_radius = 1000.0; // mm. Runs that are all but straight fit huge circles, which firmware handles badly.
+    } reg_arc_gen;
+
+    enum class format
+    {
+      gcode = 0,
+      gcode2,
+      gg, // Binary, see output/gg/format.hpp.
+    };
+
+    struct
+    {
+      config::format format = config::format::gcode;
+      bool subdivide_arcs = true; // Should we turn arcs into sets of segments?
+
+      bool generate_G15 = false; // G15 is a custom instruction that generates a movement arc. Not the same as a controlled arc.
+      bool generate_G02_G03 = true;
+      bool arcs_support_Z = false; // Helical G2/G3: lets arc fitting take in moves that climb on Z at a constant rate.
+
+      usize flush_size = 1024 * 1024; // Bytes of gcode buffered before being written to the file.
+      bool background_io = true; // Write to the file from a separate thread, so that formatting never waits on the disk.
+
+      // Decimal places written for each kind of value. Trailing zeros are always trimmed.
+      struct
+      {
+        uint x = 8;
+        uint y = 8;
+        uint z = 8;
+        uint e = 8; // Extrusion
+        uint f = 8; // Feedrates
+        uint r = 8; // Arc radii
+        uint hint = 8; // Acceleration and jerk
+      } precision;
+    } output;
+
+    struct
+    {
+      vector3<> acceleration = { 2000, 1500, 400 };
+      real extrusion_acceleration = 4000;
+      vector3<> feedrate = vector3<>{200.0, 150.0, 80.0} * 60.0;
+      real extrusion_feedrate = 200 * 60;
+      vector3<> jerk = { 20, 20, 20 };
+      real extrusion_jerk = 20;
+    } defaults;
+  };
+}
+
+/*
+echo:Filament settings: Disabled
+echo:  M200 D1.75
+echo:  M200 D0
+echo:Steps per unit:
+echo:  M92 X160.00 Y200.00 Z400.00 E88.78
+echo:Maximum feedrates (units/s):
+echo:  M203 X200.00 Y150.00 Z80.00 E200.00
+echo:Maximum Acceleration (units/s2):
+echo:  M201 X2000 Y1500 Z400 E4000
+echo:Acceleration (units/s2): P<print_accel> R<retract_accel> T<travel_accel>
+echo:  M204 P4000.00 R1200.00 T4000.00
+echo:Advanced: S<min_feedrate> T<min_travel_feedrate> B<min_segment_time_ms> X<max_xy_jerk> Z<max_z_jerk> E<max_e_jerk>
+echo:  M205 S0.00 T0.00 B20000 X20.00 Y20.00 Z0.00 E0.00
+echo:Home offset:
+echo:  M206 X0.00 Y0.00 Z0.00
+echo:PID settings:
+echo:
+echo:Retract: S<length> F<units/m> Z<lift>
+echo:  M207 S2.00 F12000.00 Z0.00
+echo:Recover: S<length> F<units/m>
+echo:  M208 S0.00 F12000.00
+echo:Auto-Retract: S=0 to disable, 1 to interpret extrude-only moves as retracts or recoveries
+echo:  M209 S0
+echo:Linear Advance:
+echo:  M900 K42.50 R0.00
+*/
@@ -1,3 +1,3 @@
-/* GCGG Precompiled Header Source File */
-
-#include "gcgg.hpp"
+/* GCGG Precompiled Header Source File */
+
+#include "gcgg.hpp"
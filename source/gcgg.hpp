@@ -1,5 +1,5 @@
-#pragma once
-
-#include "platform/platform.hpp"
-
-using namespace gcgg;
+#pragma once
+
+#include "platform/platform.hpp"
+
+using namespace gcgg;
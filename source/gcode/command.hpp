@@ -1,93 +1,83 @@
-#pragma once
-
-namespace gcgg::gc
-{
-  struct command
-  {
-    std::string _cmd_string;
-    std::unordered_map<std::string, real> _arguments;
-
-    bool has_argument(const std::string & __restrict key) const __restrict
-    {
-      return _arguments.find(key) != _arguments.end();
-    }
-
-    bool has_argument_not(const std::string & __restrict key, real comparand) const __restrict
-    {
-      const auto iter = _arguments.find(key);
-      if (iter == _arguments.end())
-      {
-        return false;
-      }
-      return iter->second != comparand;
-    }
-
-    template <typename T = real>
-    T get_argument(const std::string & __restrict key, T default_value = T(0)) const __restrict;
-
-    template <>
-    real get_argument<real>(const std::string & __restrict key, real default_value) const __restrict
-    {
-      const auto iter = _arguments.find(key);
-      if (iter == _arguments.end())
-      {
-        return default_value;
-      }
-      return iter->second;
-    }
-
-    template <>
-    uint get_argument<uint>(const std::string & __restrict key, uint default_value) const __restrict
-    {
-      const auto iter = _arguments.find(key);
-      if (iter == _arguments.end())
-      {
-        return default_value;
-      }
-      if (iter->second < 0.0)
-      {
-        printf("unsigned integer argument is less than 0. Aborting.");
-        exit(1);
-      }
-      return uint(llround(iter->second));
-    }
-
-    template <>
-    int get_argument<int>(const std::string & __restrict key, int default_value) const __restrict
-    {
-      const auto iter = _arguments.find(key);
-      if (iter == _arguments.end())
-      {
-        return default_value;
-      }
-      return int(llround(iter->second));
-    }
-
-    template <>
-    uint64 get_argument<uint64>(const std::string & __restrict key, uint64 default_value) const __restrict
-    {
-      const auto iter = _arguments.find(key);
-      if (iter == _arguments.end())
-      {
-        return default_value;
-      }
-      if (iter->second < 0.0)
-      {
-        printf("unsigned integer argument is less than 0. Aborting.");
-        exit(1);
-      }
-      return uint64(llround(iter->second));
-    }
-
-    template <>
-    int64 get_argument<int64>(const std::string & __restrict key, int64 default_value) const __restrict
-    {
-      const auto iter = _arguments.find(key);
-      if (iter == _arguments.end())
-      {
-        return default_value;
-      }
-      return int64(llround(iter->second));
-    }
-  };
-}
+#pragma once
+
+#include <type_traits>
+#include <string_view>
+
+namespace gcgg::gc
+{
+  // A parsed line of gcode. The command string is a view into the input file mapping, so a command must not outlive the gcode object that parsed it.
+  struct command
+  {
+    // gcode arguments are single letters, so they're kept in a slot per letter with a mask of which ones were present.
+    static constexpr const uint max_arguments = 26;
+
+    std::string_view _cmd_string;
+    uint64 _cmd_id = 0; // hash() of _cmd_string, computed once at parse time.
+    uint32 _argument_mask = 0;
+    real _arguments[max_arguments];
+
+    // Keys are case-insensitive. Returns max_arguments for anything that isn't a letter.
+    static constexpr uint argument_index(char key)
+    {
+      const uint index = uint8((key | 0x20) - 'a');
+      return (index < max_arguments) ? index : max_arguments;
+    }
+
+    void set_argument(char key, real value) __restrict
+    {
+      const uint index = argument_index(key);
+      if (index == max_arguments)
+      {
+        return;
+      }
+      _argument_mask |= (uint32(1) << index);
+      _arguments[index] = value;
+    }
+
+    bool has_argument(char key) const __restrict
+    {
+      const uint index = argument_index(key);
+      return (index != max_arguments) && (_argument_mask & (uint32(1) << index)) != 0;
+    }
+
+    bool has_argument_not(char key, real comparand) const __restrict
+    {
+      if (!has_argument(key))
+      {
+        return false;
+      }
+      return _arguments[argument_index(key)] != comparand;
+    }
+
+    // Explicit specializations at class scope are an MSVC extension, so the integer conversions are selected with if constexpr instead.
+    template <typename T = real>
+    T get_argument(char key, T default_value = T(0)) const __restrict
+    {
+      static_assert(std::is_same_v<T, real> || std::is_integral_v<T>, "get_argument only supports real and integer arguments");
+
+      if (!has_argument(key))
+      {
+        return default_value;
+      }
+
+      const real value = _arguments[argument_index(key)];
+
+      if constexpr (std::is_same_v<T, real>)
+      {
+        return value;
+      }
+      else
+      {
+        if constexpr (std::is_unsigned_v<T>)
+        {
+          if (value < 0.0)
+          {
+            printf("unsigned integer argument is less than 0. Aborting.");
+            exit(1);
+          }
+        }
+        return T(llround(value));
+      }
+    }
+  };
+}
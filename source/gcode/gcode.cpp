@@ -1,1150 +1,2023 @@
-#include "gcgg.hpp"
-#include "gcode.hpp"
-
-#include "segment/extrusion.hpp"
-#include "segment/extrusion_move.hpp"
-#include "segment/hop.hpp"
-#include "segment/linear.hpp"
-#include "segment/travel.hpp"
-#include "segment/arc.hpp"
-#include "segment/arc_accumulator.hpp"
-
-#include "instruction/M84.hpp"
-#include "instruction/M104.hpp"
-#include "instruction/M106.hpp"
-#include "instruction/M107.hpp"
-#include "instruction/M109.hpp"
-#include "instruction/M140.hpp"
-#include "instruction/M190.hpp"
-
-#include "instruction/G28.hpp"
-
-#include "config.hpp"
-
-#include <cstdio>
-#include <cctype>
-
-#include <list>
-
-gcode::gcode(const std::string &__restrict filename)
-{
-  FILE *fp = fopen(filename.c_str(), "rb");
-  if (!fp)
-  {
-    xassert(false); // TODO
-  }
-  fseek(fp, 0, SEEK_END);
-  usize file_size = ftell(fp);
-  rewind(fp);
-
-  std::vector<char> file_data;
-  file_data.resize(file_size);
-  fread(file_data.data(), 1, file_size, fp);
-  fclose(fp);
-
-  const auto tokens = tokenize(file_data);
-  auto parsed_cmds = parse(tokens);
-  commands_ = std::move(parsed_cmds);
-}
-
-gcode::~gcode()
-{
-}
-
-namespace
-{
-  static bool is_newline(char c)
-  {
-    return c == '\r' || c == '\n';
-  }
-
-  static bool is_space(char c)
-  {
-    return std::isspace(c) != 0;
-  }
-}
-
-gcode::token_vector gcode::tokenize(const std::vector<char> &__restrict data)
-{
-  printf("Tokenizing gcode\n");
-
-  static constexpr const char comment_char = ';';
-
-  // Derived by testing with my files. Probably needs to be different for other real world files.
-  static constexpr const usize mean_token_length = 24;
-
-  gcode::token_vector out;
-  out.reserve(data.size() / mean_token_length);
-
-  command_token cmd_token;
-  cmd_token.reserve(10);
-  std::string token;
-  const auto push_token = [&]()
-  {
-    if (token.length())
-    {
-      cmd_token.push_back(token);
-      token.clear();
-    }
-  };
-
-  const auto push_cmd_token = [&]()
-  {
-    if (cmd_token.size())
-    {
-      out.push_back(cmd_token);
-      cmd_token.clear();
-    }
-  };
-
-  bool in_comment = false;
-
-  for (const char c : data)
-  {
-    if (c == comment_char)
-    {
-      in_comment = true;
-    }
-    else if (is_newline(c))
-    {
-      in_comment = false;
-      push_token();
-      push_cmd_token();
-    }
-    else if (is_space(c))
-    {
-      push_token();
-    }
-    else if (!in_comment)
-    {
-      token += c;
-    }
-  }
-  push_token();
-  push_cmd_token();
-
-  return out;
-}
-
-namespace
-{
-  static bool isalpha(char c)
-  {
-    return std::isalpha(c) != 0;
-  }
-}
-
-std::vector<gc::command> gcode::parse(const gcode::token_vector & __restrict tokens)
-{
-  printf("Parsing tokens\n");
-
-  std::vector<gc::command> out;
-  out.reserve(tokens.size());
-
-  for (const auto & __restrict tv : tokens)
-  {
-    out.emplace_back();
-
-    gc::command &cmd = out.back();
-    cmd._cmd_string = tv[0];
-    for (usize i = 1; i < tv.size(); ++i)
-    {
-      const std::string & __restrict token = tv[i];
-      std::string key;
-      std::string value;
-      
-      bool in_key = true;
-      for (char c : token)
-      {
-        if (in_key && isalpha(c))
-        {
-          key += c;
-        }
-        else
-        {
-          in_key = false;
-          value += c;
-        }
-      }
-
-      real rvalue = 0.0;
-      if (value.length())
-      {
-        rvalue = strtod(value.c_str(), nullptr);
-      }
-      cmd._arguments[key] = rvalue;
-    }
-  }
-
-  return out;
-}
-
-std::vector<gcgg::command *> gcode::process(const config & __restrict cfg) const __restrict
-{
-  printf("Processing...\n");
-
-  // Using a custom vector class would let use implement it using realloc which would likely be substantially faster.
-  // This, however, would add another mess of maintenence, so I'm not doing it, at least right now.
-  std::vector<gcgg::command *> out;
-  // Reserve
-  out.reserve(commands_.size() * 20);
-
-  real feedrate = cfg.defaults.feedrate.z;
-  real print_accel = cfg.defaults.acceleration.max_element();
-  real travel_accel = cfg.defaults.acceleration.max_element();
-  real retract_accel = cfg.defaults.extrusion_acceleration;
-  vector3<> acceleration = cfg.defaults.acceleration;
-  vector3<> jerk = cfg.defaults.jerk;
-  real extrude_jerk = cfg.defaults.extrusion_jerk;
-  std::unordered_map<uint, uint> extruder_temp;
-  std::unordered_map<uint, uint> bed_temp;
-  std::unordered_map<uint, uint> fan_speeds;
-
-  vector3<> position;
-  bool prev_move_cmd = false;
-
-  bool absolute_mode = true;
-  bool relative_extrusion = false;
-
-  bool steppers_enabled = true;
-
-  // We should handle the potential for absolute extrusion values.
-  real current_extrusion = 0.0;
-
-  const auto extract_position = [&](const gc::command & __restrict command)
-  {
-    if (absolute_mode)
-    {
-      position.x = command.get_argument("X", position.x);
-      position.y = command.get_argument("Y", position.y);
-      position.z = command.get_argument("Z", position.z);
-    }
-    else
-    {
-      position.x += command.get_argument("X", 0.0);
-      position.y += command.get_argument("Y", 0.0);
-      position.z += command.get_argument("Z", 0.0);
-    }
-  };
-
-  // Iterate over the commands and generate movement and operation sequences.
-  __pragma(warning(disable:4307));
-  for (const auto & __restrict command : commands_)
-  {
-    bool move_cmd = false;
-
-    const vector3<> start_position = position;
-
-    switch (hash(command._cmd_string))
-    {
-      // Movement Commands
-    case hash("G0"): {
-      move_cmd = true;
-
-      const bool has_z = command.has_argument_not("Z", position.z);
-      const bool has_xy = command.has_argument_not("X", position.x) || command.has_argument_not("Y", position.y);
-
-      feedrate = command.get_argument("F", feedrate);
-      extract_position(command);
-      
-      if (has_xy)
-      {
-        auto * __restrict cmd = new segments::travel;
-        cmd->set_positions(start_position, position);
-        cmd->set_feedrate(feedrate);
-        cmd->acceleration_hint_ = travel_accel;
-        cmd->acceleration_ = acceleration.limit({ travel_accel, travel_accel, travel_accel });
-        cmd->jerk_hint_ = jerk;
-        cmd->jerk_extrude_hint_ = extrude_jerk;
-        out.push_back(cmd);
-      }
-      else if (has_z)
-      {
-        auto * __restrict cmd = new segments::hop;
-        cmd->set_positions(start_position, position);
-        cmd->set_feedrate(feedrate);
-        cmd->acceleration_hint_ = travel_accel;
-        cmd->acceleration_ = acceleration.limit({ travel_accel, travel_accel, travel_accel });
-        cmd->jerk_hint_ = jerk;
-        cmd->jerk_extrude_hint_ = extrude_jerk;
-        out.push_back(cmd);
-      }
-      else
-      {
-        // This is a meaningless command? Might have a feedrate associated, but for movement it won't generate an opcode.
-      }
-    } break;
-    case hash("G1"): {
-      move_cmd = true;
-
-      const bool has_extrude = command.has_argument("E") && (command.get_argument("E", 0.0) != 0.0);
-      const bool has_z = command.has_argument_not("Z", position.z);
-      const bool has_xy = command.has_argument_not("X", position.x) || command.has_argument_not("Y", position.y);
-      const bool has_xyz = has_xy || has_z;
-      
-      feedrate = command.get_argument("F", feedrate);
-      extract_position(command);
-
-      if (has_extrude)
-      {
-        const real extrude = [&]() -> real
-        {
-          real E;
-          if (relative_extrusion)
-          {
-            E = command.get_argument("E", 0.0);
-            current_extrusion += E;
-          }
-          else
-          {
-            const real new_E = command.get_argument("E", 0.0);
-            E = new_E - current_extrusion;
-            current_extrusion = new_E;
-          }
-          return E;
-        }();
-
-        // Z movement-only with extrusion seems... unlikely. Just treat it as a normal move.
-        if (has_xyz)
-        {
-          auto * __restrict cmd = new segments::extrusion_move;
-          cmd->set_positions(start_position, position);
-          cmd->set_extrude(extrude);
-          cmd->set_feedrate(feedrate);
-          cmd->acceleration_hint_ = print_accel;
-          cmd->acceleration_ = acceleration.limit({ print_accel, print_accel, print_accel });
-          cmd->jerk_hint_ = jerk;
-          cmd->jerk_extrude_hint_ = extrude_jerk;
-          out.push_back(cmd);
-        }
-        else
-        {
-          // Extrude-only
-          auto * __restrict cmd = new segments::extrusion;
-          cmd->set_extrude(extrude);
-          cmd->set_feedrate(feedrate);
-          cmd->acceleration_hint_ = retract_accel;
-          cmd->acceleration_ = vector3<>(cfg.defaults.extrusion_acceleration).limit({ retract_accel, retract_accel, retract_accel }); // TODO extrusion acceleration?
-          cmd->jerk_hint_ = jerk;
-          cmd->jerk_extrude_hint_ = extrude_jerk;
-          out.push_back(cmd);
-        }
-      }
-      else
-      {
-        if (has_xy)
-        {
-          if (cfg.options.all_no_extrude_as_travel)
-          {
-            auto * __restrict cmd = new segments::travel;
-            cmd->set_positions(start_position, position);
-            cmd->set_feedrate(feedrate);
-            cmd->acceleration_hint_ = print_accel;
-            cmd->acceleration_ = acceleration.limit({ print_accel, print_accel, print_accel });
-            cmd->jerk_hint_ = jerk;
-            cmd->jerk_extrude_hint_ = extrude_jerk;
-            out.push_back(cmd);
-          }
-          else
-          {
-            auto * __restrict cmd = new segments::linear;
-            cmd->set_positions(start_position, position);
-            cmd->set_feedrate(feedrate);
-            cmd->acceleration_hint_ = print_accel;
-            cmd->acceleration_ = acceleration.limit({ print_accel, print_accel, print_accel });
-            cmd->jerk_hint_ = jerk;
-            cmd->jerk_extrude_hint_ = extrude_jerk;
-            out.push_back(cmd);
-          }
-        }
-        else if (has_z)
-        {
-          auto * __restrict cmd = new segments::hop;
-          cmd->set_positions(start_position, position);
-          cmd->set_feedrate(feedrate);
-          cmd->acceleration_hint_ = travel_accel;
-          cmd->acceleration_ = acceleration.limit({ travel_accel, travel_accel, travel_accel });
-          cmd->jerk_hint_ = jerk;
-          cmd->jerk_extrude_hint_ = extrude_jerk;
-          out.push_back(cmd);
-        }
-        else
-        {
-          // Not a move, so don't generate a command.
-        }
-      }
-
-    } break;
-
-      // Non-Movement Commands
-    case hash("M82"): {
-      // Set Absolute Extrusion
-      relative_extrusion = false;
-    } break;
-    case hash("M83"): {
-      // Set Relative Extrusion
-      relative_extrusion = true;
-    } break;
-
-    case hash("M84"): {
-      // Disable Steppers
-      auto * __restrict cmd = new instructions::M84(command);
-      out.push_back(cmd);
-    } break;
-
-    case hash("M104"): {
-      // Set Extruder Temperature, no wait
-      auto * __restrict cmd = new instructions::M104(command);
-      // Eliminate redundant/invalid commands
-      uint temperature = cmd->get_temperature();
-      uint extruder = cmd->get_number();
-
-      if (temperature == uint(-1) || temperature == extruder_temp[extruder])
-      {
-        delete cmd;
-      }
-      else
-      {
-        extruder_temp[extruder] = temperature;
-        out.push_back(cmd);
-      }
-    } break;
-
-    case hash("M106"): {
-      // Fan On
-      auto * __restrict cmd = new instructions::M106(command);
-      // Eliminate redundant/invalid commands
-      uint speed = cmd->get_speed();
-      uint fan = cmd->get_number();
-
-      if (speed == fan_speeds[fan])
-      {
-        delete cmd;
-      }
-      else
-      {
-        fan_speeds[fan] = speed;
-        out.push_back(cmd);
-      }
-    } break;
-
-    case hash("M107"): {
-      // Fan Off
-      auto * __restrict cmd = new instructions::M107(command);
-      // Eliminate redundant/invalid commands
-      uint fan = cmd->get_number();
-
-      if (0 == fan_speeds[fan])
-      {
-        delete cmd;
-      }
-      else
-      {
-        fan_speeds[fan] = 0;
-        out.push_back(cmd);
-      }
-    } break;
-
-    case hash("M109"): {
-      // Set Extruder Temperature and wait
-      auto * __restrict cmd = new instructions::M109(command);
-      // Eliminate redundant/invalid commands
-      uint temperature = cmd->get_temperature();
-      uint extruder = cmd->get_number();
-
-      if (temperature == uint(-1) || temperature == extruder_temp[extruder])
-      {
-        delete cmd;
-      }
-      else
-      {
-        extruder_temp[extruder] = temperature;
-        out.push_back(cmd);
-      }
-    } break;
-
-    case hash("M140"): {
-      // Set Bed Temperature, no wait
-      auto * __restrict cmd = new instructions::M140(command);
-      // Eliminate redundant/invalid commands
-      uint temperature = cmd->get_temperature();
-      uint heater = cmd->get_number();
-
-      if (temperature == uint(-1) || temperature == bed_temp[heater])
-      {
-        delete cmd;
-      }
-      else
-      {
-        bed_temp[heater] = temperature;
-        out.push_back(cmd);
-      }
-    } break;
-
-    case hash("M190"): {
-      // Set Bed Temperature and wait
-      auto * __restrict cmd = new instructions::M190(command);
-      // Eliminate redundant/invalid commands
-      uint temperature = cmd->get_temperature();
-      uint heater = cmd->get_number();
-
-      if (temperature == uint(-1) || temperature == bed_temp[heater])
-      {
-        delete cmd;
-      }
-      else
-      {
-        bed_temp[heater] = temperature;
-        out.push_back(cmd);
-      }
-    } break;
-
-    case hash("G28"): {
-      // Home
-      auto * __restrict cmd = new instructions::G28(command);
-
-      if (cmd->axis().x)
-      {
-        position.x = 0.0;
-      }
-      if (cmd->axis().y)
-      {
-        position.y = 0.0;
-      }
-      if (cmd->axis().z)
-      {
-        position.z = 0.0;
-      }
-
-      out.push_back(cmd);
-    } break;
-
-    case hash("G90"): {
-      // Set Absolute Positioning
-      absolute_mode = true;
-    } break;
-
-    case hash("G91"): {
-      // Set Relative Positioning
-      absolute_mode = false;
-    } break;
-
-      // State Commands (these do not generate opcodes, and instead are used for calculating motion or other things)
-    case hash("M204"): {
-      // SET DEFAULT ACCELERATION
-      if (command.has_argument("S")) // Legacy, but still used by some slicers like Cura
-      {
-        print_accel = command.get_argument("S", print_accel);
-        travel_accel = command.get_argument("S", travel_accel);
-      }
-
-      print_accel = command.get_argument("P", print_accel);
-      travel_accel = command.get_argument("T", travel_accel);
-      retract_accel = command.get_argument("R", retract_accel);
-    } break;
-    case hash("M205"): {
-      // ADVANCED SETTINGS (jerk)
-      jerk.x = command.get_argument("X", jerk.x);
-      jerk.y = command.get_argument("Y", jerk.y);
-      jerk.z = command.get_argument("Z", jerk.z);
-      extrude_jerk = command.get_argument("E", extrude_jerk);
-    } break;
-
-    default: {
-      printf("Unknown Command: %s\n", command._cmd_string.c_str());
-    } break;
-    }
-
-    prev_move_cmd = move_cmd;
-  }
-  __pragma(warning(default:4307));
-
-  usize contiguous_segment_count = 0;
-  usize move_commands_orig = 0;
-
-  for (const auto * __restrict cmd : out)
-  {
-    switch (cmd->get_type())
-    {
-    case segments::extrusion_move::type:
-    case segments::hop::type:
-    case segments::linear::type:
-    case segments::travel::type: {
-      ++move_commands_orig;
-    }
-    }
-  }
-
-  if (out.size() >= 2)
-  {
-    printf("Eliminating redundant movements...\n");
-    // Now we compact the commands by finding ones that can be merged.
-    auto prev_iter = out.begin();
-    for (auto iter = prev_iter + 1; iter != out.end();)
-    {
-      auto * __restrict prev_cmd = *prev_iter;
-      const auto * __restrict cur_cmd = *iter;
-
-      // Only valid if they're the same command type.
-      if (prev_cmd->get_type() == cur_cmd->get_type())
-      {
-        // Also only valid if they're movement types.
-        switch (cur_cmd->get_type())
-        {
-        case segments::extrusion_move::type:
-        case segments::hop::type:
-        case segments::linear::type:
-        case segments::travel::type: {
-          segments::movement * __restrict prev_move_cmd = static_cast<segments::movement * __restrict>(prev_cmd);
-          const segments::movement * __restrict cur_move_cmd = static_cast<const segments::movement * __restrict>(cur_cmd);
-
-          // They must have the same feedrate as well.
-          if (prev_move_cmd->get_feedrate() != cur_move_cmd->get_feedrate())
-          {
-            break;
-          }
-
-          const vector3<> prev_vector = prev_move_cmd->get_vector().normalized();
-          const vector3<> cur_vector = cur_move_cmd->get_vector().normalized();
-
-          const real dot_product = prev_vector.dot(cur_vector);
-
-          if (!is_equal(dot_product, 1.0))
-          {
-            break;
-          }
-
-          static constexpr const bool compare_hints = true;
-
-          // If this is an extrusion, make sure the extrusion rate is the same.
-          if (cur_cmd->get_type() == segments::extrusion_move::type)
-          {
-            const real prev_time = prev_move_cmd->get_vector().length() / prev_move_cmd->get_feedrate();
-            const real cur_time = cur_move_cmd->get_vector().length() / cur_move_cmd->get_feedrate();
-
-            const segments::extrusion_move * __restrict prev_extrusion_cmd = static_cast<const segments::extrusion_move * __restrict>(prev_cmd);
-            const segments::extrusion_move * __restrict cur_extrusion_cmd = static_cast<const segments::extrusion_move * __restrict>(cur_cmd);
-          
-            const real prev_extrude = prev_extrusion_cmd->get_extrusion();
-            const real cur_extrude = cur_extrusion_cmd->get_extrusion();
-
-            const real prev_extrusion_rate = prev_extrude / prev_time;
-            const real cur_extrusion_rate = cur_extrude / cur_time;
-
-            if (!is_equal(prev_extrusion_rate, cur_extrusion_rate, cfg.extrusion.epsilon))
-            {
-              break;
-            }
-
-            if constexpr (compare_hints)
-            {
-              if (!is_equal(prev_move_cmd->jerk_extrude_hint_, cur_move_cmd->jerk_extrude_hint_))
-              {
-                break;
-              }
-            }
-          }
-
-          if constexpr (compare_hints)
-          {
-            // Validate that acceleration/jerk are similar.
-            const real prev_acceleration_hint = prev_move_cmd->acceleration_hint_;
-            const real cur_acceleration_hint = cur_move_cmd->acceleration_hint_;
-
-            const vector3<> prev_jerk_hint = prev_move_cmd->jerk_hint_;
-            const vector3<> cur_jerk_hint = cur_move_cmd->jerk_hint_;
-
-            if (!is_equal(prev_acceleration_hint, cur_acceleration_hint))
-            {
-              break;
-            }
-
-            if (!is_equal(prev_jerk_hint, cur_jerk_hint))
-            {
-              break;
-            }
-          }
-
-          // Otherwise, these appear to be contiguous segments.
-          ++contiguous_segment_count;
-
-          prev_move_cmd->set_end_position(cur_move_cmd->get_end_position());
-          if (cur_cmd->get_type() == segments::extrusion_move::type)
-          {
-            segments::extrusion_move * __restrict prev_extrusion_cmd = static_cast<segments::extrusion_move * __restrict>(prev_cmd);
-            const segments::extrusion_move * __restrict cur_extrusion_cmd = static_cast<const segments::extrusion_move * __restrict>(cur_cmd);
-
-            prev_extrusion_cmd->set_extrusion(prev_extrusion_cmd->get_extrusion() + cur_extrusion_cmd->get_extrusion());
-          }
-
-          iter = out.erase(iter);
-          continue;
-
-        } break;
-        }
-      }
-
-      prev_iter = iter++;
-    }
-  }
-
-  if (contiguous_segment_count)
-  {
-    const double reduction = 100.0 * (double(move_commands_orig - contiguous_segment_count) / double(move_commands_orig));
-    printf(
-      "Merged %llu contiguous segments (%.2f%% original count - %llu -> %llu)\n",
-      contiguous_segment_count,
-      reduction,
-      move_commands_orig,
-      move_commands_orig - contiguous_segment_count
-    );
-  }
-
-  printf("Linking motion segments\n");
-  {
-    gcgg::segments::segment * __restrict prev_seg = nullptr;
-    for (gcgg::command * __restrict cmd : out)
-    {
-      if (!cmd->is_segment())
-      {
-        if (cmd->is_delay())
-        {
-          prev_seg = nullptr;
-        }
-        continue;
-      }
-
-      gcgg::segments::segment * __restrict cur_seg = static_cast<gcgg::segments::segment * __restrict>(cmd);
-      if (prev_seg)
-      {
-        prev_seg->next_segment_ = cur_seg;
-        cur_seg->prev_segment_ = prev_seg;
-      }
-
-      prev_seg = cur_seg;
-    }
-  }
-
-  // Calculate trapezoid values. We need to do this more than once.
-  printf("Calculating Motion\n");
-  for (auto * __restrict seg : out)
-  {
-    seg->compute_motion(cfg, false);
-  }
-
-  if (cfg.smoothing.enable && out.size() >= 2)
-  {
-    printf("Smoothing surface...\n");
-
-  }
-
-  if (cfg.arc.generate && out.size() >= 2)
-  {
-    usize generated_arcs = 0;
-
-    printf("Generating arc segments...\n");
-    out.reserve(out.size() * 2); // To prevent iterators from being invalidated. This is hacky and non-standard, but should work.
-
-    auto prev_iter = out.begin();
-    for (auto iter = prev_iter + 1; iter != out.end();)
-    {
-      auto * __restrict prev_cmd = *prev_iter;
-      auto * __restrict cur_cmd = *iter;
-
-      // TODO we should really handle this case. I don't know how, yet.
-      if (prev_cmd->get_type() == segments::arc::type)
-      {
-        prev_iter = iter++;
-        continue;
-      }
-
-      const auto is_move = [](const auto * __restrict cmd)->bool
-      {
-        switch (cmd->get_type())
-        {
-        case segments::extrusion_move::type:
-        case segments::hop::type:
-        case segments::linear::type:
-        case segments::travel::type:
-          return true;
-        }
-        return false;
-      };
-
-      if (!is_move(prev_cmd) || cur_cmd->is_delay())
-      {
-        prev_iter = iter++;
-        continue;
-      }
-
-      if (!is_move(cur_cmd))
-      {
-        // If the current command is not a movement command, we might need to just increment iter until
-        // we either find one, or we hit a delay instruction, as there might be non-moves between our moves
-        // that are inconsequential.
-        do
-        {
-          ++iter;
-
-          if (iter == out.end())
-          {
-            break;
-          }
-
-          cur_cmd = *iter;
-          if (is_move(cur_cmd))
-          {
-            goto continue_exec;
-          }
-
-          // If it's a delay instruction, we need to just keep moving, since it interrupts motion.
-          if (cur_cmd->is_delay())
-          {
-            goto continue_exec;
-          }
-
-        } while (iter != out.end());
-        break;
-      continue_exec:;
-
-        if (!is_move(cur_cmd) || cur_cmd->is_delay())
-        {
-          prev_iter = iter++;
-          continue;
-        }
-      }
-
-      segments::movement * __restrict prev_segment_cmd = static_cast<segments::movement * __restrict>(prev_cmd);
-      segments::movement * __restrict cur_segment_cmd = static_cast<segments::movement * __restrict>(cur_cmd);
-
-      // Calculate the angle between the two segments.
-      const vector3<> segment_vectors[2] = {
-        prev_segment_cmd->get_vector(),
-        cur_segment_cmd->get_vector(),
-      };
-
-      const vector3<> segment_norm_vectors[2] = {
-        segment_vectors[0].normalized(),
-        segment_vectors[1].normalized(),
-      };
-
-      const double angle = segment_norm_vectors[0].angle_between(segment_norm_vectors[1]);
-
-      if (angle <= cfg.arc.min_angle)
-      {
-        prev_iter = iter++;
-        continue;
-      }
-
-      const bool is_travel = prev_segment_cmd->is_travel_ && cur_segment_cmd->is_travel_;
-
-      double arc_radius;
-      if (is_travel && cfg.arc.halve_travels)
-      {
-        arc_radius = min(
-          prev_segment_cmd->get_vector().length(),
-          cur_segment_cmd->get_vector().length() / 2
-        );
-      }
-      else
-      {
-        arc_radius = is_travel ? cfg.arc.travel_radius : cfg.arc.radius;
-      }
-
-      // TODO in reality we should be generating ovaloid arcs, to handle differences in velocity.
-
-      if (prev_segment_cmd->get_vector().length() < arc_radius || (cur_segment_cmd->get_vector().length() * 0.5) < arc_radius)
-      {
-        // TODO handle this situation by reducing arc length better than this. This is nasty.
-        if (prev_segment_cmd->get_vector().length() < arc_radius)
-        {
-          arc_radius = prev_segment_cmd->get_vector().length();
-        }
-        if ((cur_segment_cmd->get_vector().length() * 0.5) < arc_radius)
-        {
-          arc_radius = (cur_segment_cmd->get_vector().length() * 0.5);
-        }
-        if (arc_radius <= cfg.arc.min_radius)
-        {
-          prev_iter = iter++;
-          continue;
-        }
-      }
-
-      ++generated_arcs;
-
-      // Generate a split point for both segments
-      // Reduce any extrusion (and apply said extrusion to the arc)
-      const real segment_orig_lengths[2] = {
-        segment_vectors[0].length(),
-        segment_vectors[1].length()
-      };
-
-      const auto get_extrusion = [](const segments::segment *seg)->real
-      {
-        if (seg->get_type() != segments::extrusion_move::type)
-        {
-          return 0.0;
-        }
-        const segments::extrusion_move * __restrict extrusion_cmd = static_cast<const segments::extrusion_move * __restrict>(seg);
-        return extrusion_cmd->get_extrusion();
-      };
-
-      const auto set_extrusion = [](segments::segment *seg, real extrude)
-      {
-        if (seg->get_type() != segments::extrusion_move::type)
-        {
-          return;
-        }
-        segments::extrusion_move * __restrict extrusion_cmd = static_cast<segments::extrusion_move * __restrict>(seg);
-        return extrusion_cmd->set_extrude(extrude);
-      };
-
-      const real segment_orig_extrude[2] = {
-        get_extrusion(prev_segment_cmd),
-        get_extrusion(cur_segment_cmd)
-      };
-
-      const real segment_new_fraction[2] = {
-        (segment_orig_lengths[0] - arc_radius) / segment_orig_lengths[0],
-        (segment_orig_lengths[1] - arc_radius) / segment_orig_lengths[1]
-      };
-      
-      const vector3<> corner = prev_segment_cmd->get_end_position();
-      const vector3<> prev_seg_new_end = prev_segment_cmd->get_start_position() + (segment_vectors[0] * segment_new_fraction[0]);
-      const vector3<> cur_seg_new_start = cur_segment_cmd->get_end_position() - (segment_vectors[1] * segment_new_fraction[1]);
-
-      const real segment_new_extrude[2] = {
-        segment_orig_extrude[0] * segment_new_fraction[0],
-        segment_orig_extrude[1] * segment_new_fraction[1]
-      };
-
-      const real segment_extrude_remainder[2] = {
-        segment_orig_extrude[0] - segment_new_extrude[0],
-        segment_orig_extrude[1] - segment_new_extrude[1]
-      };
-
-      if (is_equal(prev_seg_new_end.distance(cur_seg_new_start), 0.0))
-      {
-        prev_iter = iter++;
-        continue;
-      }
-
-      set_extrusion(prev_segment_cmd, segment_new_extrude[0]);
-      set_extrusion(cur_segment_cmd, segment_new_extrude[1]);
-      prev_segment_cmd->set_end_position(prev_seg_new_end);
-      cur_segment_cmd->set_start_position(cur_seg_new_start);
-
-      real start_feedrate = prev_segment_cmd->get_feedrate();
-      real end_feedrate = cur_segment_cmd->get_feedrate();
-      if (cfg.arc.constant_speed)
-      {
-        // If we are a constant speed arc, average out the two feedrates.
-        start_feedrate = end_feedrate = (start_feedrate + end_feedrate) * 0.5;
-      }
-
-      auto * __restrict new_arc = new segments::arc(
-        segment_extrude_remainder,
-        { start_feedrate, end_feedrate },
-        { prev_segment_cmd->acceleration_hint_,  cur_segment_cmd->acceleration_hint_ },
-        { prev_segment_cmd->jerk_hint_,  cur_segment_cmd->jerk_hint_ },
-        { prev_segment_cmd->jerk_extrude_hint_,  cur_segment_cmd->jerk_extrude_hint_ },
-        corner,
-        prev_seg_new_end,
-        cur_seg_new_start,
-        arc_radius,
-        angle
-      );
-
-      new_arc->parent_velocities_[0] = (prev_segment_cmd->get_end_position() - prev_segment_cmd->get_start_position()).normalized(prev_segment_cmd->get_feedrate());
-      new_arc->parent_velocities_[1] = (cur_segment_cmd->get_end_position() - cur_segment_cmd->get_start_position()).normalized(cur_segment_cmd->get_feedrate());
-
-      new_arc->is_travel_ = is_travel;
-
-      // Do we need to delete the previous segment (has it been completely replaced with arcs?
-      // TODO currently we never destroy the current segment as we check against half-lengths. We should revisit that.
-      if (is_equal(prev_segment_cmd->get_vector().length(), 0.0))
-      {
-        delete *prev_iter;
-        *prev_iter = new_arc;
-      }
-      else
-      {
-        iter = (out.insert(iter, new_arc)) + 1; // insert before cur_seg, then get the iterator again due to invalidation rules.
-      }
-
-      prev_iter = iter++;
-    }
-
-    printf("Generated Corner Arcs: %llu\n", generated_arcs);
-  }
-
-  // Generate arcs where possible.
-  if (cfg.reg_arc_gen.enable)
-  {
-    std::vector<gcgg::command * __restrict> erase_set;
-
-    uint64_t generated_arcs = 0;
-    segments::arc_accumulator accumulator;
-
-    printf("Generating Arcs from curved segment sets\n");
-
-    const auto flush_accumulator = [&](auto &iterator) -> bool
-    {
-      if (!accumulator.conditional_reset())
-      {
-        // If the accumulator is actually valid, it means we've generated an arc.
-        // TODO optimize this bit.
-        erase_set.insert(erase_set.end(), accumulator.get_segments().begin(), accumulator.get_segments().end());
-        iterator = out.insert(iterator, new segments::arc_accumulator(std::move(accumulator)));
-        ++generated_arcs;
-        accumulator.reset();
-        return true;
-      }
-      return false;
-    };
-
-    for (auto i = out.begin(); i != out.end();)
-    {
-      gcgg::command * __restrict cmd = *i;
-
-      const auto is_move = [](const auto * __restrict cmd)->bool
-      {
-        switch (cmd->get_type())
-        {
-        case segments::extrusion_move::type:
-        case segments::hop::type:
-        case segments::linear::type:
-        case segments::travel::type:
-          return true;
-        }
-        return false;
-      };
-
-      if (!is_move(cmd))
-      {
-        // We don't consume this one.
-        if (!flush_accumulator(i))
-        {
-          ++i;
-        }
-        continue;
-      }
-
-      segments::movement * __restrict segment_cmd = static_cast<segments::movement * __restrict>(cmd);
-      
-      if (!accumulator.consume_segment(*segment_cmd, cfg))
-      {
-        // If we don't consume this, this arc is finished, if it exists at all.
-        if (!flush_accumulator(i))
-        {
-          ++i;
-        }
-        continue;
-      }
-
-      // If we did consume it... yay. Continue to the next one.
-      ++i;
-    }
-    if (!accumulator.conditional_reset())
-    {
-      // If the accumulator is actually valid, it means we've generated an arc.
-      // TODO optimize this bit.
-      erase_set.insert(erase_set.end(), accumulator.get_segments().begin(), accumulator.get_segments().end());
-      out.push_back(new segments::arc_accumulator(std::move(accumulator)));
-      ++generated_arcs;
-      accumulator.reset();
-    }
-
-    // Clear the erase set. This is messy and slow.
-    if (erase_set.size())
-    {
-      printf("Performing segment garbage collection... (%llu segments to delete)\n", uint64(erase_set.size()));
-      for (auto i = out.begin(); i != out.end();)
-      {
-        auto ei = std::find(erase_set.begin(), erase_set.end(), *i);
-        if (ei != erase_set.end())
-        {
-          // No need to perform a normal erase which requires a copy. Do a fast erase.
-          fast_erase_iterator(erase_set, ei);
-          i = out.erase(i);
-          if (erase_set.size() == 0)
-          {
-            break;
-          }
-        }
-        else
-        {
-          ++i;
-        }
-      }
-    }
-
-    printf("Generated Arcs: %llu\n", generated_arcs);
-  }
-
-  if (cfg.arc.generate && cfg.output.subdivide_arcs)
-  {
-    printf("Subdividing Arcs\n");
-    for (auto i = out.begin(); i != out.end();)
-    {
-      gcgg::command * __restrict cmd = *i;
-
-      if (cmd->get_type() != segments::arc::type)
-      {
-        ++i;
-        continue;
-      }
-
-      gcgg::segments::arc * __restrict arc_seg = static_cast<gcgg::segments::arc * __restrict>(cmd);
-
-      if (arc_seg->should_subdivide(cfg))
-      {
-        i = out.erase(i);
-
-        auto new_segments = arc_seg->generate_segments(cfg);
-
-        delete arc_seg;
-
-        i = out.insert(i, new_segments.begin(), new_segments.end());
-      }
-      else
-      {
-        ++i;
-      }
-    }
-  }
-
-  printf("Linking motion segments\n");
-  {
-    gcgg::segments::segment * __restrict prev_seg = nullptr;
-    for (gcgg::command * __restrict cmd : out)
-    {
-      if (!cmd->is_segment())
-      {
-        if (cmd->is_delay())
-        {
-          prev_seg = nullptr;
-        }
-        continue;
-      }
-
-      gcgg::segments::segment * __restrict cur_seg = static_cast<gcgg::segments::segment * __restrict>(cmd);
-      if (prev_seg)
-      {
-        prev_seg->next_segment_ = cur_seg;
-        cur_seg->prev_segment_ = prev_seg;
-      }
-
-      prev_seg = cur_seg;
-    }
-  }
-
-  printf("Calculating Motion\n");
-  for (auto * __restrict seg : out)
-  {
-    seg->compute_motion(cfg, true);
-  }
-
-  return out;
-}
+#include "gcgg.hpp"
+#include "gcode.hpp"
+
+#include "segment/extrusion.hpp"
+#include "segment/extrusion_move.hpp"
+#include "segment/hop.hpp"
+#include "segment/linear.hpp"
+#include "segment/travel.hpp"
+#include "segment/arc.hpp"
+#include "segment/arc_accumulator.hpp"
+
+#include "instruction/M84.hpp"
+#include "instruction/M104.hpp"
+#include "instruction/M106.hpp"
+#include "instruction/M107.hpp"
+#include "instruction/M109.hpp"
+#include "instruction/M140.hpp"
+#include "instruction/M190.hpp"
+
+#include "instruction/G28.hpp"
+
+#include "config.hpp"
+
+#include "platform/mapped_file.hpp"
+#include "platform/thread_pool.hpp"
+#include "platform/arena.hpp"
+
+#include "motion/planner.hpp"
+#include "motion/estimate.hpp"
+
+#include "stats/stats.hpp"
+
+#include "cache/job_cache.hpp"
+
+#include <cstdio>
+#include <atomic>
+#include <iterator>
+#include <limits>
+#include <mutex>
+
+#include <deque>
+#include <algorithm>
+#include <list>
+#include <memory>
+
+gcode::gcode(const std::string &__restrict filename) :
+  // The file is mapped rather than read, so the parser walks the page cache directly instead of a private copy of the file.
+  file_(filename)
+{
+  if (!file_.is_open())
+  {
+    printf("Failed to open input file: %s\n", filename.c_str());
+    exit(1);
+  }
+}
+
+gcode::~gcode()
+{
+}
+
+namespace
+{
+  // The <cctype> versions are locale-dependent and undefined for negative chars, which comments can easily contain.
+  static bool is_newline(char c)
+  {
+    return c == '\r' || c == '\n';
+  }
+
+  static bool is_space(char c)
+  {
+    return c == ' ' || c == '\t' || c == '\v' || c == '\f' || is_newline(c);
+  }
+
+  static bool is_alpha(char c)
+  {
+    return uint8((c | 0x20) - 'a') < 26;
+  }
+
+  static bool is_digit(char c)
+  {
+    return uint8(c - '0') < 10;
+  }
+
+  // Parses a decimal number in place. Equivalent to strtod for the plain decimals gcode consists of, without copying the
+  // word into a null-terminated buffer first. The toolset we ship with (v141) has no floating-point std::from_chars.
+  static real parse_real(const char * __restrict begin, const char * __restrict end)
+  {
+    // Every integer up to 2^53 and every power of ten up to 10^22 is exactly representable as a double, so a single
+    // multiply or divide of the two is correctly rounded - the same result strtod would produce.
+    static constexpr const real exact_powers[] = {
+      1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+      1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    static constexpr const uint64 max_exact_mantissa = uint64(1) << 53;
+    static constexpr const int64 max_exact_power = int64(std::size(exact_powers)) - 1;
+
+    const char * __restrict cur = begin;
+
+    bool negative = false;
+    if (cur != end && (*cur == '-' || *cur == '+'))
+    {
+      negative = (*cur == '-');
+      ++cur;
+    }
+
+    uint64 mantissa = 0;
+    int64 exponent = 0;
+    bool exact = true;
+    bool any_digits = false;
+
+    const auto accumulate = [&](char c)
+    {
+      any_digits = true;
+      if (mantissa < (max_exact_mantissa / 10))
+      {
+        mantissa = (mantissa * 10) + uint64(c - '0');
+      }
+      else
+      {
+        exact = false;
+      }
+    };
+
+    for (; cur != end && is_digit(*cur); ++cur)
+    {
+      accumulate(*cur);
+    }
+    if (cur != end && *cur == '.')
+    {
+      ++cur;
+      for (; cur != end && is_digit(*cur); ++cur)
+      {
+        accumulate(*cur);
+        --exponent;
+      }
+    }
+
+    if (!any_digits)
+    {
+      return 0.0;
+    }
+
+    if (cur != end && (*cur == 'e' || *cur == 'E'))
+    {
+      // Exponents don't appear in gcode that slicers generate, so let strtod deal with them.
+      exact = false;
+    }
+
+    if (__unlikely(!exact || exponent < -max_exact_power))
+    {
+      char buffer[128];
+      const usize length = min(usize(end - begin), usize(sizeof(buffer) - 1));
+      memcpy(buffer, begin, length);
+      buffer[length] = '\0';
+      return strtod(buffer, nullptr);
+    }
+
+    const real value = real(mantissa) / exact_powers[-exponent];
+    return negative ? -value : value;
+  }
+
+  static constexpr const char comment_char = ';';
+
+  // Derived by testing with my files. Probably needs to be different for other real world files.
+  static constexpr const usize mean_line_length = 24;
+
+  static void parse_chunk(const char * __restrict data, const char * __restrict end, std::vector<gc::command> & __restrict out)
+  {
+    out.reserve(usize(end - data) / mean_line_length);
+
+    const char * __restrict cur = data;
+
+    // A single pass over the input: words are sliced out of the mapping as views and numbers are parsed where they lie,
+    // so nothing is allocated per word. The first word on a line is the command, the rest are arguments.
+    while (cur != end)
+    {
+      gc::command * __restrict cmd = nullptr;
+
+      while (cur != end && !is_newline(*cur))
+      {
+        const char c = *cur;
+        if (c == comment_char)
+        {
+          while (cur != end && !is_newline(*cur))
+          {
+            ++cur;
+          }
+          break;
+        }
+        if (is_space(c))
+        {
+          ++cur;
+          continue;
+        }
+
+        const char * const __restrict word_begin = cur;
+        while (cur != end && !is_space(*cur) && *cur != comment_char)
+        {
+          ++cur;
+        }
+        const std::string_view word = { word_begin, usize(cur - word_begin) };
+
+        if (!cmd)
+        {
+          cmd = &out.emplace_back();
+          cmd->_cmd_string = word;
+          cmd->_cmd_id = hash(word);
+          continue;
+        }
+
+        // Arguments are a single letter followed by an optional value (G28 X). Anything else isn't an argument we understand, so it's dropped.
+        if (!is_alpha(word[0]) || (word.length() > 1 && is_alpha(word[1])))
+        {
+          continue;
+        }
+
+        cmd->set_argument(word[0], parse_real(word.data() + 1, word.data() + word.length()));
+      }
+
+      while (cur != end && is_newline(*cur))
+      {
+        ++cur;
+      }
+    }
+  }
+}
+
+std::vector<gc::command> gcode::parse(const char * __restrict data, usize size)
+{
+  printf("Parsing gcode\n");
+
+  // Lines are independent until process() interprets them (modal state like G90/G91 and M82/M83 lives there), so the
+  // file can be split at any newline and the pieces parsed concurrently. Chunks are kept large so that per-chunk
+  // overhead and the final copy stay negligible next to the parsing itself.
+  static constexpr const usize min_chunk_size = 4 * 1024 * 1024;
+
+  auto & __restrict pool = platform::thread_pool::get();
+  // Splitting only pays for the stitching copy when the chunks actually run side by side.
+  const usize max_chunks = (pool.size() > 1) ? (usize(pool.size()) * 4) : 1;
+  const usize chunk_count = clamp(size / min_chunk_size, usize(1), max_chunks);
+
+  std::vector<const char *> boundaries(chunk_count + 1);
+  boundaries[0] = data;
+  boundaries[chunk_count] = data + size;
+  for (usize i = 1; i < chunk_count; ++i)
+  {
+    const char * __restrict boundary = data + ((size * i) / chunk_count);
+    if (boundary < boundaries[i - 1])
+    {
+      boundary = boundaries[i - 1];
+    }
+    while (boundary != data + size && !is_newline(*boundary))
+    {
+      ++boundary;
+    }
+    boundaries[i] = boundary;
+  }
+
+  std::vector<std::vector<gc::command>> chunks(chunk_count);
+  pool.parallel_for(chunk_count, [&](usize i)
+  {
+    parse_chunk(boundaries[i], boundaries[i + 1], chunks[i]);
+  });
+
+  std::vector<gc::command> out;
+  if (chunk_count == 1)
+  {
+    out = std::move(chunks[0]);
+  }
+  else
+  {
+    usize total = 0;
+    for (const auto & __restrict chunk : chunks)
+    {
+      total += chunk.size();
+    }
+    out.reserve(total);
+    for (auto & __restrict chunk : chunks)
+    {
+      out.insert(out.end(), chunk.begin(), chunk.end());
+      std::vector<gc::command>().swap(chunk);
+    }
+  }
+
+  return out;
+}
+
+namespace
+{
+  // The modal state of the gcode being interpreted: positioning modes, the current position, accelerations, and the last
+  // temperatures and fan speeds set (so redundant commands can be dropped). It's an object rather than a set of locals so
+  // that a stream can carry it from one window to the next.
+  struct interpreter final
+  {
+    const config & __restrict cfg;
+    // Where interpreted commands are made. Streaming points this at a new arena for every block it parses.
+    platform::arena * __restrict arena;
+
+    real feedrate;
+    real print_accel;
+    real travel_accel;
+    real retract_accel;
+    vector3<> acceleration;
+    vector3<> jerk;
+    real extrude_jerk;
+    std::unordered_map<uint, uint> extruder_temp;
+    std::unordered_map<uint, uint> bed_temp;
+    std::unordered_map<uint, uint> fan_speeds;
+
+    vector3<> position;
+    bool prev_move_cmd = false;
+
+    bool absolute_mode = true;
+    bool relative_extrusion = false;
+
+    bool steppers_enabled = true;
+
+    // We should handle the potential for absolute extrusion values.
+    real current_extrusion = 0.0;
+
+    interpreter(const config & __restrict _cfg, platform::arena & __restrict _arena) :
+      cfg(_cfg),
+      arena(&_arena),
+      feedrate(_cfg.defaults.feedrate.z),
+      print_accel(_cfg.defaults.acceleration.max_element()),
+      travel_accel(_cfg.defaults.acceleration.max_element()),
+      retract_accel(_cfg.defaults.extrusion_acceleration),
+      acceleration(_cfg.defaults.acceleration),
+      jerk(_cfg.defaults.jerk),
+      extrude_jerk(_cfg.defaults.extrusion_jerk)
+    {}
+
+    void extract_position(const gc::command & __restrict command) __restrict
+    {
+      if (absolute_mode)
+      {
+        position.x = command.get_argument('X', position.x);
+        position.y = command.get_argument('Y', position.y);
+        position.z = command.get_argument('Z', position.z);
+      }
+      else
+      {
+        position.x += command.get_argument('X', 0.0);
+        position.y += command.get_argument('Y', 0.0);
+        position.z += command.get_argument('Z', 0.0);
+      }
+    }
+
+    // Generates the movement and operation sequences for a single line of gcode.
+    void interpret(const gc::command & __restrict command, std::vector<gcgg::command *> & __restrict out) __restrict
+    {
+      bool move_cmd = false;
+
+      const vector3<> start_position = position;
+
+      __pragma(warning(disable:4307));
+      switch (command._cmd_id)
+      {
+        // Movement Commands
+      case hash("G0"): {
+        move_cmd = true;
+
+        const bool has_z = command.has_argument_not('Z', position.z);
+        const bool has_xy = command.has_argument_not('X', position.x) || command.has_argument_not('Y', position.y);
+
+        feedrate = command.get_argument('F', feedrate);
+        extract_position(command);
+      
+        if (has_xy)
+        {
+          auto * __restrict cmd = arena->make<segments::travel>();
+          cmd->set_positions(start_position, position);
+          cmd->set_feedrate(feedrate);
+          cmd->acceleration_hint_ = travel_accel;
+          cmd->acceleration_ = acceleration.limit({ travel_accel, travel_accel, travel_accel });
+          cmd->jerk_hint_ = jerk;
+          cmd->jerk_extrude_hint_ = extrude_jerk;
+          out.push_back(cmd);
+        }
+        else if (has_z)
+        {
+          auto * __restrict cmd = arena->make<segments::hop>();
+          cmd->set_positions(start_position, position);
+          cmd->set_feedrate(feedrate);
+          cmd->acceleration_hint_ = travel_accel;
+          cmd->acceleration_ = acceleration.limit({ travel_accel, travel_accel, travel_accel });
+          cmd->jerk_hint_ = jerk;
+          cmd->jerk_extrude_hint_ = extrude_jerk;
+          out.push_back(cmd);
+        }
+        else
+        {
+          // This is a meaningless command? Might have a feedrate associated, but for movement it won't generate an opcode.
+        }
+      } break;
+      case hash("G1"): {
+        move_cmd = true;
+
+        const bool has_extrude = command.has_argument('E') && (command.get_argument('E', 0.0) != 0.0);
+        const bool has_z = command.has_argument_not('Z', position.z);
+        const bool has_xy = command.has_argument_not('X', position.x) || command.has_argument_not('Y', position.y);
+        const bool has_xyz = has_xy || has_z;
+      
+        feedrate = command.get_argument('F', feedrate);
+        extract_position(command);
+
+        if (has_extrude)
+        {
+          const real extrude = [&]() -> real
+          {
+            real E;
+            if (relative_extrusion)
+            {
+              E = command.get_argument('E', 0.0);
+              current_extrusion += E;
+            }
+            else
+            {
+              const real new_E = command.get_argument('E', 0.0);
+              E = new_E - current_extrusion;
+              current_extrusion = new_E;
+            }
+            return E;
+          }();
+
+          // Z movement-only with extrusion seems... unlikely. Just treat it as a normal move.
+          if (has_xyz)
+          {
+            auto * __restrict cmd = arena->make<segments::extrusion_move>();
+            cmd->set_positions(start_position, position);
+            cmd->set_extrude(extrude);
+            cmd->set_feedrate(feedrate);
+            cmd->acceleration_hint_ = print_accel;
+            cmd->acceleration_ = acceleration.limit({ print_accel, print_accel, print_accel });
+            cmd->jerk_hint_ = jerk;
+            cmd->jerk_extrude_hint_ = extrude_jerk;
+            out.push_back(cmd);
+          }
+          else
+          {
+            // Extrude-only
+            auto * __restrict cmd = arena->make<segments::extrusion>();
+            cmd->set_extrude(extrude);
+            cmd->set_feedrate(feedrate);
+            cmd->acceleration_hint_ = retract_accel;
+            cmd->acceleration_ = vector3<>(cfg.defaults.extrusion_acceleration).limit({ retract_accel, retract_accel, retract_accel }); // TODO extrusion acceleration?
+            cmd->jerk_hint_ = jerk;
+            cmd->jerk_extrude_hint_ = extrude_jerk;
+            out.push_back(cmd);
+          }
+        }
+        else
+        {
+          if (has_xy)
+          {
+            if (cfg.options.all_no_extrude_as_travel)
+            {
+              auto * __restrict cmd = arena->make<segments::travel>();
+              cmd->set_positions(start_position, position);
+              cmd->set_feedrate(feedrate);
+              cmd->acceleration_hint_ = print_accel;
+              cmd->acceleration_ = acceleration.limit({ print_accel, print_accel, print_accel });
+              cmd->jerk_hint_ = jerk;
+              cmd->jerk_extrude_hint_ = extrude_jerk;
+              out.push_back(cmd);
+            }
+            else
+            {
+              auto * __restrict cmd = arena->make<segments::linear>();
+              cmd->set_positions(start_position, position);
+              cmd->set_feedrate(feedrate);
+              cmd->acceleration_hint_ = print_accel;
+              cmd->acceleration_ = acceleration.limit({ print_accel, print_accel, print_accel });
+              cmd->jerk_hint_ = jerk;
+              cmd->jerk_extrude_hint_ = extrude_jerk;
+              out.push_back(cmd);
+            }
+          }
+          else if (has_z)
+          {
+            auto * __restrict cmd = arena->make<segments::hop>();
+            cmd->set_positions(start_position, position);
+            cmd->set_feedrate(feedrate);
+            cmd->acceleration_hint_ = travel_accel;
+            cmd->acceleration_ = acceleration.limit({ travel_accel, travel_accel, travel_accel });
+            cmd->jerk_hint_ = jerk;
+            cmd->jerk_extrude_hint_ = extrude_jerk;
+            out.push_back(cmd);
+          }
+          else
+          {
+            // Not a move, so don't generate a command.
+          }
+        }
+
+      } break;
+
+        // Non-Movement Commands
+      case hash("M82"): {
+        // Set Absolute Extrusion
+        relative_extrusion = false;
+      } break;
+      case hash("M83"): {
+        // Set Relative Extrusion
+        relative_extrusion = true;
+      } break;
+
+      case hash("M84"): {
+        // Disable Steppers
+        auto * __restrict cmd = arena->make<instructions::M84>(command);
+        out.push_back(cmd);
+      } break;
+
+      case hash("M104"): {
+        // Set Extruder Temperature, no wait
+        const instructions::M104 cmd = { command };
+        // Eliminate redundant/invalid commands
+        uint temperature = cmd.get_temperature();
+        uint extruder = cmd.get_number();
+
+        if (temperature == uint(-1) || temperature == extruder_temp[extruder])
+        {
+          break;
+        }
+
+        extruder_temp[extruder] = temperature;
+        out.push_back(arena->make<instructions::M104>(cmd));
+      } break;
+
+      case hash("M106"): {
+        // Fan On
+        const instructions::M106 cmd = { command };
+        // Eliminate redundant/invalid commands
+        uint speed = cmd.get_speed();
+        uint fan = cmd.get_number();
+
+        if (speed == fan_speeds[fan])
+        {
+          break;
+        }
+
+        fan_speeds[fan] = speed;
+        out.push_back(arena->make<instructions::M106>(cmd));
+      } break;
+
+      case hash("M107"): {
+        // Fan Off
+        const instructions::M107 cmd = { command };
+        // Eliminate redundant/invalid commands
+        uint fan = cmd.get_number();
+
+        if (0 == fan_speeds[fan])
+        {
+          break;
+        }
+
+        fan_speeds[fan] = 0;
+        out.push_back(arena->make<instructions::M107>(cmd));
+      } break;
+
+      case hash("M109"): {
+        // Set Extruder Temperature and wait
+        const instructions::M109 cmd = { command };
+        // Eliminate redundant/invalid commands
+        uint temperature = cmd.get_temperature();
+        uint extruder = cmd.get_number();
+
+        if (temperature == uint(-1) || temperature == extruder_temp[extruder])
+        {
+          break;
+        }
+
+        extruder_temp[extruder] = temperature;
+        out.push_back(arena->make<instructions::M109>(cmd));
+      } break;
+
+      case hash("M140"): {
+        // Set Bed Temperature, no wait
+        const instructions::M140 cmd = { command };
+        // Eliminate redundant/invalid commands
+        uint temperature = cmd.get_temperature();
+        uint heater = cmd.get_number();
+
+        if (temperature == uint(-1) || temperature == bed_temp[heater])
+        {
+          break;
+        }
+
+        bed_temp[heater] = temperature;
+        out.push_back(arena->make<instructions::M140>(cmd));
+      } break;
+
+      case hash("M190"): {
+        // Set Bed Temperature and wait
+        const instructions::M190 cmd = { command };
+        // Eliminate redundant/invalid commands
+        uint temperature = cmd.get_temperature();
+        uint heater = cmd.get_number();
+
+        if (temperature == uint(-1) || temperature == bed_temp[heater])
+        {
+          break;
+        }
+
+        bed_temp[heater] = temperature;
+        out.push_back(arena->make<instructions::M190>(cmd));
+      } break;
+
+      case hash("G28"): {
+        // Home
+        auto * __restrict cmd = arena->make<instructions::G28>(command);
+
+        if (cmd->axis().x)
+        {
+          position.x = 0.0;
+        }
+        if (cmd->axis().y)
+        {
+          position.y = 0.0;
+        }
+        if (cmd->axis().z)
+        {
+          position.z = 0.0;
+        }
+
+        out.push_back(cmd);
+      } break;
+
+      case hash("G90"): {
+        // Set Absolute Positioning
+        absolute_mode = true;
+      } break;
+
+      case hash("G91"): {
+        // Set Relative Positioning
+        absolute_mode = false;
+      } break;
+
+        // State Commands (these do not generate opcodes, and instead are used for calculating motion or other things)
+      case hash("M204"): {
+        // SET DEFAULT ACCELERATION
+        if (command.has_argument('S')) // Legacy, but still used by some slicers like Cura
+        {
+          print_accel = command.get_argument('S', print_accel);
+          travel_accel = command.get_argument('S', travel_accel);
+        }
+
+        print_accel = command.get_argument('P', print_accel);
+        travel_accel = command.get_argument('T', travel_accel);
+        retract_accel = command.get_argument('R', retract_accel);
+      } break;
+      case hash("M205"): {
+        // ADVANCED SETTINGS (jerk)
+        jerk.x = command.get_argument('X', jerk.x);
+        jerk.y = command.get_argument('Y', jerk.y);
+        jerk.z = command.get_argument('Z', jerk.z);
+        extrude_jerk = command.get_argument('E', extrude_jerk);
+      } break;
+
+      default: {
+        printf("Unknown Command: %.*s\n", int(command._cmd_string.length()), command._cmd_string.data());
+      } break;
+      }
+      __pragma(warning(default:4307));
+
+      prev_move_cmd = move_cmd;
+    }
+  };
+
+  // The arc passes work on any span of commands that nothing outside it can affect, which is what lets transform run them
+  // over many spans at once.
+
+  // Rounds the corners between consecutive moves with arcs. The arcs made, and the corners left alone, are added to counts.
+  static void generate_corner_arcs(std::vector<gcgg::command *> & __restrict out, const config & __restrict cfg, platform::arena & __restrict arena, stats::counts & __restrict counts)
+  {
+    if (out.size() < 2)
+    {
+      return;
+    }
+
+    // Arcs to insert, and the index of the command each goes before. They're collected rather than inserted as we go
+    // (which shifts the rest of the vector every time) and spliced in with a single pass at the end.
+    std::vector<std::pair<usize, gcgg::command *>> insertions;
+
+    auto prev_iter = out.begin();
+    for (auto iter = prev_iter + 1; iter != out.end();)
+    {
+      auto * __restrict prev_cmd = *prev_iter;
+      auto * __restrict cur_cmd = *iter;
+
+      // TODO we should really handle this case. I don't know how, yet.
+      if (prev_cmd->get_type() == segments::arc::type)
+      {
+        prev_iter = iter++;
+        continue;
+      }
+
+      if (!segments::is_move(*prev_cmd) || cur_cmd->is_delay())
+      {
+        prev_iter = iter++;
+        continue;
+      }
+
+      if (!segments::is_move(*cur_cmd))
+      {
+        // If the current command is not a movement command, we might need to just increment iter until
+        // we either find one, or we hit a delay instruction, as there might be non-moves between our moves
+        // that are inconsequential.
+        do
+        {
+          ++iter;
+
+          if (iter == out.end())
+          {
+            break;
+          }
+
+          cur_cmd = *iter;
+          if (segments::is_move(*cur_cmd))
+          {
+            goto continue_exec;
+          }
+
+          // If it's a delay instruction, we need to just keep moving, since it interrupts motion.
+          if (cur_cmd->is_delay())
+          {
+            goto continue_exec;
+          }
+
+        } while (iter != out.end());
+        break;
+      continue_exec:;
+
+        if (!segments::is_move(*cur_cmd) || cur_cmd->is_delay())
+        {
+          prev_iter = iter++;
+          continue;
+        }
+      }
+
+      segments::movement * __restrict prev_segment_cmd = static_cast<segments::movement * __restrict>(prev_cmd);
+      segments::movement * __restrict cur_segment_cmd = static_cast<segments::movement * __restrict>(cur_cmd);
+
+      // Calculate the angle between the two segments.
+      const vector3<> segment_vectors[2] = {
+        prev_segment_cmd->get_vector(),
+        cur_segment_cmd->get_vector(),
+      };
+
+      const vector3<> segment_norm_vectors[2] = {
+        segment_vectors[0].normalized(),
+        segment_vectors[1].normalized(),
+      };
+
+      const double angle = segment_norm_vectors[0].angle_between(segment_norm_vectors[1]);
+
+      if (angle <= cfg.arc.min_angle)
+      {
+        ++counts.corner_rejections[uint(stats::corner_rejection::shallow)];
+        prev_iter = iter++;
+        continue;
+      }
+
+      const bool is_travel = prev_segment_cmd->is_travel_ && cur_segment_cmd->is_travel_;
+
+      double arc_radius;
+      if (is_travel && cfg.arc.halve_travels)
+      {
+        arc_radius = min(
+          prev_segment_cmd->get_vector().length(),
+          cur_segment_cmd->get_vector().length() / 2
+        );
+      }
+      else
+      {
+        arc_radius = is_travel ? cfg.arc.travel_radius : cfg.arc.radius;
+      }
+
+      // TODO in reality we should be generating ovaloid arcs, to handle differences in velocity.
+
+      if (prev_segment_cmd->get_vector().length() < arc_radius || (cur_segment_cmd->get_vector().length() * 0.5) < arc_radius)
+      {
+        // TODO handle this situation by reducing arc length better than this. This is nasty.
+        if (prev_segment_cmd->get_vector().length() < arc_radius)
+        {
+          arc_radius = prev_segment_cmd->get_vector().length();
+        }
+        if ((cur_segment_cmd->get_vector().length() * 0.5) < arc_radius)
+        {
+          arc_radius = (cur_segment_cmd->get_vector().length() * 0.5);
+        }
+        if (arc_radius <= cfg.arc.min_radius)
+        {
+          ++counts.corner_rejections[uint(stats::corner_rejection::short_segments)];
+          prev_iter = iter++;
+          continue;
+        }
+      }
+
+      // Generate a split point for both segments
+      // Reduce any extrusion (and apply said extrusion to the arc)
+      const real segment_orig_lengths[2] = {
+        segment_vectors[0].length(),
+        segment_vectors[1].length()
+      };
+
+      const auto get_extrusion = [](const segments::segment *seg)->real
+      {
+        if (seg->get_type() != segments::extrusion_move::type)
+        {
+          return 0.0;
+        }
+        const segments::extrusion_move * __restrict extrusion_cmd = static_cast<const segments::extrusion_move * __restrict>(seg);
+        return extrusion_cmd->get_extrusion();
+      };
+
+      const auto set_extrusion = [](segments::segment *seg, real extrude)
+      {
+        if (seg->get_type() != segments::extrusion_move::type)
+        {
+          return;
+        }
+        segments::extrusion_move * __restrict extrusion_cmd = static_cast<segments::extrusion_move * __restrict>(seg);
+        return extrusion_cmd->set_extrude(extrude);
+      };
+
+      const real segment_orig_extrude[2] = {
+        get_extrusion(prev_segment_cmd),
+        get_extrusion(cur_segment_cmd)
+      };
+
+      const real segment_new_fraction[2] = {
+        (segment_orig_lengths[0] - arc_radius) / segment_orig_lengths[0],
+        (segment_orig_lengths[1] - arc_radius) / segment_orig_lengths[1]
+      };
+    
+      const vector3<> corner = prev_segment_cmd->get_end_position();
+      const vector3<> prev_seg_new_end = prev_segment_cmd->get_start_position() + (segment_vectors[0] * segment_new_fraction[0]);
+      const vector3<> cur_seg_new_start = cur_segment_cmd->get_end_position() - (segment_vectors[1] * segment_new_fraction[1]);
+
+      const real segment_new_extrude[2] = {
+        segment_orig_extrude[0] * segment_new_fraction[0],
+        segment_orig_extrude[1] * segment_new_fraction[1]
+      };
+
+      const real segment_extrude_remainder[2] = {
+        segment_orig_extrude[0] - segment_new_extrude[0],
+        segment_orig_extrude[1] - segment_new_extrude[1]
+      };
+
+      if (is_equal(prev_seg_new_end.distance(cur_seg_new_start), 0.0))
+      {
+        ++counts.corner_rejections[uint(stats::corner_rejection::degenerate)];
+        prev_iter = iter++;
+        continue;
+      }
+
+      ++counts.corner_arcs;
+
+      set_extrusion(prev_segment_cmd, segment_new_extrude[0]);
+      set_extrusion(cur_segment_cmd, segment_new_extrude[1]);
+      prev_segment_cmd->set_end_position(prev_seg_new_end);
+      cur_segment_cmd->set_start_position(cur_seg_new_start);
+
+      real start_feedrate = prev_segment_cmd->get_feedrate();
+      real end_feedrate = cur_segment_cmd->get_feedrate();
+      if (cfg.arc.constant_speed)
+      {
+        // If we are a constant speed arc, average out the two feedrates.
+        start_feedrate = end_feedrate = (start_feedrate + end_feedrate) * 0.5;
+      }
+
+      // Braced lists can't be forwarded through arena::make, so the pairs are named.
+      const real arc_feedrates[2] = { start_feedrate, end_feedrate };
+      const real arc_accelerations[2] = { prev_segment_cmd->acceleration_hint_,  cur_segment_cmd->acceleration_hint_ };
+      const vector3<> arc_jerks[2] = { prev_segment_cmd->jerk_hint_,  cur_segment_cmd->jerk_hint_ };
+      const real arc_extrude_jerks[2] = { prev_segment_cmd->jerk_extrude_hint_,  cur_segment_cmd->jerk_extrude_hint_ };
+
+      auto * __restrict new_arc = arena.make<segments::arc>(
+        segment_extrude_remainder,
+        arc_feedrates,
+        arc_accelerations,
+        arc_jerks,
+        arc_extrude_jerks,
+        corner,
+        prev_seg_new_end,
+        cur_seg_new_start,
+        arc_radius,
+        angle
+      );
+
+      new_arc->parent_velocities_[0] = (prev_segment_cmd->get_end_position() - prev_segment_cmd->get_start_position()).normalized(prev_segment_cmd->get_feedrate());
+      new_arc->parent_velocities_[1] = (cur_segment_cmd->get_end_position() - cur_segment_cmd->get_start_position()).normalized(cur_segment_cmd->get_feedrate());
+
+      new_arc->is_travel_ = is_travel;
+
+      // Do we need to delete the previous segment (has it been completely replaced with arcs?
+      // TODO currently we never destroy the current segment as we check against half-lengths. We should revisit that.
+      if (is_equal(prev_segment_cmd->get_vector().length(), 0.0))
+      {
+        *prev_iter = new_arc;
+      }
+      else
+      {
+        insertions.push_back({ usize(iter - out.begin()), new_arc }); // goes before cur_seg.
+      }
+
+      prev_iter = iter++;
+    }
+
+    if (!insertions.empty())
+    {
+      std::vector<gcgg::command *> result;
+      result.reserve(out.size() + insertions.size());
+
+      auto insertion = insertions.begin();
+      for (usize i = 0; i < out.size(); ++i)
+      {
+        for (; insertion != insertions.end() && insertion->first == i; ++insertion)
+        {
+          result.push_back(insertion->second);
+        }
+        result.push_back(out[i]);
+      }
+
+      out = std::move(result);
+    }
+  }
+
+  // Replaces runs of segments that lie along a circle with arcs. The arcs made, and the runs that didn't fit one, are
+  // added to counts.
+  static void generate_arcs(std::vector<gcgg::command *> & __restrict out, const config & __restrict cfg, platform::arena & __restrict arena, stats::counts & __restrict counts)
+  {
+    const uint64 consumed_before = counts.fitted_segments;
+    segments::arc_accumulator accumulator;
+
+    // The output is rebuilt as we go, with each finished arc placed after the segments it consumed.
+    std::vector<gcgg::command *> result;
+    result.reserve(out.size());
+
+    const auto flush_accumulator = [&]() -> bool
+    {
+      if (accumulator.conditional_reset())
+      {
+        // Too few segments to be an arc.
+        return false;
+      }
+
+      stats::fit_rejection rejection;
+      if (accumulator.fit(cfg, &rejection))
+      {
+        // If the accumulator is actually valid, and a circle fits it, it means we've generated an arc.
+        for (segments::movement * __restrict seg : accumulator.get_segments())
+        {
+          seg->consumed_ = true;
+        }
+        counts.fitted_segments += accumulator.get_segment_count();
+        result.push_back(arena.make<segments::arc_accumulator>(std::move(accumulator)));
+        ++counts.fitted_arcs;
+        accumulator.reset();
+        return true;
+      }
+      // No circle fits them closely enough: they're left as they are.
+      ++counts.fit_rejections[uint(rejection)];
+      accumulator.reset();
+      return false;
+    };
+
+    for (gcgg::command * cmd : out)
+    {
+      if (!segments::is_move(*cmd))
+      {
+        // We don't consume this one.
+        flush_accumulator();
+        result.push_back(cmd);
+        continue;
+      }
+
+      segments::movement * __restrict segment_cmd = static_cast<segments::movement * __restrict>(cmd);
+
+      // If we don't consume this, this arc is finished, if it exists at all. A segment that finishes an arc gets
+      // another chance as the start of the next one.
+      if (!accumulator.consume_segment(*segment_cmd, cfg) && flush_accumulator() && !accumulator.consume_segment(*segment_cmd, cfg))
+      {
+        flush_accumulator();
+      }
+
+      result.push_back(cmd);
+    }
+    flush_accumulator();
+
+    out = std::move(result);
+
+    // Sweep out the segments that were consumed by arcs.
+    if (counts.fitted_segments != consumed_before)
+    {
+      out.erase(
+        std::remove_if(out.begin(), out.end(), [](const gcgg::command * cmd)
+        {
+          return cmd->is_segment() && static_cast<const segments::segment *>(cmd)->consumed_;
+        }),
+        out.end()
+      );
+    }
+  }
+
+  // Turns arcs back into segments where the output wants them that way. The arcs subdivided are added to counts.
+  static void subdivide_arcs(std::vector<gcgg::command *> & __restrict out, const config & __restrict cfg, platform::arena & __restrict arena, stats::counts & __restrict counts)
+  {
+    std::vector<gcgg::command *> result;
+    result.reserve(out.size());
+    std::vector<vector3<>> points;
+
+    for (gcgg::command * cmd : out)
+    {
+      if (cmd->get_type() != segments::arc::type)
+      {
+        result.push_back(cmd);
+        continue;
+      }
+
+      gcgg::segments::arc * __restrict arc_seg = static_cast<gcgg::segments::arc * __restrict>(cmd);
+
+      if (arc_seg->should_subdivide(cfg))
+      {
+        arc_seg->generate_segments(cfg, arena, points, result);
+        ++counts.subdivided_arcs;
+      }
+      else
+      {
+        result.push_back(cmd);
+      }
+    }
+
+    out = std::move(result);
+
+  }
+
+  // Simplifies every run of extrusion moves (joined end to start, with the same feedrate and hints) in place, as set up in
+  // cfg.simplify. Each kept segment takes over the extrusion of the ones it replaces. Returns the number of segments
+  // removed.
+  static usize simplify_extrusions(std::vector<gcgg::command *> & __restrict out, const config & __restrict cfg)
+  {
+    using segments::extrusion_move;
+
+    const auto joins = [](const extrusion_move * __restrict prev, const extrusion_move * __restrict cur) -> bool
+    {
+      return
+        prev->get_end_position() == cur->get_start_position() &&
+        prev->get_feedrate() == cur->get_feedrate() &&
+        prev->acceleration_hint_ == cur->acceleration_hint_ &&
+        prev->jerk_hint_ == cur->jerk_hint_ &&
+        prev->jerk_extrude_hint_ == cur->jerk_extrude_hint_;
+    };
+
+    // Filament per minute, as the merge pass measures it.
+    const auto extrusion_rate = [](real extrusion, real length, real feedrate) -> real
+    {
+      return extrusion / (length / feedrate);
+    };
+
+    // Distance from point to the line segment from start to end.
+    const auto distance = [](const vector3<> & __restrict point, const vector3<> & __restrict start, const vector3<> & __restrict end) -> real
+    {
+      const vector3<> line = end - start;
+      const real length_sq = line.length_sq();
+      const real t = (length_sq > 0.0) ? clamp((point - start).dot(line) / length_sq, 0.0, 1.0) : 0.0;
+      return point.distance(start + (line * t));
+    };
+
+    usize removed = 0;
+    usize write = 0;
+
+    // Reused from run to run. The run's vertices run from the start of its first segment to the end of its last, and the
+    // extrusion is cumulative up to each vertex.
+    std::vector<extrusion_move *> run;
+    std::vector<vector3<>> vertices;
+    std::vector<real> extrusions;
+    std::vector<bool> keep;
+    std::vector<std::pair<usize, usize>> spans;
+
+    const auto flush_run = [&]()
+    {
+      const usize count = run.size();
+      if (count < 2)
+      {
+        for (extrusion_move * __restrict seg : run)
+        {
+          out[write++] = seg;
+        }
+        run.clear();
+        return;
+      }
+
+      const real feedrate = run.front()->get_feedrate();
+
+      vertices.clear();
+      extrusions.clear();
+      vertices.push_back(run.front()->get_start_position());
+      extrusions.push_back(0.0);
+      for (const extrusion_move * __restrict seg : run)
+      {
+        vertices.push_back(seg->get_end_position());
+        extrusions.push_back(extrusions.back() + seg->get_extrusion());
+      }
+
+      keep.assign(count + 1, false);
+      keep.front() = true;
+      keep.back() = true;
+
+      spans.clear();
+      spans.push_back({ 0, count });
+      while (!spans.empty())
+      {
+        const auto [first, last] = spans.back();
+        spans.pop_back();
+        if (last - first < 2)
+        {
+          continue;
+        }
+
+        // Find the vertex furthest from the line that would replace everything between first and last, and check that
+        // the line's flow rate would be within epsilon of every segment's it replaces.
+        const real chord = vertices[first].distance(vertices[last]);
+        const real chord_rate = (chord > 0.0) ? extrusion_rate(extrusions[last] - extrusions[first], chord, feedrate) : 0.0;
+
+        bool flow_ok = chord > 0.0;
+        real furthest_distance = 0.0;
+        usize furthest = (first + last) / 2;
+        for (usize i = first; i < last; ++i)
+        {
+          if (i != first)
+          {
+            const real vertex_distance = distance(vertices[i], vertices[first], vertices[last]);
+            if (vertex_distance > furthest_distance)
+            {
+              furthest_distance = vertex_distance;
+              furthest = i;
+            }
+          }
+
+          const real seg_rate = extrusion_rate(extrusions[i + 1] - extrusions[i], vertices[i].distance(vertices[i + 1]), feedrate);
+          flow_ok = flow_ok && is_equal(chord_rate, seg_rate, cfg.extrusion.epsilon);
+        }
+
+        if (furthest_distance > cfg.simplify.tolerance || !flow_ok)
+        {
+          keep[furthest] = true;
+          spans.push_back({ first, furthest });
+          spans.push_back({ furthest, last });
+        }
+      }
+
+      // Each kept vertex's segment now runs to the next kept vertex, and takes all of the extrusion along the way.
+      usize start = 0;
+      for (usize i = 1; i <= count; ++i)
+      {
+        if (!keep[i])
+        {
+          continue;
+        }
+
+        extrusion_move * __restrict seg = run[start];
+        seg->set_end_position(vertices[i]);
+        seg->set_extrusion(extrusions[i] - extrusions[start]);
+        out[write++] = seg;
+        removed += i - start - 1;
+        start = i;
+      }
+
+      run.clear();
+    };
+
+    for (gcgg::command * __restrict cmd : out)
+    {
+      if (cmd->get_type() == extrusion_move::type)
+      {
+        extrusion_move * seg = static_cast<extrusion_move *>(cmd);
+        if (seg->get_vector().length() > 0.0)
+        {
+          if (!run.empty() && !joins(run.back(), seg))
+          {
+            flush_run();
+          }
+          run.push_back(seg);
+          continue;
+        }
+      }
+
+      flush_run();
+      out[write++] = cmd;
+    }
+    flush_run();
+
+    out.resize(write);
+    return removed;
+  }
+
+  // Runs pass(span, span_arena) over out cut into spans, concurrently on the thread pool, and splices the results back
+  // together in order. can_split(out, i) says whether a span may start at out[i]: the pass must do exactly the same to
+  // the commands either side of such a cut as it would have to the whole. Spans are only cut as finely as it takes to
+  // keep every thread busy, and each gets its own arena (made in arena, so it lives just as long) to make commands in.
+  template <typename Split, typename Pass>
+  static void for_each_span(std::vector<gcgg::command *> & __restrict out, platform::arena & __restrict arena, const Split & __restrict can_split, const Pass & __restrict pass)
+  {
+    // Smaller spans aren't worth a job of their own.
+    static constexpr const usize min_span_size = 4096;
+
+    auto & __restrict pool = platform::thread_pool::get();
+    // Several spans per thread, as they can be very uneven: work stealing evens them out.
+    const usize max_spans = (pool.size() > 1) ? (usize(pool.size()) * 4) : 1;
+    const usize target_size = max(min_span_size, (out.size() + max_spans - 1) / max_spans);
+
+    std::vector<usize> starts = { 0 };
+    for (usize i = 1; i < out.size(); ++i)
+    {
+      if (i - starts.back() >= target_size && can_split(out, i))
+      {
+        starts.push_back(i);
+      }
+    }
+
+    if (starts.size() == 1)
+    {
+      pass(out, arena);
+      return;
+    }
+    starts.push_back(out.size());
+
+    const usize span_count = starts.size() - 1;
+    std::vector<std::vector<gcgg::command *>> spans(span_count);
+    std::vector<platform::arena *> span_arenas(span_count);
+    for (usize i = 0; i < span_count; ++i)
+    {
+      spans[i].assign(out.begin() + starts[i], out.begin() + starts[i + 1]);
+      span_arenas[i] = arena.make<platform::arena>();
+    }
+
+    pool.parallel_for(span_count, [&](usize i)
+    {
+      pass(spans[i], *span_arenas[i]);
+    });
+
+    usize total = 0;
+    for (const auto & __restrict span : spans)
+    {
+      total += span.size();
+    }
+
+    out.clear();
+    out.reserve(total);
+    for (auto & __restrict span : spans)
+    {
+      out.insert(out.end(), span.begin(), span.end());
+      std::vector<gcgg::command *>().swap(span);
+    }
+  }
+
+  // Estimates taken either side of the passes in transform.
+  struct estimates final
+  {
+    motion::estimate before;
+    motion::estimate after;
+
+    void report(const config & __restrict cfg) const __restrict
+    {
+      before.report("before optimization", cfg.estimate.per_layer);
+      after.report("after optimization", cfg.estimate.per_layer);
+      motion::estimate::report_change(before, after);
+    }
+  };
+
+  // Links each segment to its neighbours (a delay ends the chain), clearing any links left from an earlier pass, has every
+  // segment work out its junction limits, and then plans speeds along each chain.
+  static void plan_motion(std::vector<gcgg::command *> & __restrict out, const config & __restrict cfg, bool report, stats::report * __restrict stats)
+  {
+    stats::stage stage = { stats, "plan", out.size() };
+
+    // printf, but only when reporting.
+    const auto progress = [report](const char * __restrict format)
+    {
+      if (report)
+      {
+        printf("%s", format);
+      }
+    };
+
+    progress("Linking motion segments\n");
+    {
+      gcgg::segments::segment * __restrict prev_seg = nullptr;
+      for (gcgg::command * __restrict cmd : out)
+      {
+        if (!cmd->is_segment())
+        {
+          if (cmd->is_delay())
+          {
+            prev_seg = nullptr;
+          }
+          continue;
+        }
+
+        gcgg::segments::segment * __restrict cur_seg = static_cast<gcgg::segments::segment * __restrict>(cmd);
+        cur_seg->prev_segment_ = prev_seg;
+        cur_seg->next_segment_ = nullptr;
+        if (prev_seg)
+        {
+          prev_seg->next_segment_ = cur_seg;
+        }
+
+        prev_seg = cur_seg;
+      }
+    }
+
+    progress("Calculating Motion\n");
+    for (auto * __restrict seg : out)
+    {
+      seg->compute_motion(cfg);
+    }
+
+    progress("Planning Motion\n");
+    motion::plan(out, cfg);
+
+    stage.finish(out.size());
+  }
+
+  // Runs every optimization pass over a sequence of interpreted commands, in place, leaving the motion to be planned. New
+  // commands are made in the given arena; commands removed from the sequence are simply abandoned to whichever arena they
+  // came from. The passes only report progress when asked to, as streaming runs them once per window (and cache.layers
+  // once per layer). Each pass is timed as a stage of stats, if given. Returns what the passes did.
+  static stats::counts optimize(std::vector<gcgg::command *> & __restrict out, const config & __restrict cfg, platform::arena & __restrict arena, bool report, stats::report * __restrict stats)
+  {
+    // printf, but only when reporting.
+    const auto progress = [report](const char * __restrict format, auto... args)
+    {
+      if (report)
+      {
+        printf(format, args...);
+      }
+    };
+
+    stats::counts counts;
+
+    // Passes that run over spans at once count each span on its own.
+    std::mutex counts_mutex;
+    const auto add_counts = [&](const stats::counts & __restrict span_counts)
+    {
+      std::lock_guard<std::mutex> lock(counts_mutex);
+      counts.add(span_counts);
+    };
+
+    stats::stage merge_stage = { stats, "merge", out.size() };
+
+    usize contiguous_segment_count = 0;
+    usize move_commands_orig = 0;
+
+    for (const auto * __restrict cmd : out)
+    {
+      switch (cmd->get_type())
+      {
+      case segments::extrusion_move::type:
+      case segments::hop::type:
+      case segments::linear::type:
+      case segments::travel::type: {
+        ++move_commands_orig;
+      }
+      }
+    }
+
+    if (out.size() >= 2)
+    {
+      progress("Eliminating redundant movements...\n");
+      // Now we compact the commands by finding ones that can be merged. Commands are compacted in place as we go:
+      // prev_iter is the last command kept, and anything merged into it is simply not copied down.
+      auto prev_iter = out.begin();
+      for (auto iter = prev_iter + 1; iter != out.end(); ++iter)
+      {
+        auto * __restrict prev_cmd = *prev_iter;
+        const auto * __restrict cur_cmd = *iter;
+
+        // Only valid if they're the same command type.
+        if (prev_cmd->get_type() == cur_cmd->get_type())
+        {
+          // Also only valid if they're movement types.
+          switch (cur_cmd->get_type())
+          {
+          case segments::extrusion_move::type:
+          case segments::hop::type:
+          case segments::linear::type:
+          case segments::travel::type: {
+            segments::movement * __restrict prev_move_cmd = static_cast<segments::movement * __restrict>(prev_cmd);
+            const segments::movement * __restrict cur_move_cmd = static_cast<const segments::movement * __restrict>(cur_cmd);
+
+            // They must have the same feedrate as well.
+            if (prev_move_cmd->get_feedrate() != cur_move_cmd->get_feedrate())
+            {
+              break;
+            }
+
+            const vector3<> prev_vector = prev_move_cmd->get_vector().normalized();
+            const vector3<> cur_vector = cur_move_cmd->get_vector().normalized();
+
+            const real dot_product = prev_vector.dot(cur_vector);
+
+            if (!is_equal(dot_product, 1.0))
+            {
+              break;
+            }
+
+            static constexpr const bool compare_hints = true;
+
+            // If this is an extrusion, make sure the extrusion rate is the same.
+            if (cur_cmd->get_type() == segments::extrusion_move::type)
+            {
+              const real prev_time = prev_move_cmd->get_vector().length() / prev_move_cmd->get_feedrate();
+              const real cur_time = cur_move_cmd->get_vector().length() / cur_move_cmd->get_feedrate();
+
+              const segments::extrusion_move * __restrict prev_extrusion_cmd = static_cast<const segments::extrusion_move * __restrict>(prev_cmd);
+              const segments::extrusion_move * __restrict cur_extrusion_cmd = static_cast<const segments::extrusion_move * __restrict>(cur_cmd);
+          
+              const real prev_extrude = prev_extrusion_cmd->get_extrusion();
+              const real cur_extrude = cur_extrusion_cmd->get_extrusion();
+
+              const real prev_extrusion_rate = prev_extrude / prev_time;
+              const real cur_extrusion_rate = cur_extrude / cur_time;
+
+              if (!is_equal(prev_extrusion_rate, cur_extrusion_rate, cfg.extrusion.epsilon))
+              {
+                break;
+              }
+
+              if constexpr (compare_hints)
+              {
+                if (!is_equal(prev_move_cmd->jerk_extrude_hint_, cur_move_cmd->jerk_extrude_hint_))
+                {
+                  break;
+                }
+              }
+            }
+
+            if constexpr (compare_hints)
+            {
+              // Validate that acceleration/jerk are similar.
+              const real prev_acceleration_hint = prev_move_cmd->acceleration_hint_;
+              const real cur_acceleration_hint = cur_move_cmd->acceleration_hint_;
+
+              const vector3<> prev_jerk_hint = prev_move_cmd->jerk_hint_;
+              const vector3<> cur_jerk_hint = cur_move_cmd->jerk_hint_;
+
+              if (!is_equal(prev_acceleration_hint, cur_acceleration_hint))
+              {
+                break;
+              }
+
+              if (!is_equal(prev_jerk_hint, cur_jerk_hint))
+              {
+                break;
+              }
+            }
+
+            // Otherwise, these appear to be contiguous segments.
+            ++contiguous_segment_count;
+
+            prev_move_cmd->set_end_position(cur_move_cmd->get_end_position());
+            if (cur_cmd->get_type() == segments::extrusion_move::type)
+            {
+              segments::extrusion_move * __restrict prev_extrusion_cmd = static_cast<segments::extrusion_move * __restrict>(prev_cmd);
+              const segments::extrusion_move * __restrict cur_extrusion_cmd = static_cast<const segments::extrusion_move * __restrict>(cur_cmd);
+
+              prev_extrusion_cmd->set_extrusion(prev_extrusion_cmd->get_extrusion() + cur_extrusion_cmd->get_extrusion());
+            }
+
+            continue;
+
+          } break;
+          }
+        }
+
+        *++prev_iter = *iter;
+      }
+      out.erase(prev_iter + 1, out.end());
+    }
+
+    if (contiguous_segment_count)
+    {
+      const double reduction = 100.0 * (double(move_commands_orig - contiguous_segment_count) / double(move_commands_orig));
+      progress(
+        "Merged %llu contiguous segments (%.2f%% original count - %llu -> %llu)\n",
+        contiguous_segment_count,
+        reduction,
+        move_commands_orig,
+        move_commands_orig - contiguous_segment_count
+      );
+    }
+    counts.merged_segments = contiguous_segment_count;
+    merge_stage.finish(out.size());
+
+    if (cfg.simplify.enable && out.size() >= 2)
+    {
+      progress("Simplifying extrusions...\n");
+      stats::stage stage = { stats, "simplify", out.size() };
+
+      usize extrusions_orig = 0;
+      for (const auto * __restrict cmd : out)
+      {
+        extrusions_orig += (cmd->get_type() == segments::extrusion_move::type) ? 1 : 0;
+      }
+
+      // Runs of extrusion moves are independent of everything around them.
+      for_each_span(out, arena,
+        [](const std::vector<gcgg::command *> & __restrict cmds, usize i)
+        {
+          return cmds[i - 1]->get_type() != segments::extrusion_move::type || cmds[i]->get_type() != segments::extrusion_move::type;
+        },
+        [&](std::vector<gcgg::command *> & __restrict span, platform::arena & __restrict)
+        {
+          stats::counts span_counts;
+          span_counts.simplified_extrusions = simplify_extrusions(span, cfg);
+          add_counts(span_counts);
+        }
+      );
+
+      const usize removed = usize(counts.simplified_extrusions);
+      if (removed)
+      {
+        const double reduction = 100.0 * (double(extrusions_orig - removed) / double(extrusions_orig));
+        progress(
+          "Simplified away %llu extrusion segments (%.2f%% original count - %llu -> %llu)\n",
+          removed,
+          reduction,
+          extrusions_orig,
+          extrusions_orig - removed
+        );
+      }
+
+      stage.finish(out.size());
+    }
+
+    // Motion is planned more than once, as the arc passes need it and then change the segments.
+    plan_motion(out, cfg, report, stats);
+
+    if (cfg.smoothing.enable && out.size() >= 2)
+    {
+      progress("Smoothing surface...\n");
+
+    }
+
+    if (cfg.arc.generate && out.size() >= 2)
+    {
+      progress("Generating arc segments...\n");
+      stats::stage stage = { stats, "corner_arcs", out.size() };
+
+      // A corner can't be rounded across a delay, but it can be across anything else.
+      for_each_span(out, arena,
+        [](const std::vector<gcgg::command *> & __restrict cmds, usize i) { return cmds[i - 1]->is_delay(); },
+        [&](std::vector<gcgg::command *> & __restrict span, platform::arena & __restrict span_arena)
+        {
+          stats::counts span_counts;
+          generate_corner_arcs(span, cfg, span_arena, span_counts);
+          add_counts(span_counts);
+        }
+      );
+
+      progress("Generated Corner Arcs: %llu\n", counts.corner_arcs);
+      stage.finish(out.size());
+    }
+
+    // Generate arcs where possible.
+    if (cfg.reg_arc_gen.enable)
+    {
+      progress("Generating Arcs from curved segment sets\n");
+      stats::stage stage = { stats, "fit_arcs", out.size() };
+
+      // Anything that isn't a plain move ends an arc, and so does a change of layer when arcs can't move on Z.
+      const auto can_split = [&](const std::vector<gcgg::command *> & __restrict cmds, usize i)->bool
+      {
+        if (!segments::is_move(*cmds[i - 1]) || !segments::is_move(*cmds[i]))
+        {
+          return true;
+        }
+        return !cfg.output.arcs_support_Z && static_cast<const segments::movement *>(cmds[i])->get_vector().z != 0.0;
+      };
+
+      for_each_span(out, arena, can_split, [&](std::vector<gcgg::command *> & __restrict span, platform::arena & __restrict span_arena)
+      {
+        stats::counts span_counts;
+        generate_arcs(span, cfg, span_arena, span_counts);
+        add_counts(span_counts);
+      });
+
+      if (counts.fitted_segments)
+      {
+        progress("Performing segment garbage collection... (%llu segments to delete)\n", counts.fitted_segments);
+      }
+      progress("Generated Arcs: %llu\n", counts.fitted_arcs);
+      stage.finish(out.size());
+    }
+
+    if (cfg.arc.generate && cfg.output.subdivide_arcs)
+    {
+      progress("Subdividing Arcs\n");
+      stats::stage stage = { stats, "subdivide_arcs", out.size() };
+
+      // Every arc is subdivided on its own.
+      for_each_span(out, arena,
+        [](const std::vector<gcgg::command *> & __restrict, usize) { return true; },
+        [&](std::vector<gcgg::command *> & __restrict span, platform::arena & __restrict span_arena)
+        {
+          stats::counts span_counts;
+          subdivide_arcs(span, cfg, span_arena, span_counts);
+          add_counts(span_counts);
+        }
+      );
+
+      stage.finish(out.size());
+    }
+
+    return counts;
+  }
+
+  // Adds planned motion to one side of the estimates, timed as a stage of stats (if given).
+  static void add_estimate(motion::estimate & __restrict estimate, const std::vector<gcgg::command *> & __restrict out, stats::report * __restrict stats)
+  {
+    stats::stage stage = { stats, "estimate", out.size() };
+    estimate.add(out);
+    stage.finish(out.size());
+  }
+
+  // Optimizes a sequence of interpreted commands (see optimize) and plans its motion. estimates and stats are optional, and
+  // are added to rather than replaced.
+  static void transform(std::vector<gcgg::command *> & __restrict out, const config & __restrict cfg, platform::arena & __restrict arena, estimates * __restrict estimates, bool report, stats::report * __restrict stats)
+  {
+    if (estimates)
+    {
+      plan_motion(out, cfg, report, stats);
+      add_estimate(estimates->before, out, stats);
+    }
+
+    const stats::counts counts = optimize(out, cfg, arena, report, stats);
+    if (stats)
+    {
+      stats->counts.add(counts);
+    }
+    plan_motion(out, cfg, report, stats);
+
+    if (estimates)
+    {
+      add_estimate(estimates->after, out, stats);
+    }
+  }
+
+  // Whether the commands before commands[i] can be optimized independently of those from it on. Merging and arc fitting
+  // only ever join consecutive moves of the same type, and nothing joins across a delay, so any point between two commands
+  // that differ in type (or after a delay) is clean.
+  static bool is_clean_cut(const std::vector<gcgg::command *> & __restrict commands, usize i)
+  {
+    const gcgg::command * __restrict prev_cmd = commands[i - 1];
+    const gcgg::command * __restrict cur_cmd = commands[i];
+    return prev_cmd->is_delay() || !prev_cmd->is_segment() || prev_cmd->get_type() != cur_cmd->get_type();
+  }
+
+  // Whether the corner arc pass might round the corner between the last move before commands[i] and the first one from
+  // it on. It pairs every move with the next, across anything but a delay, and leaves corners within arc.min_angle alone.
+  // Merging never turns a move, but simplifying can, so a corner at an extrusion move is only trusted without it. The
+  // margin covers merged moves pointing a hair differently to their parts.
+  static bool can_round_across(const std::vector<gcgg::command *> & __restrict commands, usize i, const config & __restrict cfg)
+  {
+    static constexpr const real angle_margin = 1.0;
+
+    const segments::movement * __restrict moves[2] = { nullptr, nullptr };
+    for (usize j = i; j-- > 0;)
+    {
+      if (commands[j]->is_delay())
+      {
+        return false;
+      }
+      if (segments::is_move(*commands[j]))
+      {
+        moves[0] = static_cast<const segments::movement * __restrict>(commands[j]);
+        break;
+      }
+    }
+    for (usize j = i; j < commands.size(); ++j)
+    {
+      if (commands[j]->is_delay())
+      {
+        return false;
+      }
+      if (segments::is_move(*commands[j]))
+      {
+        moves[1] = static_cast<const segments::movement * __restrict>(commands[j]);
+        break;
+      }
+    }
+    if (!moves[0] || !moves[1])
+    {
+      return false;
+    }
+
+    if (cfg.simplify.enable && (moves[0]->get_type() == segments::extrusion_move::type || moves[1]->get_type() == segments::extrusion_move::type))
+    {
+      return true;
+    }
+
+    const real angle = moves[0]->get_vector().normalized().angle_between(moves[1]->get_vector().normalized());
+    return !(angle <= cfg.arc.min_angle - angle_margin);
+  }
+
+  // Like transform, but a layer at a time, with each layer's optimized commands taken from the cache if it's been through
+  // the passes before, and cached if it hasn't. A layer starts at the first clean cut at or after a move that changes Z
+  // (and, with arc.generate, where no corner arc could be made across it), so that the layers come out exactly as they
+  // would from transform.
+  // Motion is planned once the layers are put back together, as a layer's speeds depend on its neighbours'. The layers
+  // run side by side, so they're timed as a single stage of stats; only their counts are kept.
+  static void transform_layers(std::vector<gcgg::command *> & __restrict out, const config & __restrict cfg, platform::arena & __restrict arena, estimates * __restrict estimates, stats::report * __restrict stats)
+  {
+    // Layers make a lot of small arenas, most of which only need a little.
+    static constexpr const usize layer_block_size = 64 * 1024;
+
+    if (estimates)
+    {
+      plan_motion(out, cfg, false, stats);
+      add_estimate(estimates->before, out, stats);
+    }
+
+    stats::stage stage = { stats, "layers", out.size() };
+
+    std::vector<usize> starts = { 0 };
+    bool changed_z = false;
+    for (usize i = 1; i < out.size(); ++i)
+    {
+      if (out[i]->is_segment())
+      {
+        const segments::movement * __restrict move = static_cast<const segments::movement * __restrict>(out[i]);
+        changed_z = changed_z || (move->get_start_position().z != move->get_end_position().z);
+      }
+
+      if (changed_z && is_clean_cut(out, i) && !(cfg.arc.generate && can_round_across(out, i, cfg)))
+      {
+        starts.push_back(i);
+        changed_z = false;
+      }
+    }
+    starts.push_back(out.size());
+
+    const usize layer_count = starts.size() - 1;
+    std::vector<std::vector<gcgg::command *>> layers(layer_count);
+    std::vector<stats::counts> layer_counts(layer_count);
+    std::vector<platform::arena *> layer_arenas(layer_count);
+    for (usize i = 0; i < layer_count; ++i)
+    {
+      layer_arenas[i] = arena.make<platform::arena>(layer_block_size);
+    }
+
+    printf("Processing %llu layers...\n", uint64(layer_count));
+
+    std::atomic<usize> cached_layers = 0;
+    platform::thread_pool::get().parallel_for(layer_count, [&](usize i)
+    {
+      std::vector<gcgg::command *> & __restrict layer = layers[i];
+
+      cache::key key;
+      const bool cacheable = cache::make_layer_key(out, starts[i], starts[i + 1], cfg, key);
+      if (cacheable)
+      {
+        cache::reader entry = { key, cfg, cache::entry::layer };
+        if (entry.is_valid() && entry.read(layer, *layer_arenas[i], std::numeric_limits<usize>::max()))
+        {
+          ++cached_layers;
+          return;
+        }
+        layer.clear();
+      }
+
+      layer.assign(out.begin() + starts[i], out.begin() + starts[i + 1]);
+      layer_counts[i] = optimize(layer, cfg, *layer_arenas[i], false, nullptr);
+
+      if (cacheable)
+      {
+        cache::writer entry = { key, cfg, cache::entry::layer };
+        entry.write(layer);
+        entry.commit();
+      }
+    });
+
+    printf("Reprocessed %llu layers, took %llu from the cache\n", uint64(layer_count - cached_layers), uint64(cached_layers));
+
+    if (stats)
+    {
+      for (const stats::counts & __restrict counts : layer_counts)
+      {
+        stats->counts.add(counts);
+      }
+      stats->counts.cached_layers += cached_layers;
+      stats->counts.reprocessed_layers += layer_count - cached_layers;
+    }
+
+    usize total = 0;
+    for (const auto & __restrict layer : layers)
+    {
+      total += layer.size();
+    }
+
+    out.clear();
+    out.reserve(total);
+    for (auto & __restrict layer : layers)
+    {
+      out.insert(out.end(), layer.begin(), layer.end());
+      std::vector<gcgg::command *>().swap(layer);
+    }
+
+    stage.finish(out.size());
+
+    plan_motion(out, cfg, true, stats);
+
+    if (estimates)
+    {
+      add_estimate(estimates->after, out, stats);
+    }
+  }
+}
+
+std::vector<gcgg::command *> gcode::process(const config & __restrict cfg, platform::arena & __restrict arena, stats::report * __restrict stats) const __restrict
+{
+  stats::stage parse_stage = { stats, "parse", 0, file_.size() };
+  const std::vector<gc::command> commands = parse(file_.data(), file_.size());
+  parse_stage.finish(commands.size());
+
+  printf("Processing...\n");
+
+  // Using a custom vector class would let use implement it using realloc which would likely be substantially faster.
+  // This, however, would add another mess of maintenence, so I'm not doing it, at least right now.
+  std::vector<gcgg::command *> out;
+  // Reserve
+  out.reserve(commands.size() * 20);
+
+  stats::stage interpret_stage = { stats, "interpret", commands.size() };
+  interpreter state = { cfg, arena };
+  for (const auto & __restrict command : commands)
+  {
+    state.interpret(command, out);
+  }
+  interpret_stage.finish(out.size());
+
+  estimates estimates;
+  if (cfg.cache.enable && cfg.cache.layers)
+  {
+    transform_layers(out, cfg, arena, cfg.estimate.enable ? &estimates : nullptr, stats);
+  }
+  else
+  {
+    transform(out, cfg, arena, cfg.estimate.enable ? &estimates : nullptr, true, stats);
+  }
+
+  if (cfg.estimate.enable)
+  {
+    estimates.report(cfg);
+  }
+
+  return out;
+}
+
+namespace
+{
+  // Finds where to end a window so that it can be transformed independently of whatever follows it: the latest clean cut
+  // (see is_clean_cut), to keep windows large.
+  static usize find_window_cut(const std::vector<gcgg::command *> & __restrict commands)
+  {
+    for (usize i = commands.size() - 1; i > 0; --i)
+    {
+      if (is_clean_cut(commands, i))
+      {
+        return i;
+      }
+    }
+
+    // The entire window is one run of identical moves. There's nowhere clean to cut it (yet).
+    return 0;
+  }
+}
+
+void gcode::stream(const config & __restrict cfg, const window_sink & __restrict sink, stats::report * __restrict stats) const __restrict
+{
+  printf("Streaming...\n");
+
+  // How far past window_size a window may grow while waiting for a clean place to cut it.
+  static constexpr const usize max_window_growth = 4;
+
+  // Interpreted commands are made in an arena per parsed block, and a block's arena is recycled once every command from it
+  // has been through a window. A window can't simply own an arena, as it usually ends partway through a block. Whatever
+  // the passes create lives in the window's arena.
+  struct block_arena final
+  {
+    std::unique_ptr<platform::arena> arena;
+    usize remaining;
+  };
+  std::deque<block_arena> block_arenas;
+  std::vector<std::unique_ptr<platform::arena>> free_arenas;
+  platform::arena window_arena;
+
+  const auto recycle = [&](std::unique_ptr<platform::arena> && __restrict arena)
+  {
+    arena->reset();
+    free_arenas.push_back(std::move(arena));
+  };
+
+  std::unique_ptr<platform::arena> current_arena = std::make_unique<platform::arena>();
+  interpreter state = { cfg, *current_arena };
+
+  std::vector<gc::command> lines;
+  std::vector<gcgg::command *> pending;
+  std::vector<gcgg::command *> window;
+  pending.reserve(cfg.stream.window_size * 2);
+  window.reserve(cfg.stream.window_size * 2);
+
+  uint64 window_count = 0;
+  uint64 line_count = 0;
+  estimates estimates;
+
+  const auto flush_window = [&](usize count)
+  {
+    window.assign(pending.begin(), pending.begin() + count);
+    pending.erase(pending.begin(), pending.begin() + count);
+
+    transform(window, cfg, window_arena, cfg.estimate.enable ? &estimates : nullptr, false, stats);
+
+    stats::stage output_stage = { stats, "output", window.size() };
+    sink(window);
+    output_stage.finish(window.size());
+
+    window.clear();
+    window_arena.reset();
+    ++window_count;
+
+    // Retire the blocks whose commands have all been emitted now.
+    while (count)
+    {
+      block_arena & __restrict block = block_arenas.front();
+      const usize retired = min(count, block.remaining);
+      block.remaining -= retired;
+      count -= retired;
+      if (block.remaining == 0)
+      {
+        recycle(std::move(block.arena));
+        block_arenas.pop_front();
+      }
+    }
+  };
+
+  const char * __restrict cur = file_.begin();
+  const char * const __restrict end = file_.end();
+  while (cur != end)
+  {
+    // Parse a block at a time, ending on a line boundary.
+    const char * __restrict block_end = (usize(end - cur) > cfg.stream.block_size) ? (cur + cfg.stream.block_size) : end;
+    while (block_end != end && !is_newline(*block_end))
+    {
+      ++block_end;
+    }
+
+    stats::stage parse_stage = { stats, "parse", 0, usize(block_end - cur) };
+    lines.clear();
+    parse_chunk(cur, block_end, lines);
+    cur = block_end;
+    line_count += lines.size();
+    parse_stage.finish(lines.size());
+
+    stats::stage interpret_stage = { stats, "interpret", lines.size() };
+    const usize pending_before = pending.size();
+    for (const auto & __restrict command : lines)
+    {
+      state.interpret(command, pending);
+    }
+    interpret_stage.finish(pending.size() - pending_before);
+
+    // Hand the block's arena over to the windows, and start the next block in a fresh one.
+    const usize interpreted = pending.size() - pending_before;
+    if (interpreted == 0)
+    {
+      current_arena->reset();
+    }
+    else
+    {
+      block_arenas.push_back({ std::move(current_arena), interpreted });
+      if (free_arenas.empty())
+      {
+        current_arena = std::make_unique<platform::arena>();
+      }
+      else
+      {
+        current_arena = std::move(free_arenas.back());
+        free_arenas.pop_back();
+      }
+      state.arena = current_arena.get();
+    }
+
+    while (pending.size() >= cfg.stream.window_size)
+    {
+      usize cut = find_window_cut(pending);
+      if (cut == 0)
+      {
+        // Let the window grow until the run ends, within reason.
+        if (pending.size() < cfg.stream.window_size * max_window_growth)
+        {
+          break;
+        }
+        cut = pending.size();
+      }
+      flush_window(cut);
+    }
+  }
+
+  if (!pending.empty())
+  {
+    flush_window(pending.size());
+  }
+
+  printf("Streamed %llu commands in %llu windows\n", line_count, window_count);
+
+  if (cfg.estimate.enable)
+  {
+    estimates.report(cfg);
+  }
+}
@@ -1,26 +1,41 @@
-#pragma once
-
-#include <unordered_map>
-#include <command.hpp>
-#include "gcode/command.hpp"
-#include "config.hpp"
-
-namespace gcgg
-{
-  class gcode final
-  {
-    using command_token = std::vector<std::string>;
-    using token_vector = std::vector<command_token>;
-
-    static token_vector tokenize(const std::vector<char> &__restrict data);
-    static std::vector<gc::command> parse(const token_vector & __restrict tokens);
-
-    std::vector<gc::command> commands_;
-
-  public:
-    gcode(const std::string & __restrict filename);
-    ~gcode();
-
-    std::vector<gcgg::command *> process(const config & __restrict cfg) const __restrict;
-  };
-}
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+#include <command.hpp>
+#include "gcode/command.hpp"
+#include "config.hpp"
+#include "platform/mapped_file.hpp"
+#include "platform/arena.hpp"
+
+namespace gcgg::stats
+{
+  class report;
+}
+
+namespace gcgg
+{
+  class gcode final
+  {
+    static std::vector<gc::command> parse(const char * __restrict data, usize size);
+
+    // Parsed commands reference the mapping directly, so it has to live as long as they do.
+    // Only the mapping is kept; commands are parsed when they're needed.
+    platform::mapped_file file_;
+
+  public:
+    using window_sink = std::function<void(const std::vector<gcgg::command *> & __restrict)>;
+
+    gcode(const std::string & __restrict filename);
+    ~gcode();
+
+    // Parses and processes the entire file at once. The commands are made in (and owned by) the arena. Every stage is
+    // added to stats, if given.
+    std::vector<gcgg::command *> process(const config & __restrict cfg, platform::arena & __restrict arena, stats::report * __restrict stats = nullptr) const __restrict;
+
+    // Parses and processes the file a window at a time, handing each finished window to the sink. Only the current window
+    // is held in memory, and its commands are destroyed once the sink returns. Every stage (the sink included, as output)
+    // is added to stats, if given.
+    void stream(const config & __restrict cfg, const window_sink & __restrict sink, stats::report * __restrict stats = nullptr) const __restrict;
+  };
+}
@@ -1,97 +1,109 @@
-#pragma once
-
-#include "delay_instruction.hpp"
-#include "gcode/command.hpp"
-
-namespace gcgg::instructions
-{
-  // Set Extruder Temperature and Wait
-  class M190 final : public delay_instruction
-  {
-  public:
-    static constexpr const uint64 type = hash("M190");
-
-  protected:
-    uint number_ = 0;
-    uint minimum_target_ = uint(-1);
-    uint accurate_target_ = uint(-1);
-
-  public:
-    M190(const gc::command & __restrict cmd) : delay_instruction(type),
-      number_(cmd.get_argument("H", 0)),
-      minimum_target_(cmd.get_argument("S", uint(-1))),
-      accurate_target_(cmd.get_argument("R", uint(-1)))
-    {
-      // TODO throw error for invalid input.
-    }
-    virtual ~M190() {}
-
-    virtual std::string dump() const __restrict override final
-    {
-      std::string out;
-      out += "set_bed_temp_wait";
-
-      char buffer[512];
-      sprintf(buffer, "%u", number_);
-      out += " H";
-      out += buffer;
-      if (minimum_target_ == uint(-1))
-      {
-        sprintf(buffer, "%u", minimum_target_);
-        out += " S";
-        out += buffer;
-      }
-      if (accurate_target_ == uint(-1))
-      {
-        sprintf(buffer, "%u", accurate_target_);
-        out += " R";
-        out += buffer;
-      }
-
-      return out;
-    }
-
-    uint get_number() const __restrict
-    {
-      return number_;
-    }
-
-    uint get_temperature() const __restrict
-    {
-      if (accurate_target_ != uint(-1))
-      {
-        return accurate_target_;
-      }
-      return minimum_target_;
-    }
-
-    virtual void out_gcode(std::string & __restrict out, output::state & __restrict state, const config & __restrict cfg) const __restrict
-    {
-      state.bed_temp[number_] = get_temperature();
-
-      out += "M190";
-
-      char buffer[512];
-      if (number_ != 0)
-      {
-        sprintf(buffer, "%u", number_);
-        out += " H";
-        out += buffer;
-      }
-      if (minimum_target_ != uint(-1))
-      {
-        sprintf(buffer, "%u", minimum_target_);
-        out += " S";
-        out += buffer;
-      }
-      if (accurate_target_ != uint(-1))
-      {
-        sprintf(buffer, "%u", accurate_target_);
-        out += " R";
-        out += buffer;
-      }
-
-      out += "\n";
-    }
-  };
-}
+#pragma once
+
+#include "delay_instruction.hpp"
+#include "gcode/command.hpp"
+
+namespace gcgg::instructions
+{
+  // Set Extruder Temperature and Wait
+  class M190 final : public delay_instruction
+  {
+  public:
+    static constexpr const uint64 type = hash("M190");
+
+  protected:
+    uint number_ = 0;
+    uint minimum_target_ = uint(-1);
+    uint accurate_target_ = uint(-1);
+
+  public:
+    M190(const gc::command & __restrict cmd) : delay_instruction(type),
+      number_(cmd.get_argument('H', 0)),
+      minimum_target_(cmd.get_argument('S', uint(-1))),
+      accurate_target_(cmd.get_argument('R', uint(-1)))
+    {
+      // TODO throw error for invalid input.
+    }
+    M190(cache::deserializer & __restrict in) : delay_instruction(type),
+      number_(in.read<uint>()),
+      minimum_target_(in.read<uint>()),
+      accurate_target_(in.read<uint>())
+    {}
+    virtual ~M190() {}
+
+    virtual std::string dump() const __restrict override final
+    {
+      std::string out;
+      out += "set_bed_temp_wait";
+
+      char buffer[512];
+      sprintf(buffer, "%u", number_);
+      out += " H";
+      out += buffer;
+      if (minimum_target_ == uint(-1))
+      {
+        sprintf(buffer, "%u", minimum_target_);
+        out += " S";
+        out += buffer;
+      }
+      if (accurate_target_ == uint(-1))
+      {
+        sprintf(buffer, "%u", accurate_target_);
+        out += " R";
+        out += buffer;
+      }
+
+      return out;
+    }
+
+    uint get_number() const __restrict
+    {
+      return number_;
+    }
+
+    uint get_temperature() const __restrict
+    {
+      if (accurate_target_ != uint(-1))
+      {
+        return accurate_target_;
+      }
+      return minimum_target_;
+    }
+
+    virtual void out_gcode(output::emitter & __restrict out, output::state & __restrict state, const config & __restrict cfg) const __restrict
+    {
+      state.bed_temp[number_] = get_temperature();
+
+      out += "M190";
+
+      if (number_ != 0)
+      {
+        out.word('H', number_);
+      }
+      if (minimum_target_ != uint(-1))
+      {
+        out.word('S', minimum_target_);
+      }
+      if (accurate_target_ != uint(-1))
+      {
+        out.word('R', accurate_target_);
+      }
+
+      out += "\n";
+    }
+
+    virtual void out_gg(output::emitter & __restrict out, output::state & __restrict state, const config & __restrict cfg) const __restrict override final
+    {
+      state.bed_temp[number_] = get_temperature();
+
+      output::gg::write_temperature(out, output::gg::opcode::bed_temperature_wait, number_, get_temperature());
+    }
+
+    virtual void serialize(cache::serializer & __restrict out) const __restrict override final
+    {
+      out.write(number_);
+      out.write(minimum_target_);
+      out.write(accurate_target_);
+    }
+  };
+}
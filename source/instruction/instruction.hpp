@@ -1,16 +1,17 @@
-#pragma once
-
-#include "command.hpp"
-
-namespace gcgg::instructions
-{
-  class instruction : public command
-  {
-  public:
-    instruction(uint64 type, bool delay = false) : command(type, delay) {}
-    virtual ~instruction() {}
-
-    virtual bool is_segment() const __restrict override final { return false; }
-    virtual bool is_instruction() const __restrict override final { return true; }
-  };
-}
+#pragma once
+
+#include "command.hpp"
+#include "output/gg/gg_out.hpp"
+
+namespace gcgg::instructions
+{
+  class instruction : public command
+  {
+  public:
+    instruction(uint64 type, bool delay = false) : command(type, delay) {}
+    virtual ~instruction() {}
+
+    virtual bool is_segment() const __restrict override final { return false; }
+    virtual bool is_instruction() const __restrict override final { return true; }
+  };
+}
@@ -0,0 +1,118 @@
+#include "gcgg.hpp"
+#include "estimate.hpp"
+
+#include "segment/extrusion.hpp"
+#include "segment/extrusion_move.hpp"
+#include "segment/hop.hpp"
+#include "segment/linear.hpp"
+#include "segment/travel.hpp"
+#include "segment/arc.hpp"
+#include "segment/arc_accumulator.hpp"
+
+#include <iterator>
+
+namespace
+{
+  static const char * const feature_names[] = {
+    "travel",
+    "hop",
+    "extrusion",
+    "retraction",
+    "arc",
+  };
+  static_assert(std::size(feature_names) == uint(motion::estimate::feature::count));
+
+  static motion::estimate::feature get_feature(const gcgg::command * __restrict cmd)
+  {
+    using feature = motion::estimate::feature;
+
+    switch (cmd->get_type())
+    {
+    case segments::hop::type:
+      return feature::hop;
+    case segments::extrusion_move::type:
+      return feature::extrusion;
+    case segments::extrusion::type:
+      return feature::retraction;
+    case segments::arc::type:
+    case segments::arc_accumulator::type:
+      return feature::arc;
+    default:
+      return feature::travel;
+    }
+  }
+
+  // Prints seconds as hours, minutes and seconds.
+  static void print_time(real seconds)
+  {
+    const uint64 whole = uint64(seconds);
+    printf("%lluh %02llum %05.2fs", whole / 3600, (whole / 60) % 60, seconds - real(whole - (whole % 60)));
+  }
+}
+
+void motion::estimate::add(const std::vector<gcgg::command *> & __restrict commands) __restrict
+{
+  for (const gcgg::command * __restrict cmd : commands)
+  {
+    if (!cmd->is_segment())
+    {
+      continue;
+    }
+
+    // Every segment type is a movement.
+    const segments::movement * __restrict move = static_cast<const segments::movement * __restrict>(cmd);
+
+    const real move_time = move->get_time();
+    const real move_extrusion = move->get_extrusion();
+
+    // A layer starts with the first extrusion at a new height. Travels and hops before it count towards the layer before.
+    const real z = move->get_end_position().z;
+    if (layers.empty() || (move_extrusion > 0 && move->get_length() > 0 && z != layers.back().z))
+    {
+      layers.push_back({ z });
+    }
+
+    time += move_time;
+    feature_time[uint(get_feature(cmd))] += move_time;
+    layers.back().time += move_time;
+
+    extruded += move_extrusion;
+    layers.back().extruded += move_extrusion;
+    if (move_extrusion < 0)
+    {
+      retracted -= move_extrusion;
+    }
+  }
+}
+
+void motion::estimate::report(const char * __restrict title, bool per_layer) const __restrict
+{
+  printf("Estimate (%s): ", title);
+  print_time(time);
+  printf(", %.2f mm filament (%.2f mm retracted), %llu layers\n", extruded, retracted, uint64(layers.size()));
+
+  for (uint i = 0; i < uint(feature::count); ++i)
+  {
+    printf("  %-10s ", feature_names[i]);
+    print_time(feature_time[i]);
+    printf(" (%.1f%%)\n", (time > 0) ? (feature_time[i] * 100.0 / time) : 0.0);
+  }
+
+  if (per_layer)
+  {
+    for (usize i = 0; i < layers.size(); ++i)
+    {
+      printf("  layer %llu (Z%.3f): ", uint64(i), layers[i].z);
+      print_time(layers[i].time);
+      printf(", %.2f mm\n", layers[i].extruded);
+    }
+  }
+}
+
+void motion::estimate::report_change(const estimate & __restrict before, const estimate & __restrict after)
+{
+  const real saved = before.time - after.time;
+  printf("Estimated time %s by ", (saved >= 0) ? "saved" : "added");
+  print_time(std::abs(saved));
+  printf(" (%.2f%%)\n", (before.time > 0) ? (std::abs(saved) * 100.0 / before.time) : 0.0);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "gcgg.hpp"
+#include "command.hpp"
+
+#include <vector>
+
+namespace gcgg::motion
+{
+  // Print time and filament totals, summed from planned motion. Commands can be added a window at a time; the totals
+  // carry over, so a streamed job is estimated the same as a whole one.
+  class estimate final
+  {
+  public:
+    enum class feature : uint
+    {
+      travel = 0,
+      hop,
+      extrusion,
+      retraction,
+      arc,
+      count
+    };
+
+    struct layer final
+    {
+      real z;
+      real time = 0.0;
+      real extruded = 0.0;
+    };
+
+    real time = 0.0; // Seconds
+    real feature_time[uint(feature::count)] = {};
+    real extruded = 0.0; // Filament used (net of retractions), mm
+    real retracted = 0.0; // Filament pulled back by retractions, mm
+    std::vector<layer> layers;
+
+    // Motion must already be planned.
+    void add(const std::vector<gcgg::command *> & __restrict commands) __restrict;
+
+    void report(const char * __restrict title, bool per_layer) const __restrict;
+
+    // Reports before and after side by side, so a pass that doesn't pay off is obvious.
+    static void report_change(const estimate & __restrict before, const estimate & __restrict after);
+  };
+}
@@ -0,0 +1,135 @@
+#include "gcgg.hpp"
+#include "planner.hpp"
+#include "segment/movement.hpp"
+
+#include <cmath>
+
+namespace
+{
+  // Feedrates are in mm/min, accelerations in mm/s^2. Planning is done in mm/s.
+  static constexpr const real seconds_per_minute = 60.0;
+
+  // A junction limit from compute_motion, in mm/s. One that couldn't be worked out (NaN) means stopping there.
+  static real junction_limit(real feedrate)
+  {
+    return (feedrate >= 0) ? (feedrate / seconds_per_minute) : 0;
+  }
+
+  // Per-chain working state, kept as parallel arrays (see trapezoid_batch) and reused from one chain to the next.
+  // Each segment is read once to fill these and written once with the results; the passes only touch the arrays.
+  struct chain_state final
+  {
+    std::vector<segments::movement *> moves;
+    motion::trapezoid_batch batch;
+    std::vector<real> entry_limits;
+    std::vector<real> exit_limits;
+    std::vector<real> junctions;
+
+    void clear() __restrict
+    {
+      moves.clear();
+      batch.clear();
+      entry_limits.clear();
+      exit_limits.clear();
+    }
+  };
+
+  static void plan_chain(chain_state & __restrict chain)
+  {
+    const std::vector<segments::movement *> & __restrict moves = chain.moves;
+    motion::trapezoid_batch & __restrict batch = chain.batch;
+    std::vector<real> & __restrict junctions = chain.junctions;
+    const usize count = moves.size();
+
+    // junctions[i] is the speed entering moves[i]; junctions[count] is the speed the chain ends at.
+    junctions.resize(count + 1);
+    junctions[0] = min(chain.entry_limits[0], batch.speed[0]);
+    for (usize i = 1; i < count; ++i)
+    {
+      junctions[i] = min(chain.exit_limits[i - 1], chain.entry_limits[i], batch.speed[i - 1], batch.speed[i]);
+    }
+    junctions[count] = min(chain.exit_limits[count - 1], batch.speed[count - 1]);
+
+    // A segment that doesn't move the head (a retraction) can only happen with the head at rest.
+    for (usize i = 0; i < count; ++i)
+    {
+      if (batch.distance[i] <= 0)
+      {
+        junctions[i] = 0;
+        junctions[i + 1] = 0;
+      }
+    }
+
+    // Reverse pass: every segment must be able to slow down to whatever it runs into.
+    for (usize i = count; i-- > 0;)
+    {
+      const real reachable = std::sqrt((junctions[i + 1] * junctions[i + 1]) + (2.0 * batch.acceleration[i] * batch.distance[i]));
+      junctions[i] = min(junctions[i], reachable);
+    }
+
+    // Forward pass: every segment must be able to speed up to whatever it hands over.
+    for (usize i = 0; i < count; ++i)
+    {
+      const real reachable = std::sqrt((junctions[i] * junctions[i]) + (2.0 * batch.acceleration[i] * batch.distance[i]));
+      junctions[i + 1] = min(junctions[i + 1], reachable);
+    }
+
+    for (usize i = 0; i < count; ++i)
+    {
+      batch.start_speed[i] = junctions[i];
+      batch.end_speed[i] = junctions[i + 1];
+    }
+
+    batch.compute();
+
+    for (usize i = 0; i < count; ++i)
+    {
+      segments::movement * __restrict move = moves[i];
+
+      move->motion_data_.calculated_ = true;
+      move->motion_data_.entry_feedrate_ = junctions[i] * seconds_per_minute;
+      move->motion_data_.plateau_feedrate_ = move->get_feedrate();
+      move->motion_data_.exit_feedrate_ = junctions[i + 1] * seconds_per_minute;
+
+      move->trapezoid_.start_position_ = move->get_start_position();
+      move->trapezoid_.end_position_ = move->get_end_position();
+      batch.get(i, move->trapezoid_);
+    }
+  }
+}
+
+void motion::plan(const std::vector<gcgg::command *> & __restrict commands, const config & __restrict cfg)
+{
+  chain_state chain;
+
+  // Chains are linked in command order, so rather than chasing the links from each head, walk the commands once and
+  // start a new chain at every segment without a predecessor.
+  for (gcgg::command * __restrict cmd : commands)
+  {
+    if (!cmd->is_segment())
+    {
+      continue;
+    }
+
+    // Every segment type is a movement.
+    segments::movement * move = static_cast<segments::movement *>(cmd);
+    if (!move->prev_segment_ && !chain.moves.empty())
+    {
+      plan_chain(chain);
+      chain.clear();
+    }
+
+    // Corner arcs are planned along their chord, which is never longer than the arc, so their speeds stay reachable.
+    const real length = move->get_length();
+
+    chain.moves.push_back(move);
+    chain.batch.add(length, move->get_feedrate() / seconds_per_minute, move->get_linear_acceleration(cfg));
+    chain.entry_limits.push_back(junction_limit(move->motion_data_.entry_feedrate_));
+    chain.exit_limits.push_back(junction_limit(move->motion_data_.exit_feedrate_));
+  }
+
+  if (!chain.moves.empty())
+  {
+    plan_chain(chain);
+  }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "gcgg.hpp"
+#include "config.hpp"
+#include "command.hpp"
+
+namespace gcgg::motion
+{
+  // Look-ahead velocity planner. Walks every chain of linked segments (segments between two delays) and settles the
+  // junction speeds so that each segment can actually reach its exit speed from its entry speed within its length:
+  // a reverse pass bounds each entry by how fast the segment can still decelerate to what follows, and a forward pass
+  // bounds each exit by how fast it can accelerate from what precedes. The junction limits themselves come from each
+  // segment's compute_motion, which must have been run first.
+  // The result is written back into every segment's motion_data_ (in feedrate units, mm/min) and trapezoid_ (mm/s).
+  extern void plan(const std::vector<gcgg::command *> & __restrict commands, const config & __restrict cfg);
+}
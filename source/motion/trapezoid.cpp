@@ -1,221 +1,186 @@
-#include "gcgg.hpp"
-#include "trapezoid.hpp"
-
-motion::trapezoid::trapezoid(const data & __restrict init) :
-  start_position_(init.start_position_), end_position_(init.end_position_)
-{
-  // From this, we need to calculate the trapezoidal movement data.
-  // This is used implicitly in gcode2 and ggc, but is also used internally
-  // for calculating the proper parameters for things like arcs.
-
-  const real distance = start_position_.distance(end_position_);
-
-  // TODO handle jerk?
-  const real ramp_speed_diff[2] = {
-    init.speed_ - init.start_speed_,
-    init.end_speed_ - init.speed_
-  };
-
-  // Calculate acceleration.
-  vector3<> axial_acceleration = (init.end_position_ - init.start_position_).normalized();
-  axial_acceleration /= axial_acceleration.max_element();
-  axial_acceleration *= init.acceleration_;
-
-  const real linear_acceleration = axial_acceleration.length();
-
-  // Calculate how long to accelerate/decelerate to the appropriate speeds.
-  const real ramp_times[2] = {
-    std::abs(ramp_speed_diff[0]) / linear_acceleration,
-    std::abs(ramp_speed_diff[1]) / linear_acceleration,
-  };
-
-  // Calculate the ramp distances
-  const real ramp_distance[2] = {
-    ramp_times[0] ? 
-      (init.start_speed_ * ramp_times[0]) + (0.5 * linear_acceleration * (ramp_times[0] * ramp_times[0])) :
-      0,
-    ramp_times[1] ?
-      (init.speed_ * ramp_times[1]) + (0.5 * linear_acceleration * (ramp_times[1] * ramp_times[1])) :
-      0
-  };
-
-  const real total_ramp_distance = ramp_distance[0] + ramp_distance[1];
-  // If the total ramp distance is greater than the distance of the segment, we cannot use trapezoidal motion. Instead, calculate a triangle.
-  const bool calculate_triangle = total_ramp_distance > distance;
-
-  if (!calculate_triangle)
-  {
-    // Trapezoid
-    const real plateau_distance = distance - total_ramp_distance;
-    const real plateau_time = plateau_distance / init.speed_;
-
-    plateau_speed_ = init.speed_;
-    start_speed_ = init.start_speed_;
-    end_speed_ = init.end_speed_;
-    ramp_time_[0] = ramp_times[0];
-    ramp_time_[1] = ramp_times[1];
-    ramp_distance_[0] = ramp_distance[0];
-    ramp_distance_[1] = ramp_distance[1];
-    plateau_time_ = plateau_time;
-    plateau_distance_ = plateau_distance;
-  }
-  else
-  {
-    const real plateau_distance = 0;
-    const real plateau_time = 0;
-
-    plateau_time_ = plateau_time;
-    plateau_distance_ = plateau_distance;
-
-    // Triangle
-    // If they're equal, the triangle is already solved.
-    if (total_ramp_distance != distance)
-    {
-      const auto sq = [](real value)->real
-      {
-        return value * value;
-      };
-
-      // Otherwise we need to calculate shorter triangles that don't reach peak speed.
-
-      // If either of the distances are are zero, we are calculating a single triangle.
-      // s = s0 + v0t + 1/2at^2
-      // s = v0t + 1/2at^2 since we don't have a starting distance
-      // ergo
-      // t = -(sqrt(2 * a * s + v^2) + v) / a
-      // t = (sqrt(2 * a * s + v^2) - v) / a
-      if (ramp_distance[0] <= 0)
-      {
-        // Down ramp only
-        const real accel = (init.start_speed_ <= init.end_speed_) ? linear_acceleration : -linear_acceleration;
-
-        const real time = max(
-          -(sqrt((2 * accel * distance) + sq(init.start_speed_)) + init.start_speed_) / accel,
-          (sqrt((2 * accel * distance) + sq(init.start_speed_)) - init.start_speed_) / accel
-        );
-
-        plateau_speed_ = distance / time;
-        start_speed_ = init.start_speed_;
-        end_speed_ = init.end_speed_;
-        ramp_time_[0] = 0;
-        ramp_distance_[0] = 0;
-        ramp_time_[1] = time;
-        ramp_distance_[1] = distance;
-        plateau_time_ = 0;
-        plateau_distance_ = 0;
-      }
-      else if (ramp_distance[1] <= 0)
-      {
-        // Up ramp only
-        const real accel = (init.start_speed_ <= init.end_speed_) ? linear_acceleration : -linear_acceleration;
-
-        const real time = max(
-          -(sqrt((2 * accel * distance) + sq(init.start_speed_)) + init.start_speed_) / accel,
-          (sqrt((2 * accel * distance) + sq(init.start_speed_)) - init.start_speed_) / accel
-        );
-
-        plateau_speed_ = distance / time;
-        start_speed_ = init.start_speed_;
-        end_speed_ = init.end_speed_;
-        ramp_time_[1] = 0;
-        ramp_distance_[1] = 0;
-        ramp_time_[0] = time;
-        ramp_distance_[0] = distance;
-        plateau_time_ = 0;
-        plateau_distance_ = 0;
-      }
-      else if (ramp_distance[0] <= 0 && ramp_distance[1] <= 0)
-      {
-        // Both ramps don't exist, this can only happen if start_speed, end_speed, and segment speed are the same.
-        // In this case, it's a constant velocity the entire move, and we just need to trivially calculate time.
-        plateau_speed_ = init.speed_;
-        start_speed_ = init.start_speed_;
-        end_speed_ = init.end_speed_;
-        ramp_time_[0] = 0;
-        ramp_time_[1] = 0;
-        ramp_distance_[0] = 0;
-        ramp_distance_[1] = 0;
-        plateau_time_ = distance / init.speed_;
-        plateau_distance_ = distance;
-      }
-      else
-      {
-        // distance = rdistance0 + rdistance1
-        // rdistance0 = (start_speed * time0) + (0.5 * accel * (time0^2))
-        // rdistance1 = (end_speed * time1) + (0.5 * accel * (time1^2))
-        // time0 = speed_diff0 / accel
-        // time1 = speed/diff1 / accel
-        // speed_diff0 = speed - start_speed
-        // speed_diff1 = end_speed - speed
-        // variable is speed
-        //
-        // time0 = ((speed - start_speed) / accel)
-        // time1 = ((end_speed - speed) / accel)
-        //
-        // rdistance0 = (start_speed * ((speed - start_speed) / accel)) + (0.5 * accel * (((speed - start_speed) / accel)^2))
-        // rdistance1 = (end_speed * ((end_speed - speed) / accel)) + (0.5 * accel * (((end_speed - speed) / accel)^2))
-        //
-        // distance = (start_speed * ((speed - start_speed) / accel)) + (0.5 * accel * (((speed - start_speed) / accel)^2)) +
-        //            (end_speed * ((end_speed - speed) / accel)) + (0.5 * accel * (((end_speed - speed) / accel)^2))
-        //
-        // start_speed >= speed, end_speed >= speed
-        // distance = (start_speed * ((start_speed -speed) / accel)) + (0.5 * accel * (((start_speed - speed) / accel)^2)) +
-        //            (speed * ((end_speed - speed) / accel)) + (0.5 * accel * (((end_speed - speed) / accel)^2))
-        // https://www.wolframalpha.com/input/?i=b+%3D+(d+*+((d+-+a)+%2F+g))+%2B+(0.5+*+-g+*+(((d+-+a)+%2F+g)%5E2))+%2B+(a+*+((f+-+a)+%2F+g))+%2B+(0.5+*+g+*+(((f+-+a)+%2F+g)%5E2))+solve+for+a
-        //
-        // start_speed < speed, end_speed >= speed
-        // distance = (start_speed * ((speed - start_speed) / accel)) + (0.5 * accel * (((speed - start_speed) / accel)^2)) +
-        //            (speed * ((end_speed - speed) / accel)) + (0.5 * accel * (((end_speed - speed) / accel)^2))
-        // https://www.wolframalpha.com/input/?i=b+%3D+(d+*+((a+-+d)+%2F+g))+%2B+(0.5+*+g+*+(((a+-+d)+%2F+g)%5E2))+%2B+(f+*+((f+-+a)+%2F+g))+%2B+(0.5+*+g+*+(((f+-+a)+%2F+g)%5E2))+solve+for+a
-        //
-        // start_speed >= speed, end_speed < speed
-        // distance = (start_speed * ((start_speed -speed) / accel)) + (0.5 * accel * (((start_speed -speed) / accel)^2)) +
-        //            (speed * ((speed - end_speed) / accel)) + (0.5 * accel * (((speed - end_speed) / accel)^2))
-        // https://www.wolframalpha.com/input/?i=b+%3D+(d+*+((d+-+a)+%2F+g))+%2B+(0.5+*+g+*+(((d+-+a)+%2F+g)%5E2))+%2B+(f+*+((a+-+f)+%2F+g))+%2B+(0.5+*+g+*+(((a+-+f)+%2F+g)%5E2))+solve+for+a
-        //
-        // start_speed < speed, end_speed < speed
-        // distance = (start_speed * ((speed - start_speed) / accel)) + (0.5 * accel * (((speed - start_speed) / accel)^2)) +
-        //            (speed * ((speed - end_speed) / accel)) + (0.5 * accel * (((espeed - end_speed) / accel)^2))
-        // https://www.wolframalpha.com/input/?i=b+%3D+(d+*+((a+-+d)+%2F+g))+%2B+(0.5+*+g+*+(((a+-+d)+%2F+g)%5E2))+%2B+(f+*+((a+-+f)+%2F+g))+%2B+(0.5+*+g+*+(((a+-+f)+%2F+g)%5E2))+solve+for+a
-        //
-        //
-        // https://www.wolframalpha.com/input/?i=b+%3D+(d+*+((a+-+d)+%2F+g))+%2B+(0.5+*+g+*+(((a+-+d)+%2F+g)%5E2))+%2B+(f+*+((f+-+a)+%2F+g))+%2B+(0.5+*+g+*+(((f+-+a)+%2F+g)%5E2))+solve+for+a
-        // We get two solutions out of this:
-        // speed = 0.5 * (2 * start_speed - sqrt(2) * sqrt(2 * distance * accel + start_speed ^ 2 - end_speed ^ 2))
-        // speed = 0.5 * (sqrt(2) * sqrt(2 * distance * accel + start_speed ^ 2 - end_speed ^ 2) + 2 * start_speed)
-
-        const real speed_solutions[2] = {
-          0.5 * (2.0 * init.start_speed_ - sqrt(2.0) * sqrt(2.0 * distance * linear_acceleration + sq(init.start_speed_) - sq(init.end_speed_))),
-          0.5 * (sqrt(2.0) * sqrt(2.0 * distance * linear_acceleration + sq(init.start_speed_) - sq(init.end_speed_)) + 2.0 * init.start_speed_)
-        };
-
-        const real best_speed = max(speed_solutions[0], speed_solutions[1]);
-
-        const real new_ramp_speed_diff[2] = {
-          best_speed - init.start_speed_,
-          init.end_speed_ - best_speed
-        };
-
-        const real new_ramp_times[2] = {
-          new_ramp_speed_diff[0] / linear_acceleration,
-          new_ramp_speed_diff[1] / linear_acceleration,
-        };
-
-        const real new_ramp_distance[2] = {
-          (init.start_speed_ * new_ramp_times[0]) + (0.5 * linear_acceleration * (new_ramp_times[0] * new_ramp_times[0])),
-          (best_speed * new_ramp_times[1]) + (0.5 * linear_acceleration * (new_ramp_times[1] * new_ramp_times[1]))
-        };
-
-        plateau_speed_ = best_speed; // sort of irrelevant since there is no plateau. It's the target speed for the triangle.
-        start_speed_ = init.start_speed_;
-        end_speed_ = init.end_speed_;
-        ramp_time_[0] = new_ramp_times[0];
-        ramp_time_[1] = new_ramp_times[1];
-        ramp_distance_[0] = new_ramp_distance[0];
-        ramp_distance_[1] = new_ramp_distance[1];
-        plateau_time_ = 0;
-        plateau_distance_ = 0;
-      }
-    }
-  }
-}
+#include "gcgg.hpp"
+#include "trapezoid.hpp"
+
+#include <limits>
+
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#endif
+
+namespace
+{
+  // Solves one trapezoid: accelerate from start_speed towards speed, cruise, and decelerate to end_speed, all within
+  // distance. If there isn't room to reach speed, the peak is where the two ramps meet instead (a triangle), which is
+  // the v^2 midpoint: peak^2 = (2 * a * d + start^2 + end^2) / 2.
+  static void solve(
+    real distance, real start_speed, real speed, real end_speed, real acceleration,
+    real & __restrict plateau_speed,
+    real & __restrict ramp_time0, real & __restrict ramp_time1,
+    real & __restrict ramp_distance0, real & __restrict ramp_distance1,
+    real & __restrict plateau_time, real & __restrict plateau_distance
+  )
+  {
+    const real inv_acceleration = (acceleration > 0) ? (1.0 / acceleration) : 0.0;
+    const real start_sq = start_speed * start_speed;
+    const real end_sq = end_speed * end_speed;
+
+    const real peak = min(speed, std::sqrt(max(((2.0 * acceleration * distance) + start_sq + end_sq) * 0.5, 0.0)));
+    const real peak_sq = peak * peak;
+
+    plateau_speed = peak;
+    ramp_time0 = std::abs(peak - start_speed) * inv_acceleration;
+    ramp_time1 = std::abs(peak - end_speed) * inv_acceleration;
+    ramp_distance0 = std::abs(peak_sq - start_sq) * 0.5 * inv_acceleration;
+    ramp_distance1 = std::abs(peak_sq - end_sq) * 0.5 * inv_acceleration;
+    plateau_distance = max(distance - ramp_distance0 - ramp_distance1, 0.0);
+    plateau_time = (peak > 0) ? (plateau_distance / peak) : 0.0;
+  }
+}
+
+
+real motion::trapezoid::linear_acceleration(const vector3<> & __restrict direction, const vector3<> & __restrict axial_acceleration)
+{
+  real result = 0;
+  bool limited = false;
+  const auto limit = [&](real component, real axis_limit)
+  {
+    component = std::abs(component);
+    if (component == 0 || axis_limit <= 0)
+    {
+      return;
+    }
+    const real axis_result = axis_limit / component;
+    result = limited ? min(result, axis_result) : axis_result;
+    limited = true;
+  };
+
+  limit(direction.x, axial_acceleration.x);
+  limit(direction.y, axial_acceleration.y);
+  limit(direction.z, axial_acceleration.z);
+
+  return result;
+}
+
+real motion::trapezoid::jerk_junction_speed(const vector3<> & __restrict from, const vector3<> & __restrict to, const vector3<> & __restrict jerk)
+{
+  const vector3<> change = (from - to).abs();
+
+  real speed = std::numeric_limits<real>::infinity();
+  const auto limit = [&speed](real axis_change, real axis_jerk)
+  {
+    if (axis_change > 0)
+    {
+      speed = min(speed, max(axis_jerk, 0.0) / axis_change);
+    }
+  };
+  limit(change.x, jerk.x);
+  limit(change.y, jerk.y);
+  limit(change.z, jerk.z);
+
+  return speed;
+}
+
+motion::trapezoid::trapezoid(const data & __restrict init) :
+  start_position_(init.start_position_),
+  end_position_(init.end_position_),
+  start_speed_(init.start_speed_),
+  end_speed_(init.end_speed_)
+{
+  // From this, we need to calculate the trapezoidal movement data.
+  // This is used implicitly in gcode2 and ggc, but is also used internally
+  // for calculating the proper parameters for things like arcs.
+
+  // TODO handle jerk?
+  solve(
+    start_position_.distance(end_position_), init.start_speed_, init.speed_, init.end_speed_, init.acceleration_,
+    plateau_speed_,
+    ramp_time_[0], ramp_time_[1],
+    ramp_distance_[0], ramp_distance_[1],
+    plateau_time_, plateau_distance_
+  );
+}
+
+void motion::trapezoid_batch::clear() __restrict
+{
+  for (auto * __restrict array : { &distance, &start_speed, &speed, &end_speed, &acceleration })
+  {
+    array->clear();
+  }
+}
+
+void motion::trapezoid_batch::compute() __restrict
+{
+  const usize count = size();
+  for (auto * __restrict array : { &plateau_speed, &ramp_time[0], &ramp_time[1], &ramp_distance[0], &ramp_distance[1], &plateau_time, &plateau_distance })
+  {
+    array->resize(count);
+  }
+
+  usize i = 0;
+
+#if defined(__AVX2__)
+  // The same as solve, four moves at a time.
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d half = _mm256_set1_pd(0.5);
+  const __m256d two = _mm256_set1_pd(2.0);
+  const __m256d sign_mask = _mm256_set1_pd(-0.0);
+  const auto abs = [&](__m256d value) { return _mm256_andnot_pd(sign_mask, value); };
+
+  for (; i + 4 <= count; i += 4)
+  {
+    const __m256d d = _mm256_loadu_pd(&distance[i]);
+    const __m256d vs = _mm256_loadu_pd(&start_speed[i]);
+    const __m256d v = _mm256_loadu_pd(&speed[i]);
+    const __m256d ve = _mm256_loadu_pd(&end_speed[i]);
+    const __m256d a = _mm256_loadu_pd(&acceleration[i]);
+
+    const __m256d has_acceleration = _mm256_cmp_pd(a, zero, _CMP_GT_OQ);
+    const __m256d inv_a = _mm256_and_pd(has_acceleration, _mm256_div_pd(one, a));
+    const __m256d vs_sq = _mm256_mul_pd(vs, vs);
+    const __m256d ve_sq = _mm256_mul_pd(ve, ve);
+
+    const __m256d peak_sq_limit = _mm256_mul_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(two, a), d), _mm256_add_pd(vs_sq, ve_sq)), half);
+    const __m256d peak = _mm256_min_pd(v, _mm256_sqrt_pd(_mm256_max_pd(peak_sq_limit, zero)));
+    const __m256d peak_sq = _mm256_mul_pd(peak, peak);
+    const __m256d half_inv_a = _mm256_mul_pd(half, inv_a);
+
+    const __m256d rd0 = _mm256_mul_pd(abs(_mm256_sub_pd(peak_sq, vs_sq)), half_inv_a);
+    const __m256d rd1 = _mm256_mul_pd(abs(_mm256_sub_pd(peak_sq, ve_sq)), half_inv_a);
+    const __m256d pd = _mm256_max_pd(_mm256_sub_pd(_mm256_sub_pd(d, rd0), rd1), zero);
+    const __m256d has_peak = _mm256_cmp_pd(peak, zero, _CMP_GT_OQ);
+
+    _mm256_storeu_pd(&plateau_speed[i], peak);
+    _mm256_storeu_pd(&ramp_time[0][i], _mm256_mul_pd(abs(_mm256_sub_pd(peak, vs)), inv_a));
+    _mm256_storeu_pd(&ramp_time[1][i], _mm256_mul_pd(abs(_mm256_sub_pd(peak, ve)), inv_a));
+    _mm256_storeu_pd(&ramp_distance[0][i], rd0);
+    _mm256_storeu_pd(&ramp_distance[1][i], rd1);
+    _mm256_storeu_pd(&plateau_distance[i], pd);
+    _mm256_storeu_pd(&plateau_time[i], _mm256_and_pd(has_peak, _mm256_div_pd(pd, peak)));
+  }
+#endif
+
+  for (; i < count; ++i)
+  {
+    solve(
+      distance[i], start_speed[i], speed[i], end_speed[i], acceleration[i],
+      plateau_speed[i],
+      ramp_time[0][i], ramp_time[1][i],
+      ramp_distance[0][i], ramp_distance[1][i],
+      plateau_time[i], plateau_distance[i]
+    );
+  }
+}
+
+void motion::trapezoid_batch::get(usize i, trapezoid & __restrict out) const __restrict
+{
+  out.plateau_speed_ = plateau_speed[i];
+  out.start_speed_ = start_speed[i];
+  out.end_speed_ = end_speed[i];
+  out.ramp_time_[0] = ramp_time[0][i];
+  out.ramp_time_[1] = ramp_time[1][i];
+  out.ramp_distance_[0] = ramp_distance[0][i];
+  out.ramp_distance_[1] = ramp_distance[1][i];
+  out.plateau_time_ = plateau_time[i];
+  out.plateau_distance_ = plateau_distance[i];
+}
@@ -1,35 +1,89 @@
-#pragma once
-
-#include "gcgg.hpp"
-#include "config.hpp"
-
-namespace gcgg::motion
-{
-  class trapezoid final
-  {
-  public:
-    struct data final
-    {
-      vector3<> start_position_;
-      vector3<> end_position_;
-      real start_speed_;
-      real speed_;
-      real end_speed_;
-      vector3<> acceleration_;
-      vector3<> jerk_;
-    };
-
-  public:
-    vector3<> start_position_;
-    vector3<> end_position_;
-    real plateau_speed_;
-    real start_speed_;
-    real end_speed_;
-    real ramp_time_[2];
-    real ramp_distance_[2];
-    real plateau_time_;
-    real plateau_distance_;
-
-    trapezoid(const data & __restrict init);
-  };
-}
+#pragma once
+
+#include "gcgg.hpp"
+#include "config.hpp"
+
+#include <vector>
+
+namespace gcgg::motion
+{
+  class trapezoid final
+  {
+  public:
+    struct data final
+    {
+      vector3<> start_position_;
+      vector3<> end_position_;
+      real start_speed_;
+      real speed_;
+      real end_speed_;
+      real acceleration_; // Along the move, with any per-axis limits already applied.
+      vector3<> jerk_;
+    };
+
+  public:
+    vector3<> start_position_;
+    vector3<> end_position_;
+    real plateau_speed_ = 0.0;
+    real start_speed_ = 0.0;
+    real end_speed_ = 0.0;
+    real ramp_time_[2] = { 0.0, 0.0 };
+    real ramp_distance_[2] = { 0.0, 0.0 };
+    real plateau_time_ = 0.0;
+    real plateau_distance_ = 0.0;
+
+    trapezoid() = default;
+    trapezoid(const data & __restrict init);
+
+    // The largest acceleration along a (unit) direction that keeps every axis within its own limit.
+    static real linear_acceleration(const vector3<> & __restrict direction, const vector3<> & __restrict axial_acceleration);
+
+    // Fastest speed at which a move along 'from' can hand over to one along 'to' (unit vectors, or zero for standing
+    // still) without any axis's velocity jumping by more than its jerk limit. At a shared speed s, axis i changes by
+    // s * |from_i - to_i|, so the answer is just the tightest jerk_i / |from_i - to_i|. Infinite if nothing changes.
+    static real jerk_junction_speed(const vector3<> & __restrict from, const vector3<> & __restrict to, const vector3<> & __restrict jerk);
+  };
+
+  // Trapezoids for a whole run of moves, kept as parallel arrays so that they can be computed several at once.
+  // Fill in the inputs for every move, call compute, and read the outputs back.
+  class trapezoid_batch final
+  {
+  public:
+    // Inputs.
+    std::vector<real> distance;
+    std::vector<real> start_speed;
+    std::vector<real> speed;
+    std::vector<real> end_speed;
+    std::vector<real> acceleration;
+
+    // Outputs.
+    std::vector<real> plateau_speed;
+    std::vector<real> ramp_time[2];
+    std::vector<real> ramp_distance[2];
+    std::vector<real> plateau_time;
+    std::vector<real> plateau_distance;
+
+    usize size() const __restrict
+    {
+      return distance.size();
+    }
+
+    void clear() __restrict;
+
+    // Adds a move. Its start and end speeds are left at zero to be filled in.
+    void add(real move_distance, real move_speed, real move_acceleration) __restrict
+    {
+      distance.push_back(move_distance);
+      start_speed.push_back(0);
+      speed.push_back(move_speed);
+      end_speed.push_back(0);
+      acceleration.push_back(move_acceleration);
+    }
+
+    // Uses AVX2 where the build allows it.
+    void compute() __restrict;
+
+    // Copies move i's results into a trapezoid.
+    void get(usize i, trapezoid & __restrict out) const __restrict;
+  };
+}
@@ -0,0 +1,134 @@
+#include "gcgg.hpp"
+#include "emitter.hpp"
+
+#include <cmath>
+
+namespace
+{
+  static constexpr const uint64 powers_of_ten[] = {
+    1ull,
+    10ull,
+    100ull,
+    1000ull,
+    10000ull,
+    100000ull,
+    1000000ull,
+    10000000ull,
+    100000000ull,
+    1000000000ull,
+    10000000000ull,
+    100000000000ull,
+    1000000000000ull,
+  };
+
+  // Writes the digits of value backwards, ending at out. Returns the first digit.
+  static char * write_digits_backwards(char * __restrict out, uint64 value, uint min_digits = 1)
+  {
+    uint digits = 0;
+    do
+    {
+      *--out = char('0' + (value % 10));
+      value /= 10;
+      ++digits;
+    } while (value != 0 || digits < min_digits);
+    return out;
+  }
+}
+
+void gcgg::output::emitter::next_chunk() __restrict
+{
+  if (!chunks_.empty())
+  {
+    chunks_.back().used = usize(cur_ - chunks_.back().data.get());
+  }
+
+  chunk new_chunk;
+  if (free_chunks_.empty())
+  {
+    new_chunk.data.reset(new char[chunk_size]);
+  }
+  else
+  {
+    new_chunk.data = std::move(free_chunks_.back());
+    free_chunks_.pop_back();
+  }
+
+  cur_ = new_chunk.data.get();
+  end_ = cur_ + chunk_size;
+  chunks_.push_back(std::move(new_chunk));
+}
+
+void gcgg::output::emitter::write(std::string_view str) __restrict
+{
+  while (!str.empty())
+  {
+    if (cur_ == end_)
+    {
+      next_chunk();
+    }
+    const usize count = min(usize(str.length()), usize(end_ - cur_));
+    memcpy(cur_, str.data(), count);
+    commit(cur_ + count);
+    str.remove_prefix(count);
+  }
+}
+
+void gcgg::output::emitter::write_uint(uint64 value) __restrict
+{
+  char digits[24];
+  char * const __restrict digits_end = digits + sizeof(digits);
+  const char * __restrict first = write_digits_backwards(digits_end, value);
+  write({ first, usize(digits_end - first) });
+}
+
+void gcgg::output::emitter::write_real(real value, uint precision) __restrict
+{
+  precision = min(precision, max_precision);
+
+  // Scale to a fixed-point integer and print that. This stays exact as long as the scaled value fits in 53 bits, which
+  // covers any coordinate or feedrate a printer will see at the default precision; anything larger goes to printf.
+  const real scaled = std::round(value * real(powers_of_ten[precision]));
+  if (__unlikely(!(std::abs(scaled) < real(uint64(1) << 53))))
+  {
+    char buffer[512];
+    if (snprintf(buffer, sizeof(buffer), "%.*f", int(precision), value) < 0)
+    {
+      return;
+    }
+    // Trimmed the same as below. Without a fraction there's no point, and nothing to stop trimming at.
+    write((precision != 0) ? trim_float(buffer) : buffer);
+    return;
+  }
+
+  const bool negative = scaled < 0.0;
+  uint64 fixed = uint64(std::abs(scaled));
+
+  // Trailing zeros in the fraction are never written, nor is a fraction of zero.
+  uint fraction_digits = precision;
+  while (fraction_digits != 0 && (fixed % 10) == 0)
+  {
+    fixed /= 10;
+    --fraction_digits;
+  }
+
+  const uint64 unit = powers_of_ten[fraction_digits];
+  const uint64 integer = fixed / unit;
+  const uint64 fraction = fixed % unit;
+
+  char digits[48];
+  char * const __restrict digits_end = digits + sizeof(digits);
+  char * __restrict first = digits_end;
+  if (fraction_digits != 0)
+  {
+    first = write_digits_backwards(first, fraction, fraction_digits);
+    *--first = '.';
+  }
+  first = write_digits_backwards(first, integer);
+  // A value that rounds to zero is written as 0, never -0.
+  if (negative && fixed != 0)
+  {
+    *--first = '-';
+  }
+
+  write({ first, usize(digits_end - first) });
+}
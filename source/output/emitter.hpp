@@ -0,0 +1,142 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace gcgg::output
+{
+  // Output buffer that commands write their gcode (or gg) into. Text goes into a list of fixed-size chunks rather than one
+  // contiguous string, so growing it never copies what's already been written, and drained chunks are reused.
+  // Numbers are formatted directly into the buffer: reals as fixed-point with trailing zeros trimmed, integers plainly.
+  class emitter final
+  {
+  public:
+    static constexpr const usize chunk_size = 64 * 1024;
+    // Beyond this, a double no longer has enough precision to be worth printing digits for.
+    static constexpr const uint max_precision = 12;
+
+  private:
+    struct chunk final
+    {
+      std::unique_ptr<char[]> data;
+      usize used = 0;
+    };
+
+    std::vector<chunk> chunks_;
+    std::vector<std::unique_ptr<char[]>> free_chunks_;
+    char * cur_ = nullptr;
+    char * end_ = nullptr;
+    usize size_ = 0;
+
+    void next_chunk() __restrict;
+
+    // Makes sure that at least count bytes can be written contiguously.
+    char * reserve(usize count) __restrict
+    {
+      if (__unlikely(usize(end_ - cur_) < count))
+      {
+        next_chunk();
+      }
+      return cur_;
+    }
+
+    void commit(char * __restrict new_cur) __restrict
+    {
+      size_ += usize(new_cur - cur_);
+      cur_ = new_cur;
+    }
+
+  public:
+    emitter() = default;
+    emitter(const emitter &) = delete;
+    emitter & operator = (const emitter &) = delete;
+
+    // Total bytes written and not yet drained.
+    usize size() const __restrict
+    {
+      return size_;
+    }
+
+    void put(char c) __restrict
+    {
+      char * __restrict out = reserve(1);
+      *out++ = c;
+      commit(out);
+    }
+
+    void write(std::string_view str) __restrict;
+
+    // Writes an integer as raw little-endian bytes, for binary output.
+    template <typename T>
+    void write_binary(T value) __restrict
+    {
+      char * __restrict out = reserve(sizeof(T));
+      for (usize i = 0; i < sizeof(T); ++i)
+      {
+        *out++ = char(uint64(value) >> (i * 8));
+      }
+      commit(out);
+    }
+
+    void write_uint(uint64 value) __restrict;
+    void write_real(real value, uint precision) __restrict;
+
+    // Writes a gcode word: a space, the letter, and the value.
+    void word(char letter, real value, uint precision) __restrict
+    {
+      put(' ');
+      put(letter);
+      write_real(value, precision);
+    }
+
+    void word(char letter, uint value) __restrict
+    {
+      put(' ');
+      put(letter);
+      write_uint(value);
+    }
+
+    emitter & operator += (std::string_view str) __restrict
+    {
+      write(str);
+      return *this;
+    }
+
+    emitter & operator += (char c) __restrict
+    {
+      put(c);
+      return *this;
+    }
+
+    // Hands every chunk written so far, in order, to func(data, size), and empties the emitter.
+    template <typename F>
+    void drain(const F & __restrict func) __restrict
+    {
+      for (chunk & __restrict written : chunks_)
+      {
+        const usize used = (written.data.get() == chunks_.back().data.get()) ? usize(cur_ - written.data.get()) : written.used;
+        if (used)
+        {
+          func((const char *)written.data.get(), used);
+        }
+      }
+
+      // Keep the current chunk to write into, and recycle the rest.
+      if (!chunks_.empty())
+      {
+        chunk current = std::move(chunks_.back());
+        chunks_.pop_back();
+        for (chunk & __restrict written : chunks_)
+        {
+          free_chunks_.push_back(std::move(written.data));
+        }
+        chunks_.clear();
+        cur_ = current.data.get();
+        current.used = 0;
+        chunks_.push_back(std::move(current));
+      }
+      size_ = 0;
+    }
+  };
+}
@@ -1,34 +1,172 @@
-#include "gcgg.hpp"
-#include "gcode_out.hpp"
-#include "output/state.hpp"
-
-bool gcgg::output::write_gcode(const std::string & __restrict filename, const std::vector<gcgg::command *> & __restrict commands, const config & __restrict cfg)
-{
-  std::string output;
-  output::state state;
-
-  // We start by making usre that the printer is in the correct state.
-  output += "G21\n"; // Set units to millimeters
-  output += "G90\n"; // Absolute Positioning
-  output += "M83\n"; // Relative Extrusion
-  output += "M107\n"; // Fan starts off.
-
-
-
-  for (auto * __restrict cmd : commands)
-  {
-    cmd->out_gcode(output, state, cfg);
-  }
-
-  FILE *fp = fopen(filename.c_str(), "wb");
-  if (!fp)
-  {
-    assert(false);
-  }
-
-  fwrite(output.c_str(), 1, output.length(), fp);
-
-  fclose(fp);
-
-  return true;
-}
+#include "gcgg.hpp"
+#include "gcode_out.hpp"
+#include "output/state.hpp"
+
+gcgg::output::gcode_writer::gcode_writer(const std::string & __restrict filename, const config & __restrict cfg) :
+  cfg_(cfg),
+  gg_(cfg.output.format == config::format::gg),
+  file_(fopen(filename.c_str(), "wb"))
+{
+  if (!file_)
+  {
+    printf("Failed to open output file: %s\n", filename.c_str());
+    // Nothing can be written, so write and flush are left with nothing to do.
+    failed_ = true;
+    return;
+  }
+
+  if (cfg_.output.background_io)
+  {
+    io_thread_ = std::thread([this]() { io_worker(); });
+  }
+
+  output::emitter & __restrict buffer = buffers_[front_];
+
+  if (gg_)
+  {
+    // gg has no modes to set up, as everything in it is relative. The fan still starts off.
+    output::gg::write_header(buffer);
+    output::gg::write_fan(buffer, 0, 0);
+    return;
+  }
+
+  // We start by making usre that the printer is in the correct state.
+  buffer += "G21\n"; // Set units to millimeters
+  buffer += "G90\n"; // Absolute Positioning
+  buffer += "M83\n"; // Relative Extrusion
+  buffer += "M107\n"; // Fan starts off.
+}
+
+gcgg::output::gcode_writer::~gcode_writer()
+{
+  close();
+}
+
+bool gcgg::output::gcode_writer::close() __restrict
+{
+  if (!file_)
+  {
+    return false;
+  }
+
+  flush();
+
+  if (io_thread_.joinable())
+  {
+    {
+      std::unique_lock<std::mutex> lock(io_mutex_);
+      io_stopping_ = true;
+    }
+    io_wake_.notify_one();
+    io_thread_.join();
+  }
+
+  if (fclose(file_) != 0 && !failed_)
+  {
+    printf("Failed to write to output file\n");
+    failed_ = true;
+  }
+  file_ = nullptr;
+
+  return !failed_;
+}
+
+void gcgg::output::gcode_writer::write(const std::vector<gcgg::command *> & __restrict commands) __restrict
+{
+  for (auto * __restrict cmd : commands)
+  {
+    // There's no point formatting what won't be written.
+    if (failed_)
+    {
+      return;
+    }
+
+    if (gg_)
+    {
+      cmd->out_gg(buffers_[front_], state_, cfg_);
+    }
+    else
+    {
+      cmd->out_gcode(buffers_[front_], state_, cfg_);
+    }
+
+    if (buffers_[front_].size() >= cfg_.output.flush_size)
+    {
+      flush();
+    }
+  }
+}
+
+bool gcgg::output::gcode_writer::flush() __restrict
+{
+  if (!io_thread_.joinable())
+  {
+    write_out(buffers_[front_]);
+    return !failed_;
+  }
+
+  {
+    // Wait for the I/O thread to finish the previous block, then give it this one.
+    std::unique_lock<std::mutex> lock(io_mutex_);
+    io_done_.wait(lock, [this]() { return !io_pending_; });
+    front_ ^= 1;
+    io_pending_ = true;
+  }
+  io_wake_.notify_one();
+  return !failed_;
+}
+
+void gcgg::output::gcode_writer::write_out(output::emitter & __restrict buffer) __restrict
+{
+  buffer.drain([this](const char * __restrict data, usize size)
+  {
+    // Once a block has failed, the rest are just dropped: the file is already unusable.
+    if (failed_)
+    {
+      return;
+    }
+    if (fwrite(data, 1, size, file_) != size)
+    {
+      printf("Failed to write to output file\n");
+      failed_ = true;
+    }
+  });
+}
+
+void gcgg::output::gcode_writer::io_worker() __restrict
+{
+  for (;;)
+  {
+    uint back;
+    {
+      std::unique_lock<std::mutex> lock(io_mutex_);
+      io_wake_.wait(lock, [this]() { return io_stopping_ || io_pending_; });
+      if (!io_pending_)
+      {
+        return;
+      }
+      back = front_ ^ 1;
+    }
+
+    write_out(buffers_[back]);
+
+    {
+      std::unique_lock<std::mutex> lock(io_mutex_);
+      io_pending_ = false;
+    }
+    io_done_.notify_one();
+  }
+}
+
+bool gcgg::output::write_gcode(const std::string & __restrict filename, const std::vector<gcgg::command *> & __restrict commands, const config & __restrict cfg)
+{
+  gcode_writer writer = { filename, cfg };
+  if (!writer.is_open())
+  {
+    return false;
+  }
+
+  writer.write(commands);
+
+  return writer.close();
+}
@@ -1,9 +1,64 @@
-#pragma once
-
-#include "command.hpp"
-#include "config.hpp"
-
-namespace gcgg::output
-{
-  extern bool write_gcode(const std::string & __restrict filename, const std::vector<gcgg::command *> & __restrict commands, const config & __restrict cfg);
-}
+#pragma once
+
+#include "command.hpp"
+#include "config.hpp"
+#include "output/state.hpp"
+#include "output/emitter.hpp"
+#include "output/gg/gg_out.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace gcgg::output
+{
+  // Writes gcode incrementally. Output state (current position, feedrate...) carries across calls to write, so a stream can
+  // emit each window as it's finished rather than building the whole file in memory first.
+  // With output.format set to gg, it writes gg instead.
+  // Output goes out in blocks of output.flush_size. With output.background_io, commands format into one buffer while an
+  // I/O thread writes the other out, so only two blocks are ever held and formatting overlaps with the disk.
+  // If a block can't be written, nothing more is, and flush and close return false from then on.
+  class gcode_writer final
+  {
+    const config & __restrict cfg_;
+    const bool gg_;
+    FILE * __restrict file_ = nullptr;
+    output::emitter buffers_[2];
+    uint front_ = 0; // The buffer commands are formatted into. The other belongs to the I/O thread while io_pending_ is set.
+    output::state state_;
+
+    std::thread io_thread_;
+    std::mutex io_mutex_;
+    std::condition_variable io_wake_;
+    std::condition_variable io_done_;
+    bool io_pending_ = false;
+    bool io_stopping_ = false;
+    std::atomic<bool> failed_ = { false }; // Set by whichever thread fails to write a block.
+
+    void io_worker() __restrict;
+    void write_out(output::emitter & __restrict buffer) __restrict;
+
+  public:
+    gcode_writer(const std::string & __restrict filename, const config & __restrict cfg);
+    ~gcode_writer();
+
+    gcode_writer(const gcode_writer &) = delete;
+    gcode_writer & operator = (const gcode_writer &) = delete;
+
+    bool is_open() const __restrict
+    {
+      return file_ != nullptr;
+    }
+
+    void write(const std::vector<gcgg::command *> & __restrict commands) __restrict;
+    // Hands the current buffer off to be written. Without background I/O, it is written before this returns; with it,
+    // the result only covers the blocks written before this one.
+    bool flush() __restrict;
+    // Writes out everything that's left and closes the file. Returns false if any of it couldn't be written.
+    bool close() __restrict;
+  };
+
+  // Returns false if the file couldn't be opened or written.
+  extern bool write_gcode(const std::string & __restrict filename, const std::vector<gcgg::command *> & __restrict commands, const config & __restrict cfg);
+}
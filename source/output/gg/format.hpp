@@ -0,0 +1,124 @@
+#pragma once
+
+#include "gcgg.hpp"
+
+namespace gcgg::output::gg
+{
+  // gg is a compact binary form of the compiled command stream, for controllers that would rather not parse gcode.
+  //
+  // A file is a header followed by records. Every record starts with a one-byte opcode, followed by fixed-width fields
+  // that depend only on the opcode. Everything is little-endian.
+  //
+  // Moves and arcs are delta-encoded: X, Y and Z are how far the move goes from where the last one ended, E is the
+  // filament it feeds, and all of them are fixed-point. The opcode carries flags for which of those are present, and
+  // whether they are 16 or 32 bits wide. After them come the planned entry, plateau and exit speeds of the move, so the
+  // controller doesn't have to plan anything itself.
+  //
+  // Positions are only ever relative, so a position record (absolute) comes before the first move, and after any homing.
+
+  static constexpr const uint8 magic[2] = { 'g', 'g' };
+  static constexpr const uint8 version = 1;
+
+  // Fixed-point scales: units per mm, and per mm/s for speeds.
+  static constexpr const int64 position_scale = 1000;
+  static constexpr const int64 extrusion_scale = 100000;
+  static constexpr const int64 speed_scale = 10;
+
+  struct header final
+  {
+    uint8 magic[2];
+    uint8 version;
+    uint8 reserved;
+    uint32 position_scale;
+    uint32 extrusion_scale;
+    uint32 speed_scale;
+
+    static constexpr const usize size = 16;
+  };
+
+  // The top three bits of an opcode.
+  enum class kind : uint8
+  {
+    move = 0x00,
+    arc_cw = 0x20,
+    arc_ccw = 0x40,
+    instruction = 0xE0,
+  };
+  static constexpr const uint8 kind_mask = 0xE0;
+
+  // The low bits of a move or arc opcode.
+  namespace flags
+  {
+    static constexpr const uint8 x = 0x01;
+    static constexpr const uint8 y = 0x02;
+    static constexpr const uint8 z = 0x04;
+    static constexpr const uint8 e = 0x08;
+    static constexpr const uint8 wide = 0x10; // Deltas (and arc centres) are int32 rather than int16.
+  }
+
+  // move: [dx] [dy] [dz] [de], uint16 entry, plateau and exit speeds.
+  // arc: the same, followed by the centre (relative to the start) as i and j. X and Y are always present.
+  // Everything else is an instruction:
+  enum class opcode : uint8
+  {
+    position = uint8(kind::instruction), // int32 x, y, z. Absolute: where the next move starts.
+    print_acceleration, // uint16 mm/s^2
+    travel_acceleration, // uint16 mm/s^2
+    retract_acceleration, // uint16 mm/s^2
+    extruder_temperature, // uint8 extruder, uint16 degrees
+    extruder_temperature_wait, // uint8 extruder, uint16 degrees
+    bed_temperature, // uint8 bed, uint16 degrees
+    bed_temperature_wait, // uint8 bed, uint16 degrees
+    fan, // uint8 fan, uint8 speed (0 to 255)
+    home, // uint8 axes (flags::x, y, z). Homed axes are at 0.
+    disable_steppers, // uint16 seconds
+  };
+
+  // Size of the fields after an opcode, or 0 if the opcode is unknown (and the file can't be read any further).
+  static constexpr usize record_size(uint8 op)
+  {
+    const uint8 op_kind = op & kind_mask;
+    if (op_kind != uint8(kind::instruction))
+    {
+      if (op_kind != uint8(kind::move) && op_kind != uint8(kind::arc_cw) && op_kind != uint8(kind::arc_ccw))
+      {
+        return 0;
+      }
+
+      const usize width = (op & flags::wide) ? 4 : 2;
+      usize fields = 0;
+      fields += (op & flags::x) ? 1 : 0;
+      fields += (op & flags::y) ? 1 : 0;
+      fields += (op & flags::z) ? 1 : 0;
+      fields += (op & flags::e) ? 1 : 0;
+      if (op_kind != uint8(kind::move))
+      {
+        fields += 2;
+      }
+      return (fields * width) + (3 * sizeof(uint16));
+    }
+
+    switch (opcode(op))
+    {
+    case opcode::position:
+      return 3 * sizeof(int32);
+    case opcode::print_acceleration:
+    case opcode::travel_acceleration:
+    case opcode::retract_acceleration:
+      return sizeof(uint16);
+    case opcode::extruder_temperature:
+    case opcode::extruder_temperature_wait:
+    case opcode::bed_temperature:
+    case opcode::bed_temperature_wait:
+      return sizeof(uint8) + sizeof(uint16);
+    case opcode::fan:
+      return 2 * sizeof(uint8);
+    case opcode::home:
+      return sizeof(uint8);
+    case opcode::disable_steppers:
+      return sizeof(uint16);
+    default:
+      return 0;
+    }
+  }
+}
@@ -0,0 +1,250 @@
+#include "gcgg.hpp"
+#include "gg_out.hpp"
+
+#include <cmath>
+#include <limits>
+
+namespace
+{
+  using namespace gcgg::output;
+
+  static constexpr const real seconds_per_minute = 60.0;
+
+  template <typename T>
+  static T saturate(int64 value)
+  {
+    return T(clamp<int64>(value, int64(std::numeric_limits<T>::min()), int64(std::numeric_limits<T>::max())));
+  }
+
+  static int64 to_fixed(real value, int64 scale)
+  {
+    return std::llround(value * real(scale));
+  }
+
+  static void write_opcode(emitter & __restrict out, uint8 op)
+  {
+    out.write_binary(op);
+  }
+
+  static void write_speed(emitter & __restrict out, real feedrate)
+  {
+    out.write_binary(saturate<uint16>(to_fixed(max(feedrate, 0.0) / seconds_per_minute, gg::speed_scale)));
+  }
+
+  // Writes a move or an arc: the opcode with its flags, the deltas, the arc centre if it is one, then the speeds.
+  static void write_motion(
+    emitter & __restrict out,
+    state & __restrict state,
+    gg::kind kind,
+    const vector3<> & __restrict start,
+    const vector3<> & __restrict end,
+    const vector3<> * __restrict centre,
+    real extrusion,
+    real entry_feedrate,
+    real plateau_feedrate,
+    real exit_feedrate
+  )
+  {
+    // Only a move that goes somewhere says where it starts. Extrusion on its own happens wherever the head is.
+    if (!state.gg_position_known && (centre || start != end))
+    {
+      state.gg_position_known = true;
+      state.gg_position[0] = to_fixed(start.x, gg::position_scale);
+      state.gg_position[1] = to_fixed(start.y, gg::position_scale);
+      state.gg_position[2] = to_fixed(start.z, gg::position_scale);
+
+      write_opcode(out, uint8(gg::opcode::position));
+      out.write_binary(saturate<int32>(state.gg_position[0]));
+      out.write_binary(saturate<int32>(state.gg_position[1]));
+      out.write_binary(saturate<int32>(state.gg_position[2]));
+    }
+
+    const int64 target[3] = {
+      to_fixed(end.x, gg::position_scale),
+      to_fixed(end.y, gg::position_scale),
+      to_fixed(end.z, gg::position_scale),
+    };
+
+    state.gg_extrusion += extrusion;
+    const int64 target_extrusion = to_fixed(state.gg_extrusion, gg::extrusion_scale);
+
+    const int64 deltas[4] = {
+      target[0] - state.gg_position[0],
+      target[1] - state.gg_position[1],
+      target[2] - state.gg_position[2],
+      target_extrusion - state.gg_fixed_extrusion,
+    };
+
+    int64 centre_offset[2] = { 0, 0 };
+    if (centre)
+    {
+      centre_offset[0] = to_fixed(centre->x, gg::position_scale) - state.gg_position[0];
+      centre_offset[1] = to_fixed(centre->y, gg::position_scale) - state.gg_position[1];
+    }
+
+    // An arc always has X and Y, even when it ends where it started.
+    uint8 op = uint8(kind);
+    op |= (deltas[0] != 0 || centre) ? gg::flags::x : 0;
+    op |= (deltas[1] != 0 || centre) ? gg::flags::y : 0;
+    op |= (deltas[2] != 0) ? gg::flags::z : 0;
+    op |= (deltas[3] != 0) ? gg::flags::e : 0;
+
+    if (!centre && (op & (gg::flags::x | gg::flags::y | gg::flags::z | gg::flags::e)) == 0)
+    {
+      // Nothing moves once rounded. Anything it would have fed carries over to the next move.
+      return;
+    }
+
+    const auto fits_narrow = [](int64 value) -> bool
+    {
+      return value >= std::numeric_limits<int16>::min() && value <= std::numeric_limits<int16>::max();
+    };
+
+    bool wide = false;
+    for (int64 delta : deltas)
+    {
+      wide = wide || !fits_narrow(delta);
+    }
+    wide = wide || !fits_narrow(centre_offset[0]) || !fits_narrow(centre_offset[1]);
+    op |= wide ? gg::flags::wide : 0;
+
+    const auto write_value = [&out, wide](int64 value)
+    {
+      if (wide)
+      {
+        out.write_binary(saturate<int32>(value));
+      }
+      else
+      {
+        out.write_binary(int16(value));
+      }
+    };
+
+    write_opcode(out, op);
+    static constexpr const uint8 delta_flags[4] = { gg::flags::x, gg::flags::y, gg::flags::z, gg::flags::e };
+    for (usize i = 0; i < 4; ++i)
+    {
+      if (op & delta_flags[i])
+      {
+        write_value(deltas[i]);
+      }
+    }
+    if (centre)
+    {
+      write_value(centre_offset[0]);
+      write_value(centre_offset[1]);
+    }
+
+    write_speed(out, entry_feedrate);
+    write_speed(out, plateau_feedrate);
+    write_speed(out, exit_feedrate);
+
+    state.gg_position[0] = target[0];
+    state.gg_position[1] = target[1];
+    state.gg_position[2] = target[2];
+    state.gg_fixed_extrusion = target_extrusion;
+
+    state.prev_position = state.position;
+    state.position = end;
+  }
+}
+
+void gcgg::output::gg::write_header(emitter & __restrict out)
+{
+  out.write_binary(magic[0]);
+  out.write_binary(magic[1]);
+  out.write_binary(version);
+  out.write_binary(uint8(0));
+  out.write_binary(uint32(position_scale));
+  out.write_binary(uint32(extrusion_scale));
+  out.write_binary(uint32(speed_scale));
+}
+
+void gcgg::output::gg::write_acceleration(emitter & __restrict out, real & __restrict current, opcode op, real acceleration)
+{
+  if (acceleration == current || acceleration == 0)
+  {
+    return;
+  }
+  current = acceleration;
+
+  write_opcode(out, uint8(op));
+  out.write_binary(saturate<uint16>(std::llround(acceleration)));
+}
+
+void gcgg::output::gg::write_move(
+  emitter & __restrict out,
+  state & __restrict state,
+  const vector3<> & __restrict start,
+  const vector3<> & __restrict end,
+  real extrusion,
+  real entry_feedrate,
+  real plateau_feedrate,
+  real exit_feedrate
+)
+{
+  write_motion(out, state, kind::move, start, end, nullptr, extrusion, entry_feedrate, plateau_feedrate, exit_feedrate);
+}
+
+void gcgg::output::gg::write_arc(
+  emitter & __restrict out,
+  state & __restrict state,
+  const vector3<> & __restrict start,
+  const vector3<> & __restrict end,
+  const vector3<> & __restrict centre,
+  bool clockwise,
+  real extrusion,
+  real entry_feedrate,
+  real plateau_feedrate,
+  real exit_feedrate
+)
+{
+  write_motion(out, state, clockwise ? kind::arc_cw : kind::arc_ccw, start, end, &centre, extrusion, entry_feedrate, plateau_feedrate, exit_feedrate);
+}
+
+void gcgg::output::gg::write_temperature(emitter & __restrict out, opcode op, uint number, uint temperature)
+{
+  write_opcode(out, uint8(op));
+  out.write_binary(saturate<uint8>(number));
+  out.write_binary(saturate<uint16>(temperature));
+}
+
+void gcgg::output::gg::write_fan(emitter & __restrict out, uint number, uint speed)
+{
+  write_opcode(out, uint8(opcode::fan));
+  out.write_binary(saturate<uint8>(number));
+  out.write_binary(saturate<uint8>(speed));
+}
+
+void gcgg::output::gg::write_home(emitter & __restrict out, state & __restrict state, const vector3<bool> & __restrict axes)
+{
+  uint8 axis_flags = 0;
+  axis_flags |= axes.x ? flags::x : 0;
+  axis_flags |= axes.y ? flags::y : 0;
+  axis_flags |= axes.z ? flags::z : 0;
+
+  write_opcode(out, uint8(opcode::home));
+  out.write_binary(axis_flags);
+
+  if (axes.x)
+  {
+    state.position.x = 0.0;
+    state.gg_position[0] = 0;
+  }
+  if (axes.y)
+  {
+    state.position.y = 0.0;
+    state.gg_position[1] = 0;
+  }
+  if (axes.z)
+  {
+    state.position.z = 0.0;
+    state.gg_position[2] = 0;
+  }
+}
+
+void gcgg::output::gg::write_disable_steppers(emitter & __restrict out, uint delay)
+{
+  write_opcode(out, uint8(opcode::disable_steppers));
+  out.write_binary(saturate<uint16>(delay));
+}
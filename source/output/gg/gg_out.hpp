@@ -0,0 +1,46 @@
+#pragma once
+
+#include "output/state.hpp"
+#include "output/emitter.hpp"
+#include "output/gg/format.hpp"
+
+namespace gcgg::output::gg
+{
+  // Record writers for gg output, as used by each command's out_gg. Speeds are feedrates (mm/min), as motion_data_ has
+  // them; they are converted to gg's units here.
+
+  void write_header(output::emitter & __restrict out);
+
+  // Sets an acceleration, if it differs from current (the matching field of the output state, which is updated).
+  void write_acceleration(output::emitter & __restrict out, real & __restrict current, opcode op, real acceleration);
+
+  void write_move(
+    output::emitter & __restrict out,
+    output::state & __restrict state,
+    const vector3<> & __restrict start,
+    const vector3<> & __restrict end,
+    real extrusion,
+    real entry_feedrate,
+    real plateau_feedrate,
+    real exit_feedrate
+  );
+
+  void write_arc(
+    output::emitter & __restrict out,
+    output::state & __restrict state,
+    const vector3<> & __restrict start,
+    const vector3<> & __restrict end,
+    const vector3<> & __restrict centre,
+    bool clockwise,
+    real extrusion,
+    real entry_feedrate,
+    real plateau_feedrate,
+    real exit_feedrate
+  );
+
+  void write_temperature(output::emitter & __restrict out, opcode op, uint number, uint temperature);
+  void write_fan(output::emitter & __restrict out, uint number, uint speed);
+  // Homed axes are at 0 afterwards.
+  void write_home(output::emitter & __restrict out, output::state & __restrict state, const vector3<bool> & __restrict axes);
+  void write_disable_steppers(output::emitter & __restrict out, uint delay);
+}
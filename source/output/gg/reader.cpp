@@ -0,0 +1,147 @@
+#include "gcgg.hpp"
+#include "reader.hpp"
+
+namespace
+{
+  // Reads a little-endian integer and moves past it.
+  template <typename T>
+  static T read_binary(const uint8 * & __restrict data)
+  {
+    uint64 value = 0;
+    for (usize i = 0; i < sizeof(T); ++i)
+    {
+      value |= uint64(data[i]) << (i * 8);
+    }
+    data += sizeof(T);
+    return T(value);
+  }
+}
+
+gcgg::output::gg::reader::reader(const std::string & __restrict filename) :
+  file_(filename)
+{
+  if (!file_.is_open())
+  {
+    error_ = "could not open the file";
+    return;
+  }
+
+  cur_ = reinterpret_cast<const uint8 *>(file_.begin());
+  end_ = reinterpret_cast<const uint8 *>(file_.end());
+
+  if (usize(end_ - cur_) < header::size)
+  {
+    error_ = "too short for a header";
+    return;
+  }
+
+  header_.magic[0] = read_binary<uint8>(cur_);
+  header_.magic[1] = read_binary<uint8>(cur_);
+  header_.version = read_binary<uint8>(cur_);
+  header_.reserved = read_binary<uint8>(cur_);
+  header_.position_scale = read_binary<uint32>(cur_);
+  header_.extrusion_scale = read_binary<uint32>(cur_);
+  header_.speed_scale = read_binary<uint32>(cur_);
+
+  if (header_.magic[0] != magic[0] || header_.magic[1] != magic[1])
+  {
+    error_ = "not a gg file";
+  }
+  else if (header_.version != version)
+  {
+    error_ = "unsupported version";
+  }
+  else if (header_.position_scale == 0 || header_.extrusion_scale == 0 || header_.speed_scale == 0)
+  {
+    error_ = "bad fixed-point scales";
+  }
+}
+
+bool gcgg::output::gg::reader::next(record & __restrict out) __restrict
+{
+  if (error_ || cur_ == end_)
+  {
+    return false;
+  }
+
+  const uint8 op = *cur_;
+  const usize size = record_size(op);
+  if (size == 0)
+  {
+    error_ = "unknown opcode";
+    return false;
+  }
+  if (usize(end_ - cur_) < size + 1)
+  {
+    error_ = "truncated record";
+    return false;
+  }
+
+  out = {};
+  out.op = op;
+  const uint8 * data = cur_ + 1;
+  cur_ += size + 1;
+  ++records_;
+
+  if (out.is_motion())
+  {
+    const bool wide = (op & flags::wide) != 0;
+    const auto read_value = [&data, wide]() -> int32
+    {
+      return wide ? read_binary<int32>(data) : int32(read_binary<int16>(data));
+    };
+
+    static constexpr const uint8 delta_flags[4] = { flags::x, flags::y, flags::z, flags::e };
+    for (usize i = 0; i < 4; ++i)
+    {
+      if (op & delta_flags[i])
+      {
+        out.delta[i] = read_value();
+      }
+    }
+    if (out.get_kind() != kind::move)
+    {
+      out.centre[0] = read_value();
+      out.centre[1] = read_value();
+    }
+    for (uint16 & __restrict speed : out.speed)
+    {
+      speed = read_binary<uint16>(data);
+    }
+    return true;
+  }
+
+  switch (opcode(op))
+  {
+  case opcode::position:
+    for (int32 & __restrict axis : out.position)
+    {
+      axis = read_binary<int32>(data);
+    }
+    break;
+  case opcode::print_acceleration:
+  case opcode::travel_acceleration:
+  case opcode::retract_acceleration:
+  case opcode::disable_steppers:
+    out.value = read_binary<uint16>(data);
+    break;
+  case opcode::extruder_temperature:
+  case opcode::extruder_temperature_wait:
+  case opcode::bed_temperature:
+  case opcode::bed_temperature_wait:
+    out.index = read_binary<uint8>(data);
+    out.value = read_binary<uint16>(data);
+    break;
+  case opcode::fan:
+    out.index = read_binary<uint8>(data);
+    out.value = read_binary<uint8>(data);
+    break;
+  case opcode::home:
+    out.index = read_binary<uint8>(data);
+    break;
+  default:
+    break;
+  }
+
+  return true;
+}
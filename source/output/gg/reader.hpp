@@ -0,0 +1,76 @@
+#pragma once
+
+#include "gcgg.hpp"
+#include "output/gg/format.hpp"
+#include "platform/mapped_file.hpp"
+
+namespace gcgg::output::gg
+{
+  // One decoded record. Only the fields that its opcode has are set; the rest are zero.
+  struct record final
+  {
+    uint8 op = 0;
+
+    // Moves and arcs, in the file's fixed-point units.
+    int32 delta[4] = {}; // X, Y, Z, E
+    int32 centre[2] = {}; // Arcs: I and J, relative to the start.
+    uint16 speed[3] = {}; // Entry, plateau, exit.
+
+    // Instructions.
+    int32 position[3] = {}; // opcode::position
+    uint8 index = 0; // The extruder, bed or fan, or the axes that were homed.
+    uint32 value = 0; // Temperature, fan speed, acceleration or delay.
+
+    gg::kind get_kind() const __restrict
+    {
+      return gg::kind(op & kind_mask);
+    }
+
+    bool is_motion() const __restrict
+    {
+      return get_kind() != gg::kind::instruction;
+    }
+  };
+
+  // Reads a gg file a record at a time, straight out of a mapping of it. Nothing is allocated while reading.
+  class reader final
+  {
+    platform::mapped_file file_;
+    const uint8 * cur_ = nullptr;
+    const uint8 * end_ = nullptr;
+    gg::header header_ = {};
+    const char * error_ = nullptr;
+    usize records_ = 0;
+
+  public:
+    reader(const std::string & __restrict filename);
+
+    reader(const reader &) = delete;
+    reader & operator = (const reader &) = delete;
+
+    // False if the file couldn't be read, or a record in it was malformed.
+    bool is_valid() const __restrict
+    {
+      return error_ == nullptr;
+    }
+
+    const char * get_error() const __restrict
+    {
+      return error_;
+    }
+
+    const gg::header & get_header() const __restrict
+    {
+      return header_;
+    }
+
+    // Records read so far.
+    usize get_count() const __restrict
+    {
+      return records_;
+    }
+
+    // Reads the next record into out. Returns false at the end of the file, or at a malformed record.
+    bool next(record & __restrict out) __restrict;
+  };
+}
@@ -0,0 +1,333 @@
+#include "gcgg.hpp"
+#include "verify.hpp"
+#include "reader.hpp"
+
+#include "gcode/gcode.hpp"
+#include "segment/movement.hpp"
+#include "segment/extrusion.hpp"
+#include "instruction/G28.hpp"
+#include "instruction/M104.hpp"
+#include "instruction/M106.hpp"
+#include "instruction/M107.hpp"
+#include "instruction/M109.hpp"
+#include "instruction/M140.hpp"
+#include "instruction/M190.hpp"
+#include "instruction/M84.hpp"
+
+#include <chrono>
+#include <limits>
+
+namespace
+{
+  using namespace gcgg::output;
+
+  // An instruction, as both sides see it, along with where the head was and how much filament had been fed by then.
+  struct event final
+  {
+    gg::opcode op;
+    uint index;
+    uint value;
+    vector3<> position;
+    real extrusion;
+  };
+
+  // Mismatches beyond this many are counted, but not printed.
+  static constexpr const usize max_reported = 10;
+
+  template <typename T>
+  static uint saturate(uint value)
+  {
+    return min(value, uint(std::numeric_limits<T>::max()));
+  }
+
+  static const char * get_name(gg::opcode op)
+  {
+    switch (op)
+    {
+    case gg::opcode::extruder_temperature:
+      return "extruder temperature";
+    case gg::opcode::extruder_temperature_wait:
+      return "extruder temperature (wait)";
+    case gg::opcode::bed_temperature:
+      return "bed temperature";
+    case gg::opcode::bed_temperature_wait:
+      return "bed temperature (wait)";
+    case gg::opcode::fan:
+      return "fan";
+    case gg::opcode::home:
+      return "home";
+    case gg::opcode::disable_steppers:
+      return "disable steppers";
+    default:
+      return "unknown";
+    }
+  }
+
+  // The instructions in a processed command stream, in order. position and extrusion are left where the stream ends.
+  static void gather_events(
+    const std::vector<gcgg::command *> & __restrict commands,
+    std::vector<event> & __restrict events,
+    vector3<> & __restrict position,
+    real & __restrict extrusion
+  )
+  {
+    for (const gcgg::command * __restrict cmd : commands)
+    {
+      if (cmd->is_segment())
+      {
+        const segments::movement * __restrict move = static_cast<const segments::movement * __restrict>(cmd);
+        // Extrusion on its own doesn't have a position; it happens wherever the head is.
+        if (cmd->get_type() != segments::extrusion::type)
+        {
+          position = move->get_end_position();
+        }
+        extrusion += move->get_extrusion();
+        continue;
+      }
+
+      event evt = { gg::opcode::position, 0, 0, position, extrusion };
+      switch (cmd->get_type())
+      {
+      case instructions::M104::type:
+      {
+        const auto * __restrict instruction = static_cast<const instructions::M104 * __restrict>(cmd);
+        evt.op = gg::opcode::extruder_temperature;
+        evt.index = saturate<uint8>(instruction->get_number());
+        evt.value = saturate<uint16>(instruction->get_temperature());
+      } break;
+      case instructions::M109::type:
+      {
+        const auto * __restrict instruction = static_cast<const instructions::M109 * __restrict>(cmd);
+        evt.op = gg::opcode::extruder_temperature_wait;
+        evt.index = saturate<uint8>(instruction->get_number());
+        evt.value = saturate<uint16>(instruction->get_temperature());
+      } break;
+      case instructions::M140::type:
+      {
+        const auto * __restrict instruction = static_cast<const instructions::M140 * __restrict>(cmd);
+        evt.op = gg::opcode::bed_temperature;
+        evt.index = saturate<uint8>(instruction->get_number());
+        evt.value = saturate<uint16>(instruction->get_temperature());
+      } break;
+      case instructions::M190::type:
+      {
+        const auto * __restrict instruction = static_cast<const instructions::M190 * __restrict>(cmd);
+        evt.op = gg::opcode::bed_temperature_wait;
+        evt.index = saturate<uint8>(instruction->get_number());
+        evt.value = saturate<uint16>(instruction->get_temperature());
+      } break;
+      case instructions::M106::type:
+      {
+        const auto * __restrict instruction = static_cast<const instructions::M106 * __restrict>(cmd);
+        evt.op = gg::opcode::fan;
+        evt.index = saturate<uint8>(instruction->get_number());
+        evt.value = saturate<uint8>(instruction->get_speed());
+      } break;
+      case instructions::M107::type:
+      {
+        const auto * __restrict instruction = static_cast<const instructions::M107 * __restrict>(cmd);
+        evt.op = gg::opcode::fan;
+        evt.index = saturate<uint8>(instruction->get_number());
+      } break;
+      case instructions::M84::type:
+      {
+        const auto * __restrict instruction = static_cast<const instructions::M84 * __restrict>(cmd);
+        evt.op = gg::opcode::disable_steppers;
+        evt.value = saturate<uint16>(instruction->get_delay());
+      } break;
+      case instructions::G28::type:
+      {
+        const auto * __restrict instruction = static_cast<const instructions::G28 * __restrict>(cmd);
+        const vector3<bool> & __restrict axes = instruction->axis();
+        evt.op = gg::opcode::home;
+        evt.index = (axes.x ? gg::flags::x : 0) | (axes.y ? gg::flags::y : 0) | (axes.z ? gg::flags::z : 0);
+        // The position is checked before homing, like every other instruction.
+        position.x = axes.x ? 0.0 : position.x;
+        position.y = axes.y ? 0.0 : position.y;
+        position.z = axes.z ? 0.0 : position.z;
+      } break;
+      default:
+        // Nothing that gg has a record for.
+        continue;
+      }
+
+      events.push_back(evt);
+    }
+  }
+}
+
+bool gcgg::output::gg::verify(const std::string & __restrict gcode_filename, const std::string & __restrict gg_filename, const config & __restrict cfg)
+{
+  const auto start_time = std::chrono::steady_clock::now();
+
+  printf("Verifying %s against %s\n", gg_filename.c_str(), gcode_filename.c_str());
+
+  // The reference: the same job, with none of the passes that change the path.
+  config reference_cfg = cfg;
+  reference_cfg.arc.generate = false;
+  reference_cfg.reg_arc_gen.enable = false;
+  reference_cfg.simplify.enable = false;
+  reference_cfg.estimate.enable = false;
+  reference_cfg.cache.enable = false;
+
+  // Output always starts with the fan off.
+  std::vector<event> events = { { gg::opcode::fan, 0, 0, vector3<>::zero, 0.0 } };
+  vector3<> reference_position;
+  real reference_extrusion = 0.0;
+  {
+    gcode reference_gcode = { gcode_filename };
+    platform::arena arena;
+    const auto commands = reference_gcode.process(reference_cfg, arena);
+    gather_events(commands, events, reference_position, reference_extrusion);
+  }
+
+  gg::reader file = { gg_filename };
+  if (!file.is_valid())
+  {
+    printf("Verification failed: %s: %s\n", gg_filename.c_str(), file.get_error());
+    return false;
+  }
+
+  const real position_scale = real(file.get_header().position_scale);
+  const real extrusion_scale = real(file.get_header().extrusion_scale);
+
+  real position_tolerance = cfg.verify.position;
+  if (cfg.arc.generate)
+  {
+    position_tolerance = max(position_tolerance, max(cfg.arc.radius, cfg.arc.travel_radius));
+  }
+
+  // Positions are accumulated in fixed point, exactly as the controller would.
+  int64 fixed_position[3] = { 0, 0, 0 };
+  int64 fixed_extrusion = 0;
+
+  const auto get_position = [&]() -> vector3<>
+  {
+    return {
+      real(fixed_position[0]) / position_scale,
+      real(fixed_position[1]) / position_scale,
+      real(fixed_position[2]) / position_scale
+    };
+  };
+
+  usize mismatches = 0;
+  real worst_position = 0.0;
+  real worst_extrusion = 0.0;
+
+  // Compares where the head is (and the filament fed) against the reference. Returns false if they disagree.
+  const auto check_state = [&](const vector3<> & __restrict expected_position, real expected_extrusion) -> bool
+  {
+    const real position_error = get_position().distance(expected_position);
+    const real extrusion_error = std::abs((real(fixed_extrusion) / extrusion_scale) - expected_extrusion);
+    worst_position = max(worst_position, position_error);
+    worst_extrusion = max(worst_extrusion, extrusion_error);
+
+    const real extrusion_tolerance = max(cfg.verify.extrusion * std::abs(expected_extrusion), 1.0 / extrusion_scale);
+    return position_error <= position_tolerance && extrusion_error <= extrusion_tolerance;
+  };
+
+  const auto report = [&](const char * __restrict what, usize index)
+  {
+    if (mismatches++ < max_reported)
+    {
+      printf("  instruction %llu: %s\n", uint64(index), what);
+    }
+  };
+
+  usize next_event = 0;
+  gg::record rec;
+  while (file.next(rec))
+  {
+    if (rec.is_motion())
+    {
+      for (usize i = 0; i < 3; ++i)
+      {
+        fixed_position[i] += rec.delta[i];
+      }
+      fixed_extrusion += rec.delta[3];
+      continue;
+    }
+
+    switch (gg::opcode(rec.op))
+    {
+    case gg::opcode::position:
+      for (usize i = 0; i < 3; ++i)
+      {
+        fixed_position[i] = rec.position[i];
+      }
+      continue;
+    case gg::opcode::print_acceleration:
+    case gg::opcode::travel_acceleration:
+    case gg::opcode::retract_acceleration:
+      continue;
+    default:
+      break;
+    }
+
+    if (next_event == events.size())
+    {
+      report("not in the gcode", next_event);
+      continue;
+    }
+
+    const event & __restrict expected = events[next_event];
+    if (rec.op != uint8(expected.op) || rec.index != expected.index || rec.value != expected.value)
+    {
+      if (mismatches < max_reported)
+      {
+        printf(
+          "  instruction %llu: %s %u: %u, expected %s %u: %u\n",
+          uint64(next_event),
+          get_name(gg::opcode(rec.op)), uint(rec.index), uint(rec.value),
+          get_name(expected.op), expected.index, expected.value
+        );
+      }
+      ++mismatches;
+    }
+    else if (!check_state(expected.position, expected.extrusion))
+    {
+      report("position or extrusion differs", next_event);
+    }
+
+    if (rec.op == uint8(gg::opcode::home))
+    {
+      for (usize i = 0; i < 3; ++i)
+      {
+        if (rec.index & (1 << i))
+        {
+          fixed_position[i] = 0;
+        }
+      }
+    }
+
+    ++next_event;
+  }
+
+  if (!file.is_valid())
+  {
+    printf("Verification failed: %s: %s (record %llu)\n", gg_filename.c_str(), file.get_error(), uint64(file.get_count()));
+    return false;
+  }
+
+  if (next_event != events.size())
+  {
+    report("missing from the gg file", next_event);
+  }
+  if (!check_state(reference_position, reference_extrusion))
+  {
+    report("the job ends somewhere else", events.size());
+  }
+
+  const real seconds = std::chrono::duration<real>(std::chrono::steady_clock::now() - start_time).count();
+  printf(
+    "%s %llu records (%llu instructions) in %.3f s: worst position error %.4f mm, worst extrusion error %.5f mm\n",
+    (mismatches == 0) ? "Verified" : "Verification failed:",
+    uint64(file.get_count()), uint64(events.size()), seconds, worst_position, worst_extrusion
+  );
+  if (mismatches != 0)
+  {
+    printf("%llu mismatches\n", uint64(mismatches));
+  }
+
+  return mismatches == 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "gcgg.hpp"
+#include "config.hpp"
+
+namespace gcgg::output::gg
+{
+  // Checks a gg file against the gcode it was compiled from. The gcode is replayed through gcode::process with none of the
+  // optimizing passes, and the gg file through its reader, and the two have to agree on:
+  //   - the instructions (temperatures, fans, homing...), in order and with the same values,
+  //   - where the head was at each of them, within cfg.verify.position,
+  //   - the filament fed by each of them, within cfg.verify.extrusion of it,
+  //   - and the same for where the job ends.
+  // Corner arcs round off the corners they replace (and feed less filament for it), so the position tolerance is widened
+  // to their radius when they're on. Prints what it finds. Returns true if the files agree.
+  extern bool verify(const std::string & __restrict gcode_filename, const std::string & __restrict gg_filename, const config & __restrict cfg);
+}
@@ -1,22 +1,29 @@
-#pragma once
-
-#include <unordered_map>
-
-namespace gcgg::output
-{
-  struct state
-  {
-    real feedrate = 0.0;
-    real print_accel = 0.0;
-    real travel_accel = 0.0;
-    real retract_accel = 0.0;
-    vector3<> jerk;
-    real extrude_jerk;
-    std::unordered_map<uint, uint> extruder_temp;
-    std::unordered_map<uint, uint> bed_temp;
-    std::unordered_map<uint, uint> fan_speeds;
-
-    vector3<> position;
-    vector3<> prev_position;
-  };
-}
+#pragma once
+
+#include <unordered_map>
+
+namespace gcgg::output
+{
+  struct state
+  {
+    real feedrate = 0.0;
+    real print_accel = 0.0;
+    real travel_accel = 0.0;
+    real retract_accel = 0.0;
+    vector3<> jerk;
+    real extrude_jerk = 0.0;
+    std::unordered_map<uint, uint> extruder_temp;
+    std::unordered_map<uint, uint> bed_temp;
+    std::unordered_map<uint, uint> fan_speeds;
+
+    vector3<> position;
+    vector3<> prev_position;
+
+    // gg output: where the last move ended and the filament fed so far, in gg's fixed-point units. Moves are written
+    // relative to these rather than to each other, so rounding never accumulates.
+    bool gg_position_known = false;
+    int64 gg_position[3] = { 0, 0, 0 };
+    real gg_extrusion = 0.0;
+    int64 gg_fixed_extrusion = 0;
+  };
+}
@@ -0,0 +1,43 @@
+#include "gcgg.hpp"
+#include "platform/process.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global operator new to count allocations. The array and nothrow forms all end up here by default, and the
+// sized and array forms of operator delete end up in the plain one. Over-aligned allocations aren't counted.
+
+namespace
+{
+  static std::atomic<uint64> allocation_count = 0;
+  static std::atomic<uint64> allocation_bytes = 0;
+}
+
+void * operator new(std::size_t size)
+{
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+
+  void * __restrict result = std::malloc((size != 0) ? size : 1);
+  if (__unlikely(!result))
+  {
+    throw std::bad_alloc();
+  }
+  return result;
+}
+
+void operator delete(void * ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void * ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+gcgg::platform::process::allocations gcgg::platform::process::get_allocations()
+{
+  return { allocation_count.load(std::memory_order_relaxed), allocation_bytes.load(std::memory_order_relaxed) };
+}
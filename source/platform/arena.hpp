@@ -0,0 +1,116 @@
+#pragma once
+
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace gcgg::platform
+{
+  // Bump allocator that owns every object made in it. Objects are placed back-to-back in large blocks and are never freed
+  // individually; reset (or destroying the arena) runs their destructors in reverse order of creation and releases
+  // everything at once. Objects that are dropped early simply wait for the rest.
+  class arena final
+  {
+    static constexpr const usize default_block_size = 1024 * 1024;
+
+    struct block final
+    {
+      std::unique_ptr<char[]> data;
+      usize size;
+    };
+
+    struct finalizer final
+    {
+      void (*destroy)(void *);
+      void * object;
+    };
+
+    std::vector<block> blocks_;
+    std::vector<finalizer> finalizers_;
+    usize current_block_ = 0;
+    char * cur_ = nullptr;
+    char * end_ = nullptr;
+    usize block_size_;
+
+    void next_block(usize size, usize alignment) __restrict
+    {
+      // Reuse blocks left over from before a reset if one is large enough.
+      while (++current_block_ < blocks_.size())
+      {
+        if (blocks_[current_block_].size >= size + alignment)
+        {
+          cur_ = blocks_[current_block_].data.get();
+          end_ = cur_ + blocks_[current_block_].size;
+          return;
+        }
+      }
+
+      const usize new_size = max(block_size_, size + alignment);
+      blocks_.push_back({ std::unique_ptr<char[]>(new char[new_size]), new_size });
+      current_block_ = blocks_.size() - 1;
+      cur_ = blocks_.back().data.get();
+      end_ = cur_ + new_size;
+    }
+
+    void run_finalizers() __restrict
+    {
+      for (auto i = finalizers_.rbegin(); i != finalizers_.rend(); ++i)
+      {
+        i->destroy(i->object);
+      }
+      finalizers_.clear();
+    }
+
+  public:
+    arena(usize block_size = default_block_size) : block_size_(block_size) {}
+
+    ~arena()
+    {
+      run_finalizers();
+    }
+
+    arena(const arena &) = delete;
+    arena & operator = (const arena &) = delete;
+
+    void * allocate(usize size, usize alignment) __restrict
+    {
+      char * __restrict result = (char *)((uintptr_t(cur_) + (alignment - 1)) & ~uintptr_t(alignment - 1));
+      if (__unlikely(!cur_ || result + size > end_))
+      {
+        next_block(size, alignment);
+        result = (char *)((uintptr_t(cur_) + (alignment - 1)) & ~uintptr_t(alignment - 1));
+      }
+      cur_ = result + size;
+      return result;
+    }
+
+    template <typename T, typename... Args>
+    T * make(Args && ... args) __restrict
+    {
+      T * __restrict object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+      if constexpr (!std::is_trivially_destructible_v<T>)
+      {
+        finalizers_.push_back({ [](void * ptr) { static_cast<T *>(ptr)->~T(); }, object });
+      }
+      return object;
+    }
+
+    // Destroys everything in the arena. The blocks are kept for reuse.
+    void reset() __restrict
+    {
+      run_finalizers();
+      current_block_ = 0;
+      if (blocks_.empty())
+      {
+        cur_ = end_ = nullptr;
+      }
+      else
+      {
+        cur_ = blocks_[0].data.get();
+        end_ = cur_ + blocks_[0].size;
+      }
+    }
+  };
+}
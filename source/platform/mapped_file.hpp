@@ -0,0 +1,71 @@
+#pragma once
+
+namespace gcgg::platform
+{
+  // Read-only mapping of an entire file. The contents are paged in by the OS on demand instead of being copied
+  // into a private buffer, so a mapped input never counts against our heap and the first bytes are available immediately.
+  // The implementation lives in the platform directories.
+  class mapped_file final
+  {
+    const char * data_ = nullptr;
+    usize size_ = 0;
+    bool open_ = false;
+
+    void close() __restrict;
+
+  public:
+    mapped_file() = default;
+    mapped_file(const std::string & __restrict filename);
+    ~mapped_file();
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file & operator = (const mapped_file &) = delete;
+
+    mapped_file(mapped_file && __restrict file) :
+      data_(file.data_),
+      size_(file.size_),
+      open_(file.open_)
+    {
+      file.data_ = nullptr;
+      file.size_ = 0;
+      file.open_ = false;
+    }
+
+    mapped_file & operator = (mapped_file && __restrict file) __restrict
+    {
+      close();
+      data_ = file.data_;
+      size_ = file.size_;
+      open_ = file.open_;
+      file.data_ = nullptr;
+      file.size_ = 0;
+      file.open_ = false;
+      return *this;
+    }
+
+    bool is_open() const __restrict
+    {
+      return open_;
+    }
+
+    const char * data() const __restrict
+    {
+      return data_;
+    }
+
+    usize size() const __restrict
+    {
+      return size_;
+    }
+
+    const char * begin() const __restrict
+    {
+      return data_;
+    }
+
+    const char * end() const __restrict
+    {
+      return data_ + size_;
+    }
+  };
+}
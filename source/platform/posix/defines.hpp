@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cassert>
+// MSVC's standard headers drag these in transitively, libstdc++ and libc++ do not.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define OS POSIX
+
+#define __likely(c) (__builtin_expect(!!(c), 1))
+#define __unlikely(c) (__builtin_expect(!!(c), 0))
+#define __unreachable __builtin_unreachable()
+#define nodefault default: { __unreachable; }
+
+// MSVC-only pragma operator. GCC and Clang have _Pragma, but the warnings we toggle with it are MSVC warnings anyways.
+#define __pragma(p)
+
+#define xassert(c) assert(c)
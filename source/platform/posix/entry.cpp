@@ -0,0 +1,111 @@
+#include "gcgg.hpp"
+#include "gcode/gcode.hpp"
+#include "output/gcode/gcode_out.hpp"
+#include "output/gg/verify.hpp"
+#include "cache/job_cache.hpp"
+#include "stats/stats.hpp"
+
+namespace
+{
+  // gg output can be checked against the gcode it came from once it's written.
+  static int verify_output(const char * __restrict in_file, const char * __restrict out_file, const config & __restrict cfg, stats::report * __restrict stats)
+  {
+    if (!cfg.verify.enable || cfg.output.format != config::format::gg)
+    {
+      return 0;
+    }
+
+    stats::stage stage = { stats, "verify" };
+    const bool verified = output::gg::verify(in_file, out_file, cfg);
+    stage.finish();
+    return verified ? 0 : 1;
+  }
+}
+
+int main(int argc, const char * const __restrict * const __restrict argv)
+{
+  if (argc < 3)
+  {
+    printf("usage: %s <input.gcode> <output.gcode>\n", argv[0]);
+    return 1;
+  }
+
+  const char * const __restrict in_file = argv[1];
+  const char * const __restrict out_file = argv[2];
+
+  gcode _gc = { in_file };
+
+  config cfg;
+
+  stats::report report;
+  stats::report * const __restrict job_stats = cfg.stats.enable ? &report : nullptr;
+
+  // Checks the output, if it was written, and writes out the stats, once the job's done.
+  const auto finish = [&](bool written) -> int
+  {
+    const int result = (written) ? verify_output(in_file, out_file, cfg, job_stats) : 1;
+    if (job_stats)
+    {
+      report.write(cfg.stats.filename);
+    }
+    return result;
+  };
+
+  // A job that's been compiled before, with the same config, is written straight from the cache.
+  cache::key cache_key;
+  if (cfg.cache.enable)
+  {
+    stats::stage stage = { job_stats, "cache_read" };
+    cache_key = cache::make_key(in_file, cfg);
+    const cache::cached_output cached = cache::write_cached(cache_key, out_file, cfg);
+    stage.finish();
+    if (cached != cache::cached_output::missing)
+    {
+      return finish(cached == cache::cached_output::written);
+    }
+  }
+
+  if (cfg.stream.enable)
+  {
+    output::gcode_writer writer = { out_file, cfg };
+    if (!writer.is_open())
+    {
+      return 1;
+    }
+
+    cache::writer cache_writer = { cache_key, cfg };
+    _gc.stream(cfg, [&](const std::vector<gcgg::command *> & __restrict commands)
+    {
+      writer.write(commands);
+      cache_writer.write(commands);
+    }, job_stats);
+
+    // A job whose output couldn't be written isn't cached; the entry is dropped with the writer.
+    const bool written = writer.close();
+    if (written)
+    {
+      cache_writer.commit();
+    }
+
+    return finish(written);
+  }
+
+  platform::arena arena;
+  auto commands = _gc.process(cfg, arena, job_stats);
+
+  printf("Outputing...\n");
+  stats::stage output_stage = { job_stats, "output", commands.size() };
+  const bool written = output::write_gcode(out_file, commands, cfg);
+  output_stage.finish(commands.size());
+
+  if (written && cfg.cache.enable)
+  {
+    stats::stage stage = { job_stats, "cache_write", commands.size() };
+    cache::writer cache_writer = { cache_key, cfg };
+    cache_writer.write(commands);
+    cache_writer.commit();
+    stage.finish();
+  }
+
+  return finish(written);
+}
@@ -0,0 +1,64 @@
+#include "gcgg.hpp"
+#include "platform/mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+platform::mapped_file::mapped_file(const std::string & __restrict filename)
+{
+  const int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    return;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    ::close(fd);
+    return;
+  }
+
+  size_ = usize(st.st_size);
+  if (size_ == 0)
+  {
+    // mmap refuses zero-length mappings. An empty file is still a valid (empty) input.
+    ::close(fd);
+    open_ = true;
+    return;
+  }
+
+  void * const mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping holds its own reference to the file.
+  ::close(fd);
+
+  if (mapping == MAP_FAILED)
+  {
+    size_ = 0;
+    return;
+  }
+
+  // We only ever walk the input front to back, so let the kernel read ahead aggressively and drop pages behind us.
+  madvise(mapping, size_, MADV_SEQUENTIAL);
+
+  data_ = static_cast<const char *>(mapping);
+  open_ = true;
+}
+
+platform::mapped_file::~mapped_file()
+{
+  close();
+}
+
+void platform::mapped_file::close() __restrict
+{
+  if (data_)
+  {
+    munmap(const_cast<char *>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  open_ = false;
+}
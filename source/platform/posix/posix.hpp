@@ -0,0 +1,4 @@
+#pragma once
+
+#include "defines.hpp"
+#include "types.hpp"
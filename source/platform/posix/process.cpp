@@ -0,0 +1,30 @@
+#include "gcgg.hpp"
+#include "platform/process.hpp"
+
+#include <sys/resource.h>
+#include <time.h>
+
+real gcgg::platform::process::get_cpu_time()
+{
+  timespec time;
+  if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0)
+  {
+    return 0.0;
+  }
+  return real(time.tv_sec) + (real(time.tv_nsec) * 1.0e-9);
+}
+
+usize gcgg::platform::process::get_peak_memory()
+{
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+  {
+    return 0;
+  }
+#if defined(__APPLE__)
+  return usize(usage.ru_maxrss);
+#else
+  // Linux reports it in kilobytes.
+  return usize(usage.ru_maxrss) * 1024;
+#endif
+}
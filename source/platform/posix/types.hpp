@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <string>
+
+namespace gcgg
+{
+  using uint8 = uint8_t;
+  using uint16 = uint16_t;
+  using uint32 = uint32_t;
+  // uint64_t is 'unsigned long' on LP64, which would make every %llu in the tree wrong. Keep it the same type as on Windows.
+  using uint64 = unsigned long long;
+
+  using int8 = int8_t;
+  using int16 = int16_t;
+  using int32 = int32_t;
+  using int64 = long long;
+
+  using uint = uint32;
+
+  using uptr = uint64;
+  using sptr = int64;
+
+  using uintx = uint64;
+  using intx = int64;
+
+  using usize = uint64;
+  using ssize = int64;
+
+  using float32 = float;
+  using float64 = double;
+
+  using real = float64;
+
+  template <typename T>
+  using vector = std::vector<T>;
+
+  template <typename T, usize N>
+  using array = std::array<T, N>;
+}
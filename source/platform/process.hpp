@@ -0,0 +1,23 @@
+#pragma once
+
+namespace gcgg::platform::process
+{
+  // What the process has used so far, for instrumentation (see stats/stats.hpp). The implementations of get_cpu_time and
+  // get_peak_memory live in the platform directories.
+
+  // Seconds of CPU time used by every thread of the process, user and kernel.
+  extern real get_cpu_time();
+
+  // The most memory the process has had resident at once, in bytes.
+  extern usize get_peak_memory();
+
+  struct allocations final
+  {
+    uint64 count = 0;
+    uint64 bytes = 0;
+  };
+
+  // Heap allocations made through operator new since the process started. Arena blocks are counted; the objects made in
+  // them aren't, as they don't touch the heap.
+  extern allocations get_allocations();
+}
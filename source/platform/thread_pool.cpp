@@ -0,0 +1,145 @@
+#include "gcgg.hpp"
+#include "thread_pool.hpp"
+
+using namespace gcgg::platform;
+
+namespace
+{
+  // Set on each worker thread, so that jobs submitted from inside a job land on the worker's own queue.
+  static thread_local const thread_pool * current_pool = nullptr;
+  static thread_local uint current_queue = 0;
+}
+
+thread_pool::thread_pool(uint threads)
+{
+  if (threads == 0)
+  {
+    threads = max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  queue_count_ = threads;
+  queues_ = std::make_unique<queue[]>(threads);
+
+  workers_.reserve(threads);
+  for (uint i = 0; i < threads; ++i)
+  {
+    workers_.emplace_back([this, i]() { worker(i); });
+  }
+}
+
+thread_pool::~thread_pool()
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+
+  for (auto & __restrict thread : workers_)
+  {
+    thread.join();
+  }
+}
+
+thread_pool & thread_pool::get()
+{
+  static thread_pool pool;
+  return pool;
+}
+
+uint thread_pool::home_queue() __restrict
+{
+  if (current_pool == this)
+  {
+    return current_queue;
+  }
+  return next_queue_++ % queue_count_;
+}
+
+void thread_pool::submit(std::function<void()> && __restrict job) __restrict
+{
+  // Counted before it's queued, so that the count never falls below what's actually there.
+  ++queued_;
+  {
+    queue & __restrict target = queues_[home_queue()];
+    std::unique_lock<std::mutex> lock(target.mutex);
+    target.jobs.push_back(std::move(job));
+  }
+
+  // Taking the lock orders this against a worker checking queued_ just before it sleeps.
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+  }
+  wake_.notify_one();
+}
+
+bool thread_pool::run_one(uint home) __restrict
+{
+  if (queued_ == 0)
+  {
+    return false;
+  }
+
+  std::function<void()> job;
+  for (uint i = 0; i < queue_count_ && !job; ++i)
+  {
+    queue & __restrict source = queues_[(home + i) % queue_count_];
+    std::unique_lock<std::mutex> lock(source.mutex);
+    if (source.jobs.empty())
+    {
+      continue;
+    }
+
+    // Our own newest job is the one most likely to still be in cache; a stolen one is the oldest, and so usually the
+    // largest piece of work left.
+    if (i == 0)
+    {
+      job = std::move(source.jobs.back());
+      source.jobs.pop_back();
+    }
+    else
+    {
+      job = std::move(source.jobs.front());
+      source.jobs.pop_front();
+    }
+  }
+
+  if (!job)
+  {
+    return false;
+  }
+  --queued_;
+
+  job();
+  return true;
+}
+
+void thread_pool::wake_all() __restrict
+{
+  // Taking the lock orders this against a sleeper checking its condition just before it sleeps.
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+  }
+  wake_.notify_all();
+}
+
+void thread_pool::worker(uint index) __restrict
+{
+  current_pool = this;
+  current_queue = index;
+
+  for (;;)
+  {
+    if (run_one(index))
+    {
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    wake_.wait(lock, [this]() { return stopping_ || queued_ != 0; });
+    if (stopping_ && queued_ == 0)
+    {
+      return;
+    }
+  }
+}
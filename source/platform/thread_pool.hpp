@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gcgg::platform
+{
+  // A fixed set of worker threads with work stealing. Every worker has its own queue: it runs its newest job first, and
+  // when that runs dry it steals the oldest job from another worker, so uneven jobs (a layer full of curves next to one
+  // of straight lines) even out on their own. Meant for coarse data-parallel work (whole chunks of a file or spans of
+  // commands, not individual commands), so each queue is just mutex-protected.
+  class thread_pool final
+  {
+    struct queue final
+    {
+      std::mutex mutex;
+      std::deque<std::function<void()>> jobs;
+    };
+
+    std::vector<std::thread> workers_;
+    std::unique_ptr<queue[]> queues_;
+    uint queue_count_ = 0;
+    std::atomic<uint> next_queue_ = 0; // Where jobs submitted from outside the pool go, round-robin.
+    std::atomic<usize> queued_ = 0;
+    std::mutex mutex_; // Only for sleeping and waking.
+    std::condition_variable wake_; // Idle workers, and parallel_for callers with nothing left to run, sleep on this.
+    bool stopping_ = false;
+
+    void worker(uint index) __restrict;
+
+    // Runs one job, preferring the given queue and stealing from the others. Returns false if there was none.
+    bool run_one(uint home) __restrict;
+
+    // The queue the calling thread should use: its own if it's one of our workers.
+    uint home_queue() __restrict;
+
+    // Wakes every sleeping thread, so that each checks whether it has anything to do.
+    void wake_all() __restrict;
+
+  public:
+    // A thread count of 0 uses one thread per hardware thread.
+    thread_pool(uint threads = 0);
+    ~thread_pool();
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool & operator = (const thread_pool &) = delete;
+
+    // The pool shared by everything in the process.
+    static thread_pool & get();
+
+    uint size() const __restrict
+    {
+      return uint(workers_.size());
+    }
+
+    void submit(std::function<void()> && __restrict job) __restrict;
+
+    // Calls func(i) for every i in [0, count) across the pool and waits for all of them. The calling thread runs jobs
+    // too while it waits (stealing from other queues once its own is empty), so this can be called from inside a job.
+    // Once there's nothing left to run, it sleeps until the last of its jobs finishes or more work is queued.
+    template <typename F>
+    void parallel_for(usize count, const F & __restrict func) __restrict
+    {
+      if (count == 1 || size() <= 1)
+      {
+        for (usize i = 0; i < count; ++i)
+        {
+          func(i);
+        }
+        return;
+      }
+
+      std::atomic<usize> remaining = count;
+      for (usize i = 0; i < count; ++i)
+      {
+        submit([this, &func, &remaining, i]()
+        {
+          func(i);
+          // Nothing of the caller's can be touched once this reaches 0, as it may already have returned.
+          if (--remaining == 0)
+          {
+            wake_all();
+          }
+        });
+      }
+
+      const uint home = home_queue();
+      while (remaining != 0)
+      {
+        if (!run_one(home))
+        {
+          // Everything left is already running elsewhere.
+          std::unique_lock<std::mutex> lock(mutex_);
+          wake_.wait(lock, [this, &remaining]() { return remaining == 0 || queued_ != 0; });
+        }
+      }
+    }
+  };
+}
@@ -1,31 +1,114 @@
-#include "gcgg.hpp"
-#include "gcode/gcode.hpp"
-#include "output/gcode/gcode_out.hpp"
-
-int main(int argc, const char * const __restrict * const __restrict argv)
-{
-  //static const char dummy_file[] = "C:\\Users\\mkuklinski\\Documents\\MSP_bed_carriage.gcode";
-  //static const char out_file[] = "C:\\Users\\mkuklinski\\Documents\\OPT_bed_carriage.gcode";
-  //static const char dummy_file[] = R"(G:\CFDMP_test_cube_plain.gcode)";
-  //static const char out_file[] = R"(G:\OPT_test_cube_plain.gcode)";
-  static const char dummy_file[] = R"(C:\Users\mkuklinski\Documents\CFDMP_curved_cylinder.gcode)";
-  static const char out_file[] = R"(C:\Users\mkuklinski\Documents\OPT_curved_cylinder.gcode)";
-
-  gcode _gc = { dummy_file };
-
-  config cfg;
-  //cfg.arc.generate = false;
-  //cfg.smoothing.enable = false;
-
-  auto commands = _gc.process(cfg);
-
-  //for (const auto &cmd : commands)
-  //{
-  //  printf("%s\n", cmd->dump().c_str());
-  //}
-
-  printf("Outputing...\n");
-  output::write_gcode(out_file, commands, cfg);
-
-  return 0;
-}
+#include "gcgg.hpp"
+#include "gcode/gcode.hpp"
+#include "output/gcode/gcode_out.hpp"
+#include "output/gg/verify.hpp"
+#include "cache/job_cache.hpp"
+#include "stats/stats.hpp"
+
+namespace
+{
+  // gg output can be checked against the gcode it came from once it's written.
+  static int verify_output(const char * __restrict in_file, const char * __restrict out_file, const config & __restrict cfg, stats::report * __restrict stats)
+  {
+    if (!cfg.verify.enable || cfg.output.format != config::format::gg)
+    {
+      return 0;
+    }
+
+    stats::stage stage = { stats, "verify" };
+    const bool verified = output::gg::verify(in_file, out_file, cfg);
+    stage.finish();
+    return verified ? 0 : 1;
+  }
+}
+
+int main(int argc, const char * const __restrict * const __restrict argv)
+{
+  //static const char dummy_file[] = "C:\\Users\\mkuklinski\\Documents\\MSP_bed_carriage.gcode";
+  //static const char out_file[] = "C:\\Users\\mkuklinski\\Documents\\OPT_bed_carriage.gcode";
+  //static const char dummy_file[] = R"(G:\CFDMP_test_cube_plain.gcode)";
+  //static const char out_file[] = R"(G:\OPT_test_cube_plain.gcode)";
+  static const char dummy_file[] = R"(C:\Users\mkuklinski\Documents\CFDMP_curved_cylinder.gcode)";
+  static const char out_file[] = R"(C:\Users\mkuklinski\Documents\OPT_curved_cylinder.gcode)";
+
+  gcode _gc = { dummy_file };
+
+  config cfg;
+  //cfg.arc.generate = false;
+  //cfg.smoothing.enable = false;
+
+  stats::report report;
+  stats::report * const __restrict job_stats = cfg.stats.enable ? &report : nullptr;
+
+  // Checks the output, if it was written, and writes out the stats, once the job's done.
+  const auto finish = [&](bool written) -> int
+  {
+    const int result = (written) ? verify_output(dummy_file, out_file, cfg, job_stats) : 1;
+    if (job_stats)
+    {
+      report.write(cfg.stats.filename);
+    }
+    return result;
+  };
+
+  // A job that's been compiled before, with the same config, is written straight from the cache.
+  cache::key cache_key;
+  if (cfg.cache.enable)
+  {
+    stats::stage stage = { job_stats, "cache_read" };
+    cache_key = cache::make_key(dummy_file, cfg);
+    const cache::cached_output cached = cache::write_cached(cache_key, out_file, cfg);
+    stage.finish();
+    if (cached != cache::cached_output::missing)
+    {
+      return finish(cached == cache::cached_output::written);
+    }
+  }
+
+  if (cfg.stream.enable)
+  {
+    output::gcode_writer writer = { out_file, cfg };
+    if (!writer.is_open())
+    {
+      return 1;
+    }
+
+    cache::writer cache_writer = { cache_key, cfg };
+    _gc.stream(cfg, [&](const std::vector<gcgg::command *> & __restrict commands)
+    {
+      writer.write(commands);
+      cache_writer.write(commands);
+    }, job_stats);
+
+    // A job whose output couldn't be written isn't cached; the entry is dropped with the writer.
+    const bool written = writer.close();
+    if (written)
+    {
+      cache_writer.commit();
+    }
+    return finish(written);
+  }
+
+  platform::arena arena;
+  auto commands = _gc.process(cfg, arena, job_stats);
+
+  //for (const auto &cmd : commands)
+  //{
+  //  printf("%s\n", cmd->dump().c_str());
+  //}
+
+  printf("Outputing...\n");
+  stats::stage output_stage = { job_stats, "output", commands.size() };
+  const bool written = output::write_gcode(out_file, commands, cfg);
+  output_stage.finish(commands.size());
+  if (written && cfg.cache.enable)
+  {
+    stats::stage stage = { job_stats, "cache_write", commands.size() };
+    cache::writer cache_writer = { cache_key, cfg };
+    cache_writer.write(commands);
+    cache_writer.commit();
+    stage.finish();
+  }
+
+  return finish(written);
+}
@@ -0,0 +1,76 @@
+#include "gcgg.hpp"
+#include "platform/mapped_file.hpp"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+
+platform::mapped_file::mapped_file(const std::string & __restrict filename)
+{
+  // FILE_FLAG_SEQUENTIAL_SCAN is the Windows equivalent of MADV_SEQUENTIAL - it makes the cache manager read ahead more aggressively.
+  const HANDLE file = CreateFileA(
+    filename.c_str(),
+    GENERIC_READ,
+    FILE_SHARE_READ,
+    nullptr,
+    OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+    nullptr
+  );
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return;
+  }
+
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size))
+  {
+    CloseHandle(file);
+    return;
+  }
+
+  size_ = usize(file_size.QuadPart);
+  if (size_ == 0)
+  {
+    // CreateFileMapping refuses zero-length files. An empty file is still a valid (empty) input.
+    CloseHandle(file);
+    open_ = true;
+    return;
+  }
+
+  const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (!mapping)
+  {
+    size_ = 0;
+    return;
+  }
+
+  const void * const view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  // The view holds its own reference to the mapping.
+  CloseHandle(mapping);
+  if (!view)
+  {
+    size_ = 0;
+    return;
+  }
+
+  data_ = static_cast<const char *>(view);
+  open_ = true;
+}
+
+platform::mapped_file::~mapped_file()
+{
+  close();
+}
+
+void platform::mapped_file::close() __restrict
+{
+  if (data_)
+  {
+    UnmapViewOfFile(data_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  open_ = false;
+}
@@ -0,0 +1,33 @@
+#include "gcgg.hpp"
+#include "platform/process.hpp"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <Psapi.h>
+
+real gcgg::platform::process::get_cpu_time()
+{
+  FILETIME creation_time, exit_time, kernel_time, user_time;
+  if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+  {
+    return 0.0;
+  }
+
+  // FILETIMEs count 100 ns intervals.
+  const auto to_seconds = [](const FILETIME & __restrict time) -> real
+  {
+    return real((uint64(time.dwHighDateTime) << 32) | uint64(time.dwLowDateTime)) * 1.0e-7;
+  };
+  return to_seconds(kernel_time) + to_seconds(user_time);
+}
+
+usize gcgg::platform::process::get_peak_memory()
+{
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+  {
+    return 0;
+  }
+  return usize(counters.PeakWorkingSetSize);
+}
@@ -1,41 +1,41 @@
-#pragma once
-
-#include <cstdint>
-#include <vector>
-#include <array>
-#include <string>
-
-namespace gcgg
-{
-  using uint8 = uint8_t;
-  using uint16 = uint16_t;
-  using uint32 = uint32_t;
-  using uint64 = uint64_t;
-
-  using int8 = int8_t;
-  using int16 = int16_t;
-  using int32 = int32_t;
-  using int64 = int64_t;
-
-  using uint = uint32;
-
-  using uptr = uint64;
-  using sptr = int64;
-
-  using uintx = uint64;
-  using intx = int64;
-
-  using usize = uint64;
-  using ssize = int64;
-
-  using float32 = float;
-  using float64 = double;
-
-  using real = float64;
-
-  template <typename T>
-  using vector = std::vector<T>;
-
-  template <typename T, usize N>
-  using array = std::array<T, N>;
-}
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <string>
+
+namespace gcgg
+{
+  using uint8 = uint8_t;
+  using uint16 = uint16_t;
+  using uint32 = uint32_t;
+  using uint64 = uint64_t;
+
+  using int8 = int8_t;
+  using int16 = int16_t;
+  using int32 = int32_t;
+  using int64 = int64_t;
+
+  using uint = uint32;
+
+  using uptr = uint64;
+  using sptr = int64;
+
+  using uintx = uint64;
+  using intx = int64;
+
+  using usize = uint64;
+  using ssize = int64;
+
+  using float32 = float;
+  using float64 = double;
+
+  using real = float64;
+
+  template <typename T>
+  using vector = std::vector<T>;
+
+  template <typename T, usize N>
+  using array = std::array<T, N>;
+}
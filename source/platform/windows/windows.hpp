@@ -1,4 +1,4 @@
-#pragma once
-
-#include "defines.hpp"
-#include "types.hpp"
+#pragma once
+
+#include "defines.hpp"
+#include "types.hpp"
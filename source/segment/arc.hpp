@@ -1,873 +1,729 @@
-#pragma once
-
-#include "movement.hpp"
-#include "extrusion_move.hpp"
-#include "travel.hpp"
-#include <algorithm>
-
-namespace gcgg::segments
-{
-  // Linear movement with extrusion
-  class arc final : public movement
-  {
-  public:
-    static constexpr const uint64 type = hash("arc");
-
-  protected:
-    real extrude_[2];
-    real seg_feedrate_[2];
-    real acceleration_[2];
-    vector3<> jerk_[2];
-    real extrude_jerk_[2];
-    vector3<> corner_;
-    real radius_;
-    real angle_;
-    vector3<> arc_origin_;
-    
-  public:
-    vector3<> parent_velocities_[2];
-
-  private:
-    struct segment final
-    {
-      vector3<> start;
-      vector3<> end;
-
-      real linear_offset = 1.0;
-
-      vector3<> get_vector(real magnitude = 1.0) const __restrict
-      {
-        return (end - start).normalized(magnitude);
-      }
-
-      real angle_between(const segment & __restrict seg) const __restrict
-      {
-        const vector3<> vec_a = (end - start).normalized();
-        const vector3<> vec_b = (seg.end - seg.start).normalized();
-        return vec_a.angle_between(vec_b);
-      }
-    };
-
-    struct segment_data final
-    {
-      std::vector<segment> segments_;
-      real feedrate_;
-      real length_;
-      array<real, 2> extrusion_;
-      real acceleration_;
-      vector3<> jerk_;
-      real extrude_jerk_;
-    };
-
-    std::tuple<bool, real> is_simple_arc(const config & __restrict cfg, bool high_precision = false) const __restrict
-    {
-      if (!cfg.output.arcs_support_Z && start_position_.z != end_position_.z)
-      {
-        return { false, 0.0 };
-      }
-
-      const vector3<> arc_origin = arc_origin_;
-
-      const real arc_radius = radius_;
-      
-      segment_data segdata = get_segments_(cfg, high_precision);
-
-      const std::vector<segment> & __restrict segments = segdata.segments_;
-      std::vector<real> radii;
-      radii.reserve(segments.size() + 2);
-      radii.push_back((start_position_ - arc_origin).length());
-
-      for (const segment & __restrict seg : segments)
-      {
-        radii.push_back((seg.start - arc_origin).length());
-      }
-
-      radii.push_back((end_position_ - arc_origin).length());
-
-      real mean_radius = 0.0;
-      for (const real & __restrict radius : radii)
-      {
-        mean_radius += radius / real(radii.size());
-      }
-
-      // TODO this needs to be a config option.
-      static constexpr const real max_radius_diff = 0.001;
-      for (const real & __restrict radius : radii)
-      {
-        if (abs(radius - mean_radius) >= max_radius_diff)
-        {
-          return { false, mean_radius };
-        }
-      }
-
-      return { true, mean_radius };
-    }
-
-    // high_precision forces very small subsegments, for calculation of arcs for arc instruction emission.
-    // Should not be used when subdividing arcs.
-    segment_data get_segments_ (const config & __restrict cfg, bool high_precision = false) const __restrict
-    {
-      // TODO validate segments against a jerk test, and subdivide further if the jerk test fails.
-
-      const vector3<> center_point = mean(start_position_, end_position_);
-      const vector3<> arc_origin = arc_origin_;
-
-      // TODO something here still isn't right, as the radius' we get aren't correct for our angles all the time.
-
-      const real arc_radius = radius_;
-      real arc_constrain = corner_.distance(arc_origin);
-
-      if (angle_ <= 90.0)
-      {
-        const real angle_temp = angle_ / 90.0;
-        arc_constrain = slerp(0.0, arc_radius, angle_temp);
-      }
-      else
-      {
-        const real angle_temp = (angle_ - 90) / 90.0;
-        arc_constrain = lerp(arc_radius, arc_constrain, pow(angle_temp, 3.0));
-      }
-
-      const vector3<> arc_center_point = arc_origin + (corner_ - arc_origin).normalized(arc_constrain);
-
-      std::vector<segment> segments = { { start_position_, end_position_ } };
-
-      const vector3<> start_vector = (corner_ - start_position_).normalized();
-      const vector3<> end_vector = (end_position_ - corner_).normalized();
-
-      const auto get_current_angle = [&]() -> real
-      {
-        // Calculate the max angle of the segments, which may not be equivalent.
-        real largest_angle = 0.0;
-
-        vector3<> cur_vector = (corner_ - start_position_).normalized();
-        for (const segment & __restrict seg : segments)
-        {
-          const vector3<> seg_vector = (seg.end - seg.start).normalized();
-          const real angle = cur_vector.angle_between(seg_vector);
-          largest_angle = max(largest_angle, angle);
-
-          cur_vector = seg_vector;
-        }
-        const vector3<> seg_vector = (end_position_ - corner_).normalized();
-        const real angle = cur_vector.angle_between(seg_vector);
-        largest_angle = max(largest_angle, angle);
-
-        return largest_angle;
-      };
-
-      // For high precision, let's just use 1 degree as the target angle for now. Probably more precise than needed,
-      // might cause slowdowns in the compiler. Can adjust later.
-      static constexpr const real hp_angle = 1.0;
-      const real min_angle = high_precision ? hp_angle : cfg.arc.min_angle;
-
-      std::vector<segment> new_segments;
-      while (angle_ < cfg.arc.max_angle && get_current_angle() >= min_angle && segments.size() < cfg.arc.max_segments)
-      {
-        new_segments.clear();
-        new_segments.reserve(segments.size() * 2);
-
-        bool added_segments = false;
-
-        real current_segment_offset = 0.0;
-
-        usize i = 0;
-        segment prev_segment = { start_position_, corner_ };
-        for (const segment & __restrict seg : segments)
-        {
-          const real test_segment_offset = (segments.size() == 1) ? 1.0 : (current_segment_offset + (seg.linear_offset * 0.5));
-          current_segment_offset += seg.linear_offset;
-          assert(current_segment_offset <= 1.0);
-          assert(test_segment_offset <= 1.0);
-
-          segment next_segment = (i == segments.size() - 1) ?
-            segment{ corner_, end_position_ } :
-            segments[i + 1];
-
-          // Every segment here will get split in twain.
-          vector3<> segment_center = mean(seg.start, seg.end);
-          // We need to renormalize this center position around the arc origin.
-
-          // Get the angle to and from this segment, to see if it needs to be subdivided.
-          const real max_angle = max(
-            prev_segment.angle_between(seg),
-            seg.angle_between(next_segment)
-          );
-
-          const bool valid_angle = max_angle < min_angle;
-
-          if (valid_angle || is_zero(segment_center.distance(arc_origin)))
-          {
-            new_segments.push_back(seg);
-            prev_segment = seg;
-          }
-          else
-          {
-            real radius = arc_radius;
-
-            if (cfg.arc.constrain_radius)
-            {
-              radius = slerp(arc_radius, arc_constrain, test_segment_offset);
-            }
-
-            const vector3<> arc_position = arc_origin + (segment_center - arc_origin).normalized(radius);
-
-            // Generate two segments from this.
-            bool valid_segments = !is_zero(seg.start.distance(arc_position)) && !is_zero(seg.end.distance(arc_position));
-            //valid_segments = valid_segments && (angle_between({ seg.start, arc_position }, { arc_position, seg.end }) >= min_segment_angle);
-
-            if (!valid_segments)
-            {
-              new_segments.push_back(seg);
-              prev_segment = seg;
-            }
-            else
-            {
-              if (segments.size() != 1)
-              {
-                new_segments.push_back({ seg.start, arc_position });
-                new_segments.back().linear_offset = seg.linear_offset * 0.5;
-                new_segments.push_back({ arc_position, seg.end });
-                new_segments.back().linear_offset = seg.linear_offset * 0.5;
-              }
-              else
-              {
-                new_segments.push_back({ seg.start, arc_position });
-                new_segments.back().linear_offset = 1.0;
-                new_segments.push_back({ arc_position, seg.end });
-                new_segments.back().linear_offset = -1.0;
-              }
-              added_segments = true;
-              prev_segment = new_segments.back();
-            }
-          }
-          ++i;
-        }
-
-        if (!added_segments)
-        {
-          break;
-        }
-
-        std::swap(segments, new_segments); // Swapping instead of scoping-out and recreating can help limit allocations a bit.
-      }
-
-      real total_arc_length = 0.0;
-      vector3<> arc_length_elements;
-      const real original_length[2] = {
-        start_position_.distance(corner_),
-        end_position_.distance(corner_)
-      };
-
-      for (const segment & __restrict seg : segments)
-      {
-        total_arc_length += seg.start.distance(seg.end);
-        arc_length_elements += (seg.end - seg.start).abs();
-      }
-
-      // Calculate new feedrate.
-      const real mean_feedrate = mean(seg_feedrate_[0], seg_feedrate_[1]);
-      const real mean_acceleration = mean(acceleration_[0], acceleration_[1]);
-      const vector3<> mean_jerk = mean(jerk_[0], jerk_[1]);
-
-      const vector3<> in_velocity = (corner_ - start_position_).normalized(seg_feedrate_[0]);
-      const vector3<> out_velocity = (end_position_ - corner_).normalized(seg_feedrate_[1]);
-      //const vector3<> velocity_diff = (out_velocity - in_velocity).abs();
-
-      // We need to solve v = at and d = vt for t... and v.
-      // Two Equations:
-      // T = -(sqrt(d) / sqrt(a))  V = -(sqrt(a) * sqrt(d))
-      // T = (sqrt(d) / sqrt(a))  V = (sqrt(a) * sqrt(d))
-      // The one that is positive is correct.
-      const vector3<> element_times = {
-        std::abs(std::sqrt(arc_length_elements.x) / std::sqrt(mean_acceleration)),
-        std::abs(std::sqrt(arc_length_elements.y) / std::sqrt(mean_acceleration)),
-        std::abs(std::sqrt(arc_length_elements.z) / std::sqrt(mean_acceleration))
-      };
-
-      const vector3<> element_velocities = {
-        std::abs(std::sqrt(mean_acceleration) * std::sqrt(arc_length_elements.x)),
-        std::abs(std::sqrt(mean_acceleration) * std::sqrt(arc_length_elements.y)),
-        std::abs(std::sqrt(mean_acceleration) * std::sqrt(arc_length_elements.z))
-      };
-
-      // TODO apply jerk
-      // TODO other calculations need to happen for other segments first.
-
-      // Feedrate is per minute, so result must be multiplied by 60 as the result is per second.
-      const real new_feedrate = min(mean_feedrate, element_velocities.length() * 60.0); // mean_feedrate;//  std::min(mean_feedrate, (total_arc_length / accel_time) * 60);
-
-      const real adusted_extrusions[2] = {
-        extrude_[0] * ((total_arc_length * 0.5) / original_length[0]),
-        extrude_[1] * ((total_arc_length * 0.5) / original_length[1])
-      };
-
-      return {
-        segments,
-        mean_feedrate,
-        total_arc_length,
-        { adusted_extrusions[0], adusted_extrusions[1] },
-        mean_acceleration,
-        mean_jerk,
-        mean(extrude_jerk_[0], extrude_jerk_[1])
-      };
-    }
-
-  public:
-    real get_feedrate_element(usize i) const __restrict
-    {
-      xassert(i < 2);
-      return seg_feedrate_[i];
-    }
-
-    arc(
-      const real(&__restrict extrude)[2],
-      const real(&__restrict feedrate)[2],
-      const real(&__restrict acceleration)[2],
-      const vector3<>(&__restrict jerk)[2],
-      const real(&__restrict extrude_jerk)[2],
-      const vector3<> & __restrict corner,
-      const vector3<> & __restrict start,
-      const vector3<> & __restrict end,
-      real radius,
-      real angle
-    ) : movement(type)
-    {
-      start_position_ = start;
-      end_position_ = end;
-      feedrate_ = (feedrate[0] + feedrate[1]) * 0.5; // TODO adjust this for ovaloid arcs
-
-      extrude_[0] = extrude[0];
-      extrude_[1] = extrude[1];
-      seg_feedrate_[0] = feedrate[0];
-      seg_feedrate_[1] = feedrate[1];
-      acceleration_[0] = acceleration[0];
-      acceleration_[1] = acceleration[1];
-      jerk_[0] = jerk[0];
-      jerk_[1] = jerk[1];
-      extrude_jerk_[0] = extrude_jerk[0];
-      extrude_jerk_[1] = extrude_jerk[1];
-      corner_ = corner;
-      radius_ = radius;
-      angle_ = angle;
-
-      if (seg_feedrate_[0] == 0.0)
-      {
-        seg_feedrate_[0] = seg_feedrate_[1];
-      }
-      if (acceleration_[0] == 0.0)
-      {
-        acceleration_[0] = acceleration_[1];
-      }
-      if (extrude_jerk_[0] == 0.0)
-      {
-        extrude_jerk_[0] = extrude_jerk_[1];
-      }
-      if (jerk_[0].x == 0.0)
-      {
-        jerk_[0].x = jerk_[1].x;
-      }
-      if (jerk_[0].y == 0.0)
-      {
-        jerk_[0].y = jerk_[1].y;
-      }
-      if (jerk_[0].z == 0.0)
-      {
-        jerk_[0].z = jerk_[1].z;
-      }
-
-      acceleration_hint_ = mean(acceleration_[0], acceleration_[1]);
-      jerk_hint_ = mean(jerk_[0], jerk_[1]);
-      jerk_extrude_hint_ = mean(extrude_jerk_[0], extrude_jerk_[1]);
-
-      const vector3<> center_point = mean(start_position_, end_position_);
-      arc_origin_ = corner_ + ((center_point - corner_) * 2.0); // TODO needs to be adjusted for ovaloid arcs.
-    }
-    arc() : movement(type) {}
-    virtual ~arc() {}
-
-    virtual std::string dump() const __restrict override final
-    {
-      std::string out;
-      out += "arc";
-
-      out += movement::dump();
-
-      return out;
-    }
-
-    real get_extrusion() const __restrict
-    {
-      return extrude_[0] + extrude_[1];
-    }
-
-    bool should_subdivide(const config & __restrict cfg) const __restrict
-    {
-      return !std::get<0>(is_simple_arc(cfg, true));
-    }
-
-    std::vector<gcgg::command *> generate_segments(const config & __restrict cfg) const __restrict
-    {
-      std::vector<gcgg::command *> out;
-
-      const segment_data segdata = get_segments_(cfg);
-      const std::vector<segment> & __restrict segments = segdata.segments_;
-
-      const auto adusted_extrusions = segdata.extrusion_;
-
-      out.reserve(segments.size());
-
-      // Segments is now all of the subdivided segments.
-      const real segments_divisor = real(segments.size() + 1);
-      usize iter = 1; // 1 because we want to start in the middle of the interpolation.
-      for (const segment & __restrict seg : segments)
-      {
-        const real interpoland = real(iter++) / segments_divisor;
-
-        const real segment_mult = seg.start.distance(seg.end) / segdata.length_;
-
-        const real feedrate = segdata.feedrate_;
-        real extrusion;
-        if (adusted_extrusions[0] == 0.0 && adusted_extrusions[1] != 0.0)
-        {
-          // travel to extrude
-          if (interpoland >= 0.5)
-          {
-            extrusion = (adusted_extrusions[0] + adusted_extrusions[1]) * segment_mult * 2.0;
-          }
-          else
-          {
-            extrusion = 0.0;
-          }
-        }
-        else if (adusted_extrusions[0] != 0.0 && adusted_extrusions[1] == 0.0)
-        {
-          // extrude to travel
-          if (interpoland <= 0.5)
-          {
-            extrusion = (adusted_extrusions[0] + adusted_extrusions[1]) * segment_mult * 2.0;
-          }
-          else
-          {
-            extrusion = 0.0;
-          }
-        }
-        else
-        {
-          // all else
-          extrusion = (adusted_extrusions[0] + adusted_extrusions[1]) * segment_mult;
-        }
-        const real acceleration = segdata.acceleration_;
-        const real extrude_jerk = segdata.extrude_jerk_;
-        const vector3<> jerk = segdata.jerk_;
-
-        segments::segment * __restrict new_seg;
-
-        if (extrusion != 0.0)
-        {
-          // This is an extrusion move.
-          auto s = new segments::extrusion_move;
-          s->set_positions(seg.start, seg.end);
-          s->acceleration_hint_ = acceleration;
-          s->set_feedrate(feedrate);
-          s->jerk_extrude_hint_ = extrude_jerk;
-          s->jerk_hint_ = jerk;
-          s->set_extrude(extrusion);
-          new_seg = s;
-        }
-        else
-        {
-          auto s = new segments::travel;
-          s->set_positions(seg.start, seg.end);
-          s->acceleration_hint_ = acceleration;
-          s->set_feedrate(feedrate);
-          s->jerk_extrude_hint_ = extrude_jerk;
-          s->jerk_hint_ = jerk;
-          new_seg = s;
-        }
-
-        new_seg->from_arc_ = true;
-
-        out.push_back(new_seg);
-      }
-
-      return out;
-    }
-
-    virtual void out_gcode(std::string & __restrict out, output::state & __restrict state, const config & __restrict cfg) const __restrict override final
-    {
-      const vector3<> center_point = (start_position_ + end_position_) * 0.5;
-      const vector3<> arc_origin = corner_ + ((center_point - corner_) * 2.0); // TODO needs to be adjusted for ovaloid arcs.
-
-      const real arc_radius = radius_;
-      const real arc_constrain = min(arc_radius, center_point.distance(arc_origin));
-
-      const segment_data segdata = get_segments_(cfg);
-      const std::vector<segment> & __restrict segments = segdata.segments_;
-
-      if (cfg.output.generate_G02_G03)
-      {
-        const real radius = std::get<1>(is_simple_arc(cfg, true));
-
-        if (acceleration_hint_ != state.print_accel && acceleration_hint_ != 0)
-        {
-          state.print_accel = acceleration_hint_;
-
-          out += "M204";
-
-          char buffer[512];
-          sprintf(buffer, "%.8f", acceleration_hint_);
-          out += " P";
-          out += trim_float(buffer);
-          out += "\n";
-        }
-
-        bool emit_jerk_hint = false;
-        if (start_position_.x != end_position_.x && jerk_hint_.x != state.jerk.x && jerk_hint_.x != 0)
-        {
-          emit_jerk_hint = true;
-        }
-        if (start_position_.y != end_position_.y && jerk_hint_.y != state.jerk.y && jerk_hint_.y != 0)
-        {
-          emit_jerk_hint = true;
-        }
-        if (start_position_.z != end_position_.z && jerk_hint_.z != state.jerk.z && jerk_hint_.z != 0)
-        {
-          emit_jerk_hint = true;
-        }
-
-        if (emit_jerk_hint)
-        {
-          out += "M205";
-          char buffer[512];
-          if (start_position_.x != end_position_.x && jerk_hint_.x != state.jerk.x && jerk_hint_.x != 0)
-          {
-            state.jerk.x = jerk_hint_.x;
-            sprintf(buffer, "%.8f", jerk_hint_.x);
-            out += " X";
-            out += trim_float(buffer);
-          }
-          if (start_position_.y != end_position_.y && jerk_hint_.y != state.jerk.y && jerk_hint_.y != 0)
-          {
-            state.jerk.y = jerk_hint_.y;
-            sprintf(buffer, "%.8f", jerk_hint_.y);
-            out += " Y";
-            out += trim_float(buffer);
-          }
-          if (start_position_.z != end_position_.z && jerk_hint_.z != state.jerk.z && jerk_hint_.z != 0)
-          {
-            state.jerk.z = jerk_hint_.z;
-            sprintf(buffer, "%.8f", jerk_hint_.z);
-            out += " Z";
-            out += trim_float(buffer);
-          }
-          out += "\n";
-        }
-
-        // Clockwise or counter-clockwise?
-        vector3<> in_direction = state.position - state.prev_position;
-        in_direction.normalize();
-        vector3<> move_direction = end_position_ - state.position;
-        move_direction.normalize();
-        vector3<> move_direction_abs = move_direction.abs();
-
-        // figure out what to cross against.
-        vector3<> left_direction;
-        if (move_direction_abs.x >= move_direction_abs.z && move_direction_abs.y >= move_direction_abs.z)
-        {
-          // XY
-          const vector3<> up = { 0.0, 0.0, 1.0 };
-          left_direction = in_direction.cross(up).normalized();
-        }
-        else if (move_direction_abs.x >= move_direction_abs.y && move_direction_abs.z >= move_direction_abs.y)
-        {
-          // XZ
-          const vector3<> up = { 0.0, 1.0, 0.0 };
-          left_direction = in_direction.cross(up).normalized();
-        }
-        else if (move_direction_abs.y >= move_direction_abs.z && move_direction_abs.y >= move_direction_abs.z)
-        {
-          // YZ
-          const vector3<> up = { 1.0, 0.0, 0.0 };
-          left_direction = in_direction.cross(up).normalized();
-        }
-
-        const real dot_product = move_direction.dot(left_direction);
-
-        std::string cmd;
-
-        if (dot_product <= 0.0)
-        {
-          // Counter
-          out += "G3";
-        }
-        else
-        {
-          // Clock
-          out += "G2";
-        }
-
-        char buffer[512];
-
-        {
-          sprintf(buffer, "%.8f", radius);
-          out += " R";
-          out += trim_float(buffer);
-        }
-        //if (start_position_.x != end_position_.x)
-        {
-          state.prev_position.x = state.position.x;
-          state.position.x = end_position_.x;
-          sprintf(buffer, "%.8f", state.position.x);
-          out += " X";
-          out += trim_float(buffer);
-        }
-        //if (start_position_.y != end_position_.y)
-        {
-          state.prev_position.y = state.position.y;
-          state.position.y = end_position_.y;
-          sprintf(buffer, "%.8f", state.position.y);
-          out += " Y";
-          out += trim_float(buffer);
-        }
-        if (start_position_.z != end_position_.z)
-        {
-          state.prev_position.z = state.position.z;
-          state.position.z = end_position_.z;
-          sprintf(buffer, "%.8f", state.position.z);
-          out += " Z";
-          out += trim_float(buffer);
-        }
-
-        if (feedrate_ != state.feedrate)
-        {
-          state.feedrate = feedrate_;
-
-          sprintf(buffer, "%.8f", feedrate_);
-          out += " F";
-          out += trim_float(buffer);
-        }
-
-        out += "\n";
-      }
-      else if (cfg.output.generate_G15)
-      {
-        // G15 specifies the input feedrate and output feedrate for each axis. The firmware linearly interpolates between these based on time.
-        vector3<> in_feedrate = parent_velocities_[0];
-        vector3<> out_feedrate = parent_velocities_[1];
-
-        real extrusion;
-        {
-          extrusion = extrude_[0] + extrude_[1];
-          // TODO extrude value needs to be adjusted for arc length,
-          // as an arc is shorter than the original length it replaces.
-        }
-
-        // TODO process acceleration and jerk
-
-        out += "G15";
-        char buffer[512];
-
-        if (start_position_.x != end_position_.x)
-        {
-          state.prev_position.x = state.position.x;
-          state.position.x = end_position_.x;
-          sprintf(buffer, "%.8f", state.position.x);
-          out += " X";
-          out += trim_float(buffer);
-        }
-        if (start_position_.y != end_position_.y)
-        {
-          state.prev_position.y = state.position.y;
-          state.position.y = end_position_.y;
-          sprintf(buffer, "%.8f", state.position.y);
-          out += " Y";
-          out += trim_float(buffer);
-        }
-        if (start_position_.z != end_position_.z)
-        {
-          state.prev_position.z = state.position.z;
-          state.position.z = end_position_.z;
-          sprintf(buffer, "%.8f", state.position.z);
-          out += " Z";
-          out += trim_float(buffer);
-        }
-
-        sprintf(buffer, "%.8f", in_feedrate.x);
-        out += " A";
-        out += trim_float(buffer);
-        sprintf(buffer, "%.8f", in_feedrate.y);
-        out += " B";
-        out += trim_float(buffer);
-        sprintf(buffer, "%.8f", in_feedrate.z);
-        out += " C";
-        out += trim_float(buffer);
-
-        sprintf(buffer, "%.8f", out_feedrate.x);
-        out += " D";
-        out += trim_float(buffer);
-        sprintf(buffer, "%.8f", out_feedrate.y);
-        out += " E";
-        out += trim_float(buffer);
-        sprintf(buffer, "%.8f", out_feedrate.z);
-        out += " F";
-        out += trim_float(buffer);
-
-        // TODO need to output a time value. This requires the arc length, which is also required to adjust extrusion.
-
-        return;
-      }
-      else
-      {
-        assert(false); // what exactly are we outputting? TODO add better error system.
-      }
-    }
-
-  private:
-    void out_gcode_segment(
-      std::string & __restrict out,
-      output::state & __restrict state,
-      real feedrate,
-      real extrusion,
-      real acceleration,
-      real extrude_jerk,
-      const vector3<> & __restrict jerk,
-      const vector3<> & __restrict start_position,
-      const vector3<> & __restrict end_position
-    ) const __restrict
-    {
-      if (extrusion == 0.0)
-      {
-        if (acceleration != state.travel_accel && acceleration != 0)
-        {
-          state.travel_accel = acceleration;
-
-          out += "M204";
-
-          char buffer[512];
-          sprintf(buffer, "%.8f", acceleration);
-          out += " T";
-          out += trim_float(buffer);
-          out += "\n";
-        }
-      }
-      else
-      {
-        if (acceleration != state.print_accel && acceleration != 0)
-        {
-          state.print_accel = acceleration;
-
-          out += "M204";
-
-          char buffer[512];
-          sprintf(buffer, "%.8f", acceleration);
-          out += " P";
-          out += trim_float(buffer);
-          out += "\n";
-        }
-      }
-
-      bool emit_jerk_hint = (extrude_jerk != state.extrude_jerk) && extrude_jerk != 0 && extrusion != 0.0;
-      if (start_position.x != end_position.x && jerk.x != state.jerk.x && jerk.x != 0)
-      {
-        emit_jerk_hint = true;
-      }
-      if (start_position.y != end_position.y && jerk.y != state.jerk.y && jerk.y != 0)
-      {
-        emit_jerk_hint = true;
-      }
-      if (start_position.z != end_position.z && jerk.z != state.jerk.z && jerk.z != 0)
-      {
-        emit_jerk_hint = true;
-      }
-
-      if (emit_jerk_hint)
-      {
-        out += "M205";
-        char buffer[512];
-        if (extrude_jerk != state.extrude_jerk && extrude_jerk != 0 && extrusion != 0.0)
-        {
-          state.extrude_jerk = extrude_jerk;
-          sprintf(buffer, "%.8f", extrude_jerk);
-          out += " E";
-          out += trim_float(buffer);
-        }
-        if (jerk != state.jerk)
-        {
-          if (start_position.x != end_position.x && jerk.x != state.jerk.x && jerk.x != 0)
-          {
-            state.jerk.x = jerk.x;
-            sprintf(buffer, "%.8f", jerk.x);
-            out += " X";
-            out += trim_float(buffer);
-          }
-          if (start_position.y != end_position.y && jerk.y != state.jerk.y && jerk.y != 0)
-          {
-            state.jerk.y = jerk.y;
-            sprintf(buffer, "%.8f", jerk.y);
-            out += " Y";
-            out += trim_float(buffer);
-          }
-          if (start_position.z != end_position.z && jerk.z != state.jerk.z && jerk.z != 0)
-          {
-            state.jerk.z = jerk.z;
-            sprintf(buffer, "%.8f", jerk.z);
-            out += " Z";
-            out += trim_float(buffer);
-          }
-        }
-        out += "\n";
-      }
-
-      out += (extrusion == 0.0) ? "G0" : "G1";
-
-      char buffer[512];
-      if (extrusion != 0.0)
-      {
-        sprintf(buffer, "%.8f", extrusion);
-        out += " E";
-        out += trim_float(buffer);
-      }
-
-      if (start_position.x != end_position.x)
-      {
-        state.prev_position.x = state.position.x;
-        state.position.x = end_position.x;
-        sprintf(buffer, "%.8f", state.position.x);
-        out += " X";
-        out += trim_float(buffer);
-      }
-      if (start_position.y != end_position.y)
-      {
-        state.prev_position.y = state.position.y;
-        state.position.y = end_position.y;
-        sprintf(buffer, "%.8f", state.position.y);
-        out += " Y";
-        out += trim_float(buffer);
-      }
-      if (start_position.z != end_position.z)
-      {
-        state.prev_position.z = state.position.z;
-        state.position.z = end_position.z;
-        sprintf(buffer, "%.8f", state.position.z);
-        out += " Z";
-        out += trim_float(buffer);
-      }
-
-      if (feedrate != state.feedrate)
-      {
-        state.feedrate = feedrate;
-
-        sprintf(buffer, "%.8f", feedrate);
-        out += " F";
-        out += trim_float(buffer);
-      }
-
-      out += " ; arc\n";
-    }
-
-    virtual void compute_motion(const config & __restrict cfg, bool require_jerk) __restrict override final
-    {
-    }
-  };
-}
+#pragma once
+
+#include "movement.hpp"
+#include "extrusion_move.hpp"
+#include "travel.hpp"
+#include "platform/arena.hpp"
+#include <algorithm>
+
+namespace gcgg::segments
+{
+  // Linear movement with extrusion
+  class arc final : public movement
+  {
+  public:
+    static constexpr const uint64 type = hash("arc");
+
+  protected:
+    real extrude_[2];
+    real seg_feedrate_[2];
+    real acceleration_[2];
+    vector3<> jerk_[2];
+    real extrude_jerk_[2];
+    vector3<> corner_;
+    real radius_;
+    real angle_;
+    vector3<> arc_origin_;
+    
+  public:
+    vector3<> parent_velocities_[2];
+
+  private:
+    struct segment_data final
+    {
+      usize count_; // Segments, one fewer than the points.
+      real feedrate_;
+      real length_;
+      array<real, 2> extrusion_;
+      real acceleration_;
+      vector3<> jerk_;
+      real extrude_jerk_;
+    };
+
+    // With cfg.arc.constrain_radius, the arc is pulled in towards the corner: its radius eases from radius_ at either end
+    // to this at the middle.
+    real get_constrained_radius() const __restrict
+    {
+      const real corner_radius = corner_.distance(arc_origin_);
+
+      if (angle_ <= 90.0)
+      {
+        const real angle_temp = angle_ / 90.0;
+        return slerp(0.0, radius_, angle_temp);
+      }
+      else
+      {
+        const real angle_temp = (angle_ - 90) / 90.0;
+        return lerp(radius_, corner_radius, pow(angle_temp, 3.0));
+      }
+    }
+
+    // The radius at offset (0 to 1) along the arc.
+    real get_radius(const config & __restrict cfg, real constrained_radius, real offset) const __restrict
+    {
+      if (!cfg.arc.constrain_radius)
+      {
+        return radius_;
+      }
+
+      return slerp(radius_, constrained_radius, 1.0 - abs((offset * 2.0) - 1.0));
+    }
+
+    // Whether the arc lies on one circle about arc_origin_ (which is all that G2/G3 can describe), and that circle's radius.
+    std::tuple<bool, real> is_simple_arc(const config & __restrict cfg) const __restrict
+    {
+      if (!cfg.output.arcs_support_Z && start_position_.z != end_position_.z)
+      {
+        return { false, 0.0 };
+      }
+
+      // TODO this needs to be a config option.
+      static constexpr const real max_radius_diff = 0.001;
+
+      // Only a constrained radius takes the arc off of its circle, and an arc past max_angle is never subdivided at all.
+      const bool simple =
+        !cfg.arc.constrain_radius ||
+        angle_ >= cfg.arc.max_angle ||
+        abs(get_constrained_radius() - radius_) < max_radius_diff;
+
+      return { simple, radius_ };
+    }
+
+    // Subdivides the arc into points from start_position_ to end_position_, evenly spaced in angle about arc_origin_. The
+    // segment count comes straight from the radius: the fewest segments whose chords stay within cfg.arc.max_chord_error
+    // of the arc, and that turn by less than cfg.arc.min_angle from one to the next.
+    segment_data get_segments_(const config & __restrict cfg, std::vector<vector3<>> & __restrict points) const __restrict
+    {
+      // TODO validate segments against a jerk test, and subdivide further if the jerk test fails.
+
+      // The plane of the arc, as the direction to the start and the direction at right angles to it, towards the end.
+      const vector3<> start_offset = start_position_ - arc_origin_;
+      const vector3<> end_offset = end_position_ - arc_origin_;
+      const real start_radius = start_offset.length();
+      const real end_radius = end_offset.length();
+
+      usize count = 1;
+      vector3<> basis_x;
+      vector3<> basis_y;
+      real sweep = 0.0;
+      if (!is_zero(start_radius) && !is_zero(end_radius))
+      {
+        basis_x = start_offset / start_radius;
+        const vector3<> end_across = end_offset - (basis_x * end_offset.dot(basis_x));
+        if (!is_zero(end_across.length()))
+        {
+          basis_y = end_across.normalized();
+          sweep = std::acos(clamp(basis_x.dot(end_offset / end_radius), -1.0, 1.0));
+        }
+      }
+
+      const real constrained_radius = get_constrained_radius();
+      const real max_radius = cfg.arc.constrain_radius ? max(radius_, constrained_radius) : radius_;
+
+      if (angle_ < cfg.arc.max_angle && sweep > 0.0 && max_radius > 0.0)
+      {
+        // A chord spanning an angle a lies r * (1 - cos(a / 2)) inside of the arc.
+        const real chord_error = min(cfg.arc.max_chord_error, max_radius);
+        const real max_step = min(
+          2.0 * std::acos(1.0 - (chord_error / max_radius)),
+          cfg.arc.min_angle * constants<real>::angle_to_rad
+        );
+        if (max_step > 0.0)
+        {
+          count = usize(clamp(std::ceil(sweep / max_step), 1.0, real(max(cfg.arc.max_segments, usize(1)))));
+        }
+      }
+
+      points.clear();
+      points.reserve(count + 1);
+      points.push_back(start_position_);
+      for (usize i = 1; i < count; ++i)
+      {
+        const real offset = real(i) / real(count);
+        const real angle = sweep * offset;
+        const real radius = get_radius(cfg, constrained_radius, offset);
+        points.push_back(arc_origin_ + ((basis_x * std::cos(angle)) + (basis_y * std::sin(angle))) * radius);
+      }
+      points.push_back(end_position_);
+
+      real total_arc_length = 0.0;
+      for (usize i = 1; i < points.size(); ++i)
+      {
+        total_arc_length += points[i - 1].distance(points[i]);
+      }
+
+      const real original_length[2] = {
+        start_position_.distance(corner_),
+        end_position_.distance(corner_)
+      };
+
+      // TODO apply jerk
+      const real mean_feedrate = mean(seg_feedrate_[0], seg_feedrate_[1]);
+      const real mean_acceleration = mean(acceleration_[0], acceleration_[1]);
+      const vector3<> mean_jerk = mean(jerk_[0], jerk_[1]);
+
+      const real adusted_extrusions[2] = {
+        extrude_[0] * ((total_arc_length * 0.5) / original_length[0]),
+        extrude_[1] * ((total_arc_length * 0.5) / original_length[1])
+      };
+
+      return {
+        count,
+        mean_feedrate,
+        total_arc_length,
+        { adusted_extrusions[0], adusted_extrusions[1] },
+        mean_acceleration,
+        mean_jerk,
+        mean(extrude_jerk_[0], extrude_jerk_[1])
+      };
+    }
+
+  public:
+    real get_feedrate_element(usize i) const __restrict
+    {
+      xassert(i < 2);
+      return seg_feedrate_[i];
+    }
+
+    arc(
+      const real(&__restrict extrude)[2],
+      const real(&__restrict feedrate)[2],
+      const real(&__restrict acceleration)[2],
+      const vector3<>(&__restrict jerk)[2],
+      const real(&__restrict extrude_jerk)[2],
+      const vector3<> & __restrict corner,
+      const vector3<> & __restrict start,
+      const vector3<> & __restrict end,
+      real radius,
+      real angle
+    ) : movement(type)
+    {
+      start_position_ = start;
+      end_position_ = end;
+      feedrate_ = (feedrate[0] + feedrate[1]) * 0.5; // TODO adjust this for ovaloid arcs
+
+      extrude_[0] = extrude[0];
+      extrude_[1] = extrude[1];
+      seg_feedrate_[0] = feedrate[0];
+      seg_feedrate_[1] = feedrate[1];
+      acceleration_[0] = acceleration[0];
+      acceleration_[1] = acceleration[1];
+      jerk_[0] = jerk[0];
+      jerk_[1] = jerk[1];
+      extrude_jerk_[0] = extrude_jerk[0];
+      extrude_jerk_[1] = extrude_jerk[1];
+      corner_ = corner;
+      radius_ = radius;
+      angle_ = angle;
+
+      if (seg_feedrate_[0] == 0.0)
+      {
+        seg_feedrate_[0] = seg_feedrate_[1];
+      }
+      if (acceleration_[0] == 0.0)
+      {
+        acceleration_[0] = acceleration_[1];
+      }
+      if (extrude_jerk_[0] == 0.0)
+      {
+        extrude_jerk_[0] = extrude_jerk_[1];
+      }
+      if (jerk_[0].x == 0.0)
+      {
+        jerk_[0].x = jerk_[1].x;
+      }
+      if (jerk_[0].y == 0.0)
+      {
+        jerk_[0].y = jerk_[1].y;
+      }
+      if (jerk_[0].z == 0.0)
+      {
+        jerk_[0].z = jerk_[1].z;
+      }
+
+      acceleration_hint_ = mean(acceleration_[0], acceleration_[1]);
+      jerk_hint_ = mean(jerk_[0], jerk_[1]);
+      jerk_extrude_hint_ = mean(extrude_jerk_[0], extrude_jerk_[1]);
+
+      const vector3<> center_point = mean(start_position_, end_position_);
+      arc_origin_ = corner_ + ((center_point - corner_) * 2.0); // TODO needs to be adjusted for ovaloid arcs.
+    }
+    arc() : movement(type) {}
+    arc(cache::deserializer & __restrict in) : movement(type, in)
+    {
+      for (usize i = 0; i < 2; ++i)
+      {
+        extrude_[i] = in.read<real>();
+        seg_feedrate_[i] = in.read<real>();
+        acceleration_[i] = in.read<real>();
+        jerk_[i] = in.read<vector3<>>();
+        extrude_jerk_[i] = in.read<real>();
+        parent_velocities_[i] = in.read<vector3<>>();
+      }
+      corner_ = in.read<vector3<>>();
+      radius_ = in.read<real>();
+      angle_ = in.read<real>();
+      arc_origin_ = in.read<vector3<>>();
+    }
+    virtual ~arc() {}
+
+    virtual std::string dump() const __restrict override final
+    {
+      std::string out;
+      out += "arc";
+
+      out += movement::dump();
+
+      return out;
+    }
+
+    virtual real get_extrusion() const __restrict override final
+    {
+      return extrude_[0] + extrude_[1];
+    }
+
+    virtual void serialize(cache::serializer & __restrict out) const __restrict override final
+    {
+      movement::serialize(out);
+      for (usize i = 0; i < 2; ++i)
+      {
+        out.write(extrude_[i]);
+        out.write(seg_feedrate_[i]);
+        out.write(acceleration_[i]);
+        out.write(jerk_[i]);
+        out.write(extrude_jerk_[i]);
+        out.write(parent_velocities_[i]);
+      }
+      out.write(corner_);
+      out.write(radius_);
+      out.write(angle_);
+      out.write(arc_origin_);
+    }
+
+    bool should_subdivide(const config & __restrict cfg) const __restrict
+    {
+      return !std::get<0>(is_simple_arc(cfg));
+    }
+
+    // Appends the arc's segments to out. points is scratch space, kept by the caller so that it only gets allocated once.
+    void generate_segments(
+      const config & __restrict cfg,
+      platform::arena & __restrict arena,
+      std::vector<vector3<>> & __restrict points,
+      std::vector<gcgg::command *> & __restrict out
+    ) const __restrict
+    {
+      const segment_data segdata = get_segments_(cfg, points);
+
+      const auto adusted_extrusions = segdata.extrusion_;
+
+      out.reserve(out.size() + segdata.count_);
+
+      // Going from a travel to an extrusion or back, each side's extrusion is fed over its own half of the arc. With an
+      // odd count the middle segment straddles the two halves, and takes the share of the side's extrusion that its part
+      // of the length makes up.
+      const real half_length = segdata.length_ * 0.5;
+      real distance = 0.0; // Along the arc, to the start of the segment.
+      for (usize iter = 1; iter < points.size(); ++iter)
+      {
+        const vector3<> & __restrict seg_start = points[iter - 1];
+        const vector3<> & __restrict seg_end = points[iter];
+
+        const real length = seg_start.distance(seg_end);
+        const usize index = iter - 1;
+        real first_half_length;
+        if ((index + 1) * 2 <= segdata.count_)
+        {
+          first_half_length = length;
+        }
+        else if (index * 2 >= segdata.count_)
+        {
+          first_half_length = 0.0;
+        }
+        else
+        {
+          first_half_length = clamp(half_length - distance, 0.0, length);
+        }
+        distance += length;
+
+        const real feedrate = segdata.feedrate_;
+        real extrusion;
+        if (adusted_extrusions[0] == 0.0 && adusted_extrusions[1] != 0.0)
+        {
+          // travel to extrude
+          extrusion = adusted_extrusions[1] * ((length - first_half_length) / half_length);
+        }
+        else if (adusted_extrusions[0] != 0.0 && adusted_extrusions[1] == 0.0)
+        {
+          // extrude to travel
+          extrusion = adusted_extrusions[0] * (first_half_length / half_length);
+        }
+        else
+        {
+          // all else
+          extrusion = (adusted_extrusions[0] + adusted_extrusions[1]) * (length / segdata.length_);
+        }
+        const real acceleration = segdata.acceleration_;
+        const real extrude_jerk = segdata.extrude_jerk_;
+        const vector3<> jerk = segdata.jerk_;
+
+        segments::segment * __restrict new_seg;
+
+        if (extrusion != 0.0)
+        {
+          // This is an extrusion move.
+          auto s = arena.make<segments::extrusion_move>();
+          s->set_positions(seg_start, seg_end);
+          s->acceleration_hint_ = acceleration;
+          s->set_feedrate(feedrate);
+          s->jerk_extrude_hint_ = extrude_jerk;
+          s->jerk_hint_ = jerk;
+          s->set_extrude(extrusion);
+          new_seg = s;
+        }
+        else
+        {
+          auto s = arena.make<segments::travel>();
+          s->set_positions(seg_start, seg_end);
+          s->acceleration_hint_ = acceleration;
+          s->set_feedrate(feedrate);
+          s->jerk_extrude_hint_ = extrude_jerk;
+          s->jerk_hint_ = jerk;
+          new_seg = s;
+        }
+
+        new_seg->from_arc_ = true;
+
+        out.push_back(new_seg);
+      }
+    }
+
+    virtual void out_gcode(output::emitter & __restrict out, output::state & __restrict state, const config & __restrict cfg) const __restrict override final
+    {
+      if (cfg.output.generate_G02_G03)
+      {
+        const real radius = std::get<1>(is_simple_arc(cfg));
+
+        if (acceleration_hint_ != state.print_accel && acceleration_hint_ != 0)
+        {
+          state.print_accel = acceleration_hint_;
+
+          out += "M204";
+
+          out.word('P', acceleration_hint_, cfg.output.precision.hint);
+          out += "\n";
+        }
+
+        bool emit_jerk_hint = false;
+        if (start_position_.x != end_position_.x && jerk_hint_.x != state.jerk.x && jerk_hint_.x != 0)
+        {
+          emit_jerk_hint = true;
+        }
+        if (start_position_.y != end_position_.y && jerk_hint_.y != state.jerk.y && jerk_hint_.y != 0)
+        {
+          emit_jerk_hint = true;
+        }
+        if (start_position_.z != end_position_.z && jerk_hint_.z != state.jerk.z && jerk_hint_.z != 0)
+        {
+          emit_jerk_hint = true;
+        }
+
+        if (emit_jerk_hint)
+        {
+          out += "M205";
+          if (start_position_.x != end_position_.x && jerk_hint_.x != state.jerk.x && jerk_hint_.x != 0)
+          {
+            state.jerk.x = jerk_hint_.x;
+            out.word('X', jerk_hint_.x, cfg.output.precision.hint);
+          }
+          if (start_position_.y != end_position_.y && jerk_hint_.y != state.jerk.y && jerk_hint_.y != 0)
+          {
+            state.jerk.y = jerk_hint_.y;
+            out.word('Y', jerk_hint_.y, cfg.output.precision.hint);
+          }
+          if (start_position_.z != end_position_.z && jerk_hint_.z != state.jerk.z && jerk_hint_.z != 0)
+          {
+            state.jerk.z = jerk_hint_.z;
+            out.word('Z', jerk_hint_.z, cfg.output.precision.hint);
+          }
+          out += "\n";
+        }
+
+        // Clockwise or counter-clockwise?
+        vector3<> in_direction = state.position - state.prev_position;
+        in_direction.normalize();
+        vector3<> move_direction = end_position_ - state.position;
+        move_direction.normalize();
+        vector3<> move_direction_abs = move_direction.abs();
+
+        // figure out what to cross against.
+        vector3<> left_direction;
+        if (move_direction_abs.x >= move_direction_abs.z && move_direction_abs.y >= move_direction_abs.z)
+        {
+          // XY
+          const vector3<> up = { 0.0, 0.0, 1.0 };
+          left_direction = in_direction.cross(up).normalized();
+        }
+        else if (move_direction_abs.x >= move_direction_abs.y && move_direction_abs.z >= move_direction_abs.y)
+        {
+          // XZ
+          const vector3<> up = { 0.0, 1.0, 0.0 };
+          left_direction = in_direction.cross(up).normalized();
+        }
+        else if (move_direction_abs.y >= move_direction_abs.z && move_direction_abs.y >= move_direction_abs.z)
+        {
+          // YZ
+          const vector3<> up = { 1.0, 0.0, 0.0 };
+          left_direction = in_direction.cross(up).normalized();
+        }
+
+        const real dot_product = move_direction.dot(left_direction);
+
+        std::string cmd;
+
+        if (dot_product <= 0.0)
+        {
+          // Counter
+          out += "G3";
+        }
+        else
+        {
+          // Clock
+          out += "G2";
+        }
+
+        {
+          out.word('R', radius, cfg.output.precision.r);
+        }
+        //if (start_position_.x != end_position_.x)
+        {
+          state.prev_position.x = state.position.x;
+          state.position.x = end_position_.x;
+          out.word('X', state.position.x, cfg.output.precision.x);
+        }
+        //if (start_position_.y != end_position_.y)
+        {
+          state.prev_position.y = state.position.y;
+          state.position.y = end_position_.y;
+          out.word('Y', state.position.y, cfg.output.precision.y);
+        }
+        if (start_position_.z != end_position_.z)
+        {
+          state.prev_position.z = state.position.z;
+          state.position.z = end_position_.z;
+          out.word('Z', state.position.z, cfg.output.precision.z);
+        }
+
+        if (feedrate_ != state.feedrate)
+        {
+          state.feedrate = feedrate_;
+
+          out.word('F', feedrate_, cfg.output.precision.f);
+        }
+
+        out += "\n";
+      }
+      else if (cfg.output.generate_G15)
+      {
+        // G15 specifies the input feedrate and output feedrate for each axis. The firmware linearly interpolates between these based on time.
+        vector3<> in_feedrate = parent_velocities_[0];
+        vector3<> out_feedrate = parent_velocities_[1];
+
+        real extrusion;
+        {
+          extrusion = extrude_[0] + extrude_[1];
+          // TODO extrude value needs to be adjusted for arc length,
+          // as an arc is shorter than the original length it replaces.
+        }
+
+        // TODO process acceleration and jerk
+
+        out += "G15";
+        if (start_position_.x != end_position_.x)
+        {
+          state.prev_position.x = state.position.x;
+          state.position.x = end_position_.x;
+          out.word('X', state.position.x, cfg.output.precision.x);
+        }
+        if (start_position_.y != end_position_.y)
+        {
+          state.prev_position.y = state.position.y;
+          state.position.y = end_position_.y;
+          out.word('Y', state.position.y, cfg.output.precision.y);
+        }
+        if (start_position_.z != end_position_.z)
+        {
+          state.prev_position.z = state.position.z;
+          state.position.z = end_position_.z;
+          out.word('Z', state.position.z, cfg.output.precision.z);
+        }
+
+        out.word('A', in_feedrate.x, cfg.output.precision.f);
+        out.word('B', in_feedrate.y, cfg.output.precision.f);
+        out.word('C', in_feedrate.z, cfg.output.precision.f);
+
+        out.word('D', out_feedrate.x, cfg.output.precision.f);
+        out.word('E', out_feedrate.y, cfg.output.precision.f);
+        out.word('F', out_feedrate.z, cfg.output.precision.f);
+
+        // TODO need to output a time value. This requires the arc length, which is also required to adjust extrusion.
+
+        return;
+      }
+      else
+      {
+        assert(false); // what exactly are we outputting? TODO add better error system.
+      }
+    }
+
+    virtual void out_gg(output::emitter & __restrict out, output::state & __restrict state, const config & __restrict cfg) const __restrict override final
+    {
+      if (is_travel_)
+      {
+        output::gg::write_acceleration(out, state.travel_accel, output::gg::opcode::travel_acceleration, acceleration_hint_);
+      }
+      else
+      {
+        output::gg::write_acceleration(out, state.print_accel, output::gg::opcode::print_acceleration, acceleration_hint_);
+      }
+
+      // The arc turns the same way as the corner it replaces.
+      const vector3<> turn = (corner_ - start_position_).cross(end_position_ - corner_);
+
+      output::gg::write_arc(
+        out, state,
+        start_position_, end_position_, arc_origin_,
+        turn.z < 0.0,
+        get_extrusion(),
+        motion_data_.entry_feedrate_, motion_data_.plateau_feedrate_, motion_data_.exit_feedrate_
+      );
+    }
+
+  private:
+    void out_gcode_segment(
+      output::emitter & __restrict out,
+      output::state & __restrict state,
+      const config & __restrict cfg,
+      real feedrate,
+      real extrusion,
+      real acceleration,
+      real extrude_jerk,
+      const vector3<> & __restrict jerk,
+      const vector3<> & __restrict start_position,
+      const vector3<> & __restrict end_position
+    ) const __restrict
+    {
+      if (extrusion == 0.0)
+      {
+        if (acceleration != state.travel_accel && acceleration != 0)
+        {
+          state.travel_accel = acceleration;
+
+          out += "M204";
+
+          out.word('T', acceleration, cfg.output.precision.hint);
+          out += "\n";
+        }
+      }
+      else
+      {
+        if (acceleration != state.print_accel && acceleration != 0)
+        {
+          state.print_accel = acceleration;
+
+          out += "M204";
+
+          out.word('P', acceleration, cfg.output.precision.hint);
+          out += "\n";
+        }
+      }
+
+      bool emit_jerk_hint = (extrude_jerk != state.extrude_jerk) && extrude_jerk != 0 && extrusion != 0.0;
+      if (start_position.x != end_position.x && jerk.x != state.jerk.x && jerk.x != 0)
+      {
+        emit_jerk_hint = true;
+      }
+      if (start_position.y != end_position.y && jerk.y != state.jerk.y && jerk.y != 0)
+      {
+        emit_jerk_hint = true;
+      }
+      if (start_position.z != end_position.z && jerk.z != state.jerk.z && jerk.z != 0)
+      {
+        emit_jerk_hint = true;
+      }
+
+      if (emit_jerk_hint)
+      {
+        out += "M205";
+        if (extrude_jerk != state.extrude_jerk && extrude_jerk != 0 && extrusion != 0.0)
+        {
+          state.extrude_jerk = extrude_jerk;
+          out.word('E', extrude_jerk, cfg.output.precision.hint);
+        }
+        if (jerk != state.jerk)
+        {
+          if (start_position.x != end_position.x && jerk.x != state.jerk.x && jerk.x != 0)
+          {
+            state.jerk.x = jerk.x;
+            out.word('X', jerk.x, cfg.output.precision.hint);
+          }
+          if (start_position.y != end_position.y && jerk.y != state.jerk.y && jerk.y != 0)
+          {
+            state.jerk.y = jerk.y;
+            out.word('Y', jerk.y, cfg.output.precision.hint);
+          }
+          if (start_position.z != end_position.z && jerk.z != state.jerk.z && jerk.z != 0)
+          {
+            state.jerk.z = jerk.z;
+            out.word('Z', jerk.z, cfg.output.precision.hint);
+          }
+        }
+        out += "\n";
+      }
+
+      out += (extrusion == 0.0) ? "G0" : "G1";
+
+      if (extrusion != 0.0)
+      {
+        out.word('E', extrusion, cfg.output.precision.e);
+      }
+
+      if (start_position.x != end_position.x)
+      {
+        state.prev_position.x = state.position.x;
+        state.position.x = end_position.x;
+        out.word('X', state.position.x, cfg.output.precision.x);
+      }
+      if (start_position.y != end_position.y)
+      {
+        state.prev_position.y = state.position.y;
+        state.position.y = end_position.y;
+        out.word('Y', state.position.y, cfg.output.precision.y);
+      }
+      if (start_position.z != end_position.z)
+      {
+        state.prev_position.z = state.position.z;
+        state.position.z = end_position.z;
+        out.word('Z', state.position.z, cfg.output.precision.z);
+      }
+
+      if (feedrate != state.feedrate)
+      {
+        state.feedrate = feedrate;
+
+        out.word('F', feedrate, cfg.output.precision.f);
+      }
+
+      out += " ; arc\n";
+    }
+
+    virtual void compute_motion(const config & __restrict cfg) __restrict override final
+    {
+      // The arc replaces the corner, so it joins each side at that side's own feedrate.
+      motion_data_.calculated_ = true;
+      motion_data_.entry_feedrate_ = seg_feedrate_[0];
+      motion_data_.plateau_feedrate_ = feedrate_;
+      motion_data_.exit_feedrate_ = seg_feedrate_[1];
+    }
+  };
+}
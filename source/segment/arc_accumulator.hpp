@@ -1,798 +1,778 @@
-#pragma once
-
-#include "movement.hpp"
-
-namespace gcgg::segments
-{
-  // Linear movement without extrusion
-  class arc_accumulator final : public movement
-  {
-    // As described elsewhere, iif the vertices of the segments lie on the sphere, we need two segments to define an arc.
-    // If they do _not_ (and thus the vertices alternate between being in and out of the sphere), we need four.
-    static constexpr const bool intersecting_vertices = true;
-    static constexpr const size_t min_segment_count = intersecting_vertices ? 4 : 2;
-
-    struct chord final
-    {
-      const movement * __restrict segments[2] = { nullptr, nullptr };
-
-      vector3<> get_vector() const __restrict
-      {
-        return segments[1]->get_mean_position() - segments[0]->get_mean_position();
-      }
-
-      vector3<> get_mean_position() const __restrict
-      {
-        return mean(segments[0]->get_mean_position(), segments[1]->get_mean_position());
-      }
-
-      void clear() __restrict
-      {
-        segments[0] = nullptr;
-        segments[1] = nullptr;
-      }
-
-      operator bool() const __restrict
-      {
-        return segments[0] != nullptr && segments[1] != nullptr;
-      }
-
-      void insert(const movement * __restrict segment) __restrict
-      {
-        if (!segments[0])
-        {
-          segments[0] = segment;
-          return;
-        }
-        segments[1] = segment;
-      }
-
-      void shuffle() __restrict
-      {
-        segments[0] = segments[1];
-        segments[1] = nullptr;
-      }
-    };
-
-    struct direction final
-    {
-      enum class plane
-      {
-        xy = 0,
-        xz,
-        yz,
-      } plane_;
-      bool handedness_;
-      vector3<> left_vector;
-
-      direction() = default;
-
-      direction(const chord & __restrict chord1, const chord & __restrict chord2)
-      {
-        vector3<> in_direction = chord1.get_vector().normalized();
-        vector3<> move_direction = chord2.get_vector().normalized();
-        vector3<> move_direction_abs = move_direction.abs();
-
-        if (move_direction_abs.x >= move_direction_abs.z && move_direction_abs.y >= move_direction_abs.z)
-        {
-          // XY
-          plane_ = plane::xy;
-          const vector3<> up = { 0.0, 0.0, 1.0 };
-          left_vector = in_direction.cross(up).normalized();
-        }
-        else if (move_direction_abs.x >= move_direction_abs.y && move_direction_abs.z >= move_direction_abs.y)
-        {
-          // XZ
-          plane_ = plane::xz;
-          const vector3<> up = { 0.0, 1.0, 0.0 };
-          left_vector = in_direction.cross(up).normalized();
-        }
-        else if (move_direction_abs.y >= move_direction_abs.z && move_direction_abs.y >= move_direction_abs.z)
-        {
-          // YZ
-          plane_ = plane::yz;
-          const vector3<> up = { 1.0, 0.0, 0.0 };
-          left_vector = in_direction.cross(up).normalized();
-        }
-        else
-        {
-          exit(1);
-        }
-
-        const real dot_product = move_direction.dot(left_vector);
-
-        handedness_ = (dot_product <= 0.0);
-      }
-
-      bool operator == (const direction & __restrict dir) const __restrict
-      {
-        return plane_ == dir.plane_ && handedness_ == dir.handedness_;
-      }
-
-      bool operator != (const direction & __restrict dir) const __restrict
-      {
-        return plane_ != dir.plane_ || handedness_ != dir.handedness_;
-      }
-    };
-
-    std::vector<movement *> m_Segments;
-    real                   m_AccumAngle = 0.0;
-    real                   m_MeanAngle = 0.0;
-    direction              m_Direction;
-
-  public:
-    static constexpr const uint64 type = hash("arc_accumulator");
-
-  protected:
-  public:
-    arc_accumulator() : movement(type) {}
-    arc_accumulator(arc_accumulator && __restrict accum) :
-      movement(type),
-      m_Segments(std::move(accum.m_Segments)),
-      m_AccumAngle(accum.m_AccumAngle),
-      m_Direction(accum.m_Direction),
-      m_MeanAngle(accum.m_MeanAngle)
-    {}
-
-    virtual ~arc_accumulator()
-    {
-      // Any segments in the accumulator have had ownership taken by the accumulator.
-      for (segment * __restrict seg : m_Segments)
-      {
-        delete seg;
-      }
-    }
-
-    arc_accumulator & operator = (arc_accumulator && __restrict accum) __restrict
-    {
-      m_Segments = std::move(accum.m_Segments);
-      m_AccumAngle = accum.m_AccumAngle;
-      m_Direction = accum.m_Direction;
-      m_MeanAngle = accum.m_MeanAngle;
-
-      return *this;
-    }
-
-    virtual std::string dump() const __restrict override final
-    {
-      std::string out;
-      out += "arc_accumulator";
-
-      out += movement::dump();
-
-      return out;
-    }
-
-    const auto & get_segments() const __restrict
-    {
-      return m_Segments;
-    }
-
-    size_t get_segment_count() const __restrict
-    {
-      return m_Segments.size();
-    }
-
-    void reset() __restrict
-    {
-      m_Segments.clear();
-      m_AccumAngle = 0.0;
-      m_MeanAngle = 0.0;
-    }
-
-    bool conditional_reset() __restrict
-    {
-      if (m_Segments.size() < min_segment_count)
-      {
-        reset();
-        return true;
-      }
-      return false;
-    }
-
-    bool consume_segment(movement & __restrict seg, const config & __restrict cfg) __restrict
-    {
-      // TODO needs more validation, mainly about acceleration, jerk, extrude _rate_ (extrusion amount over distance)...
-
-      const bool result = [&]() {
-        // Working on presently:
-        // At four segments, we can calculate the direction and such. We want to avoid some calculations until then
-        // as two segments represents a chord, not one.
-
-        if (seg.get_vector().length() >= cfg.reg_arc_gen.max_segment_length)
-        {
-          return false;
-        }
-
-        if (!cfg.output.arcs_support_Z && seg.get_vector().z != 0.0)
-        {
-          return false;
-        }
-
-        if (m_Segments.size() == 0)
-        {
-          m_Segments.push_back(&seg);
-          return true;
-        }
-
-        const segment * __restrict back_seg = m_Segments.back();
-        if (back_seg->get_type() != seg.get_type())
-        {
-          // Only accept the same type, ever.
-          return false;
-        }
-
-        vector3<> cur_vec = seg.get_vector().normalized();
-        real angle;
-        // If we have more than two points, we should calculate the test angle by chord rather than by segment. Two segments = one chord (segment.center -> segment.center).
-        if (m_Segments.size() >= 2)
-        {
-          const movement * __restrict chord_segments[2] = {
-            m_Segments[m_Segments.size() - 2],
-            m_Segments[m_Segments.size() - 1]
-          };
-          const vector3<> chord_points[2] = {
-            chord_segments[0]->get_mean_position(),
-            chord_segments[1]->get_mean_position()
-          };
-          const vector3<> back_vec = chord_points[0].vector_to(chord_points[1]);
-          angle = back_vec.angle_between(cur_vec);
-        }
-        else
-        {
-          const vector3<> back_vec = back_seg->get_vector().normalized();
-          angle = back_vec.angle_between(cur_vec);
-        }
-        if (angle >= cfg.reg_arc_gen.max_angle)
-        {
-          return false;
-        }
-
-        // We shoudl scale this based upon segment size. Tiny segments will have much larger angles.
-        if (m_Segments.size() >= min_segment_count)
-        {
-          // Is the angle within allowable limits?
-          const real angle_diff = abs(m_MeanAngle - angle);
-          if (angle_diff >= cfg.reg_arc_gen.max_angle_divergence)
-          {
-            return false;
-          }
-        }
-
-        //static constexpr const real max_accumulated_angle = 360.0; // one circle
-        //if ((angle + m_AccumAngle) >= max_accumulated_angle) // 360.0 - must be < 180, due to weirdness in how we calculate the radius. TODO
-        //{
-        //  return false;
-        //}
-
-        // TODO perform a Z test to see if we are increasing on Z at a consistent rate.
-
-        if (m_Segments.size() >= min_segment_count)
-        {
-          // calculate the canonical direction value.
-          // TODO recalculate potentially using segment pairs. Cannot necessarily use one segment to determine this.
-          const chord chords[2] = {
-            { m_Segments[m_Segments.size() - (1 + 2)], m_Segments[m_Segments.size() - (1 + 1)] },
-            { m_Segments[m_Segments.size() - (1 + 0)], &seg }
-          };
-          const direction seg_direction = direction{ chords[0], chords[1] };
-
-          if (m_Segments.size() == min_segment_count)
-          {
-            m_Direction = direction{ chords[0], chords[1] };
-          }
-          else
-          {
-            if (m_Direction != seg_direction)
-            {
-              return false;
-            }
-          }
-        }
-
-        m_Segments.push_back(&seg);
-
-        size_t divisor = 0;
-        if (m_Segments.size() >= min_segment_count)
-        {
-          // Calculate the accumulated angle.
-          // Unlike for the mean angle, here we don't blend the chords.
-          chord chords[2];
-
-          m_AccumAngle = 0.0;
-          for (const movement * __restrict cur_seg : m_Segments)
-          {
-            if (!chords[0])
-            {
-              chords[0].insert(cur_seg);
-            }
-            else
-            {
-              chords[1].insert(cur_seg);
-            }
-
-            if (chords[0] && chords[1])
-            {
-              const vector3<> chord_vectors[2] = {
-                chords[0].get_vector().normalized(),
-                chords[1].get_vector().normalized()
-              };
-
-              const real cur_angle = chord_vectors[0].angle_between(chord_vectors[1]);
-              m_AccumAngle += cur_angle;
-
-              chords[0].clear();
-              chords[1].clear();
-            }
-          }
-
-          chords[0].clear();
-          chords[1].clear();
-
-          // Recalculate the mean angle.
-          real mean_angle = 0.0;
-          for (const movement * __restrict cur_seg : m_Segments)
-          {
-            if (!chords[0])
-            {
-              chords[0].insert(cur_seg);
-            }
-            else
-            {
-              chords[1].insert(cur_seg);
-            }
-
-            if (chords[0] && chords[1])
-            {
-              // get_vector cur_chord
-
-              const vector3<> chord_vectors[2] = {
-                chords[0].get_vector().normalized(),
-                chords[1].get_vector().normalized()
-              };
-
-              const real cur_angle = chord_vectors[0].angle_between(chord_vectors[1]);
-              mean_angle += cur_angle;
-
-              chords[0] = chords[1];
-              chords[1].clear();
-              ++divisor;
-            }
-          }
-          m_MeanAngle = mean_angle / real(divisor);
-        }
-
-        return true;
-      }();
-
-      if (result == false)
-      {
-        // flush the accumulator.
-        conditional_reset();
-      }
-
-      return result;
-    }
-
-    private:
-
-    std::tuple<real, vector3<>> solve (const config & __restrict cfg) const __restrict
-    {
-      real radius = 0.0;
-      vector3<> origin = { 0,0,0 };
-
-      // Resolve the segments into on-circle subsegments.
-      // We still need to resolve the start and end vertices.
-
-      struct subsegment final
-      {
-        const movement * __restrict segment;
-        vector3<> start_;
-        vector3<> end_;
-        real weight = 1.0;
-
-        real get_length() const __restrict
-        {
-          return start_.distance(end_);
-        }
-
-        vector3<> get_vector() const __restrict
-        {
-          return end_ - start_;
-        }
-      };
-
-      std::vector<subsegment> subsegments;
-      real accumulated_length = 0.0;
-      real weight_accum = 1.0;
-
-      for (const auto *this_segment : m_Segments)
-      {
-        const vector3<> vector_along = this_segment->get_end_position() - this_segment->get_start_position();
-        const real magnitude_along = vector_along.length();
-
-        const vector3<> start = subsegments.size() ? subsegments.back().end_ : this_segment->get_start_position();
-        const vector3<> vec1 = this_segment->get_start_position() + vector_along.normalized(magnitude_along * 0.25);
-        const vector3<> vec2 = this_segment->get_start_position() + vector_along.normalized(magnitude_along * 0.75);
-
-        subsegments.emplace_back(subsegment{ this_segment, start, vec1 });
-        accumulated_length += subsegments.back().get_length();
-        subsegments.emplace_back(subsegment{ this_segment, vec1, vec2 });
-        accumulated_length += subsegments.back().get_length();
-      }
-      subsegments.emplace_back(subsegment{ m_Segments.back(), subsegments.back().end_, m_Segments.back()->get_end_position() });
-      accumulated_length += subsegments.back().get_length();
-
-      const real mean_length = accumulated_length / subsegments.size();
-
-      // add weights
-      for (subsegment & seg : subsegments)
-      {
-        const real length = seg.get_length();
-        seg.weight = length / mean_length;
-      }
-
-      // Calculate origin.
-      const subsegment *prev_subseg = nullptr;
-      for (size_t i = 1; i < subsegments.size() - 1; ++i)
-      {
-        const auto &subseg = subsegments[i];
-
-        if (!prev_subseg)
-        {
-          prev_subseg = &subseg;
-          continue;
-        }
-
-        vector3<> vectors[2] = {
-          prev_subseg->get_vector().normalized(),
-          subseg.get_vector().normalized()
-        };
-      
-        const auto plane = m_Direction.plane_;
-        vector3<> up;
-        switch (plane)
-        {
-        case direction::plane::xy:
-          up = { 0.0, 0.0, 1.0 }; break;
-        case direction::plane::xz:
-          up = { 0.0, 1.0, 0.0 }; break;
-        case direction::plane::yz:
-          up = { 1.0, 0.0, 0.0 }; break;
-        }
-
-        const vector3<> points[2] = {
-          mean(prev_subseg->start_, prev_subseg->end_),
-          mean(subseg.start_, subseg.end_)
-        };
-
-        const vector3<> cross_vectors[2] = {
-          vectors[0].cross(up).normalized(),
-          vectors[1].cross(up).normalized(),
-        };
-
-        const vector3<> cross_a = (points[1] - points[0]).cross(cross_vectors[1]);
-
-        const vector3<> cross_b = cross_vectors[0].cross(cross_vectors[1]);
-        if (cross_b.length() == 0.0)
-        {
-          exit(1);
-        }
-
-        const real a = cross_a.length() / cross_b.length();
-
-        vector3<> origin_vector = (a * cross_vectors[0]);
-        if (origin_vector.normalized().dot(vectors[1]) < 0.0)
-        {
-          origin_vector = -origin_vector;
-        }
-        const vector3<> _orig = points[0] + origin_vector;
-
-        origin += _orig;// *prev_subseg->weight;
-        weight_accum *= prev_subseg->weight;
-
-        prev_subseg = &subseg;
-      }
-
-
-
-      origin /= real(subsegments.size() - 2);
-
-      for (size_t i = 1; i < subsegments.size() - 1; ++i)
-      {
-        const auto &subseg = subsegments[i];
-        radius += origin.distance(subseg.start_) * subseg.weight;
-        radius += origin.distance(subseg.end_) * subseg.weight;
-      }
-
-      radius /= real((subsegments.size() - 2) * 2);
-
-      radius = std::max(radius, (m_Segments.front()->get_start_position().distance(m_Segments.back()->get_end_position())) / 2.0);
-
-      return {radius, origin};
-    }
-
-    public:
-
-    virtual void out_gcode(std::string & __restrict out, output::state & __restrict state, const config & __restrict cfg) const __restrict
-    {
-      real mean_radius;
-      vector3<> origin;
-      std::tie(mean_radius, origin) = solve(cfg);
-
-      vector3<> start_position_ = m_Segments.front()->get_start_position();
-      vector3<> end_position_ = m_Segments.back()->get_end_position();
-
-      if (acceleration_hint_ != state.print_accel && acceleration_hint_ != 0)
-      {
-        state.print_accel = acceleration_hint_;
-
-        out += "M204";
-
-        char buffer[512];
-        sprintf(buffer, "%.8f", acceleration_hint_);
-        out += " P";
-        out += trim_float(buffer);
-        out += "\n";
-      }
-
-      bool emit_jerk_hint = false;
-      if (start_position_.x != end_position_.x && jerk_hint_.x != state.jerk.x && jerk_hint_.x != 0)
-      {
-        emit_jerk_hint = true;
-      }
-      if (start_position_.y != end_position_.y && jerk_hint_.y != state.jerk.y && jerk_hint_.y != 0)
-      {
-        emit_jerk_hint = true;
-      }
-      if (start_position_.z != end_position_.z && jerk_hint_.z != state.jerk.z && jerk_hint_.z != 0)
-      {
-        emit_jerk_hint = true;
-      }
-
-      if (emit_jerk_hint)
-      {
-        out += "M205";
-        char buffer[512];
-        if (start_position_.x != end_position_.x && jerk_hint_.x != state.jerk.x && jerk_hint_.x != 0)
-        {
-          state.jerk.x = jerk_hint_.x;
-          sprintf(buffer, "%.8f", jerk_hint_.x);
-          out += " X";
-          out += trim_float(buffer);
-        }
-        if (start_position_.y != end_position_.y && jerk_hint_.y != state.jerk.y && jerk_hint_.y != 0)
-        {
-          state.jerk.y = jerk_hint_.y;
-          sprintf(buffer, "%.8f", jerk_hint_.y);
-          out += " Y";
-          out += trim_float(buffer);
-        }
-        if (start_position_.z != end_position_.z && jerk_hint_.z != state.jerk.z && jerk_hint_.z != 0)
-        {
-          state.jerk.z = jerk_hint_.z;
-          sprintf(buffer, "%.8f", jerk_hint_.z);
-          out += " Z";
-          out += trim_float(buffer);
-        }
-        out += "\n";
-      }
-
-      std::string cmd;
-
-      bool debug = false;
-
-      if (is_equal(mean_radius, 47.5209018, 0.000001))
-      {
-        debug = true;
-        out += "##############DEBUG###############\n";
-      }
-
-      if (m_Direction.handedness_)
-      {
-        // Counter
-        out += "G3";
-      }
-      else
-      {
-        // Clock
-        out += "G2";
-      }
-
-      char buffer[512];
-
-      // Determine if we have more than half of a circle.
-      bool more_than_half_circle = false;
-      if (m_Segments.size() >= 3)
-      {
-        //const vector3<> start_position = (m_Segments.front()->get_start_position() - origin).normalized();
-        //const vector3<> end_position = (m_Segments.back()->get_end_position() - origin).normalized();
-        //real angle1 = atan2(start_position.y, start_position.x);
-        //real angle2 = atan2(start_position.y, start_position.x);
-        //angle2 = angle2;
-
-        //const vector3<> first_vector = m_Segments.front()->get_start_position().vector_to(origin);
-        //const vector3<> second_vector = m_Segments[1]->get_start_position().vector_to(origin);
-        //const vector3<> last_vector = m_Segments.back()->get_start_position().vector_to(origin);
-
-        const vector3<> first_normal = m_Segments.front()->get_start_position().vector_to(origin);
-        const vector3<> second_normal = m_Segments[1]->get_start_position().vector_to(origin);
-        const vector3<> last_normal = m_Segments.back()->get_end_position().vector_to(origin);
-
-        const auto plane = m_Direction.plane_;
-        vector3<> up;
-        switch (plane)
-        {
-        case direction::plane::xy:
-          up = { 0.0, 0.0, 1.0 }; break;
-        case direction::plane::xz:
-          up = { 0.0, 1.0, 0.0 }; break;
-        case direction::plane::yz:
-          up = { 1.0, 0.0, 0.0 }; break;
-        }
-
-        static constexpr const bool use_90 = false; // otherwise uses 180.
-        static constexpr const bool use_135 = false;
-        if constexpr (use_90)
-        {
-          if (last_normal.dot(first_normal) <= 0.0)
-          {
-            more_than_half_circle = true;
-          }
-        }
-        if constexpr (use_135)
-        {
-          vector3<> binormal = first_normal.cross(up).normalized();
-          if (binormal.dot(second_normal) < 0.0)
-          {
-            binormal = -binormal;
-          }
-
-          binormal = mean(binormal + first_normal).normalized();
-
-          if (last_normal.dot(binormal) <= 0.0)
-          {
-            more_than_half_circle = true;
-          }
-        }
-        else
-        {
-          vector3<> binormal = first_normal.cross(up).normalized();
-          if (binormal.dot(second_normal) <= 0.0)
-          {
-            binormal = -binormal;
-          }
-
-          //printf("start: %f\n", (atan2(first_normal.y, first_normal.x) + constants<real>::pi) * constants<real>::rad_to_angle);
-          //printf("second: %f\n", (atan2(second_normal.y, second_normal.x) + constants<real>::pi) * constants<real>::rad_to_angle);
-          //printf("binormal: %f\n", (atan2(binormal.y, binormal.x) + constants<real>::pi) * constants<real>::rad_to_angle);
-          //printf("last: %f\n", (atan2(last_normal.y, last_normal.x) + constants<real>::pi) * constants<real>::rad_to_angle);
-
-          if (last_normal.dot(binormal) < 0.0)
-          {
-            more_than_half_circle = true;
-          }
-          //if (debug)
-          //  more_than_half_circle = !more_than_half_circle;
-        }
-
-        //more_than_half_circle = false;
-
-        // the above isn't really right. It _should_ work, but for some reason it does not.
-        //more_than_half_circle = false;
-
-        // We should calculate the center point of the arc for both cases (wide and narrow arc).
-        // We then should choose the one that has the closest radius to the expectation.
-
-        // We have a radius and two points. From that, we can generate two points that are R apart from our two vertices.
-        // These represent the centers of two circles. We want the one closest to our origin.
-        // The one that makes the largest arc is the one representing -R, the other is R.
-        // We can determine that using dot products or some other magical-ness. Either-or.
-#if 0
-
-        vector3<> first_tangent = first_normal.cross(up).normalized();
-        vector3<> last_tangent = last_normal.cross(up).normalized();
-
-        chord last_end_chord;
-        chord chords[2];
-
-        real accumulated_angle = 0.0;
-        for (const movement * __restrict cur_seg : m_Segments)
-        {
-          if (!chords[0])
-          {
-            chords[0].insert(cur_seg);
-          }
-          else
-          {
-            chords[1].insert(cur_seg);
-          }
-
-          if (chords[0] && chords[1])
-          {
-            const vector3<> chord_vectors[2] = {
-              chords[0].get_vector().normalized(),
-              chords[1].get_vector().normalized()
-            };
-
-            if (accumulated_angle == 0.0)
-            {
-              // If this is the first angle, we should add in the tangent angle as well.
-              if (first_tangent.dot(chord_vectors[0]) <= 0.0)
-              {
-                first_tangent = -first_tangent;
-              }
-              const real cur_angle = first_tangent.angle_between(chord_vectors[0]);
-              accumulated_angle += cur_angle;
-            }
-
-            const real cur_angle = chord_vectors[0].angle_between(chord_vectors[1]);
-            accumulated_angle += cur_angle;
-
-            chords[0].clear();
-            last_end_chord = chords[1];
-            chords[1].clear();
-          }
-        }
-
-        // Do we add the last tangents angle diff?
-        if (last_end_chord)
-        {
-          if (last_tangent.dot(last_end_chord.get_vector()) <= 0.0)
-          {
-            last_tangent = -last_tangent;
-          }
-          const real cur_angle = last_end_chord.get_vector().normalized().angle_between(last_tangent);
-          accumulated_angle += cur_angle;
-        }
-
-        if (accumulated_angle >= 180.0)
-        {
-          more_than_half_circle = true;
-        }
-#endif
-      }
-
-      {
-        sprintf(buffer, "%.8f", (more_than_half_circle) ? -mean_radius : mean_radius);
-        out += " R";
-        out += trim_float(buffer);
-      }
-      //if (start_position_.x != end_position_.x)
-      {
-        state.prev_position.x = state.position.x;
-        state.position.x = end_position_.x;
-        sprintf(buffer, "%.8f", state.position.x);
-        out += " X";
-        out += trim_float(buffer);
-      }
-      //if (start_position_.y != end_position_.y)
-      {
-        state.prev_position.y = state.position.y;
-        state.position.y = end_position_.y;
-        sprintf(buffer, "%.8f", state.position.y);
-        out += " Y";
-        out += trim_float(buffer);
-      }
-      if (start_position_.z != end_position_.z)
-      {
-        state.prev_position.z = state.position.z;
-        state.position.z = end_position_.z;
-        sprintf(buffer, "%.8f", state.position.z);
-        out += " Z";
-        out += trim_float(buffer);
-      }
-
-      if (feedrate_ != state.feedrate)
-      {
-        state.feedrate = feedrate_;
-
-        sprintf(buffer, "%.8f", feedrate_);
-        out += " F";
-        out += trim_float(buffer);
-      }
-
-      out += "\n";
-    }
-  };
-}
+#pragma once
+
+#include "movement.hpp"
+#include "travel.hpp"
+#include "stats/stats.hpp"
+
+namespace gcgg::segments
+{
+  // A run of segments that lie along a circle, gathered up to be output as a single G2/G3.
+  class arc_accumulator final : public movement
+  {
+    // As described elsewhere, iif the vertices of the segments lie on the sphere, we need two segments to define an arc.
+    // If they do _not_ (and thus the vertices alternate between being in and out of the sphere), we need four.
+    static constexpr const bool intersecting_vertices = true;
+
+  public:
+    // The fewest segments that make an arc.
+    static constexpr const size_t min_segment_count = intersecting_vertices ? 4 : 2;
+
+  private:
+    struct chord final
+    {
+      const movement * __restrict segments[2] = { nullptr, nullptr };
+
+      vector3<> get_vector() const __restrict
+      {
+        return segments[1]->get_mean_position() - segments[0]->get_mean_position();
+      }
+
+      vector3<> get_mean_position() const __restrict
+      {
+        return mean(segments[0]->get_mean_position(), segments[1]->get_mean_position());
+      }
+
+      void clear() __restrict
+      {
+        segments[0] = nullptr;
+        segments[1] = nullptr;
+      }
+
+      operator bool() const __restrict
+      {
+        return segments[0] != nullptr && segments[1] != nullptr;
+      }
+
+      void insert(const movement * __restrict segment) __restrict
+      {
+        if (!segments[0])
+        {
+          segments[0] = segment;
+          return;
+        }
+        segments[1] = segment;
+      }
+
+      void shuffle() __restrict
+      {
+        segments[0] = segments[1];
+        segments[1] = nullptr;
+      }
+    };
+
+    struct direction final
+    {
+      enum class plane
+      {
+        xy = 0,
+        xz,
+        yz,
+      } plane_;
+      bool handedness_;
+
+      direction() = default;
+
+      direction(const chord & __restrict chord1, const chord & __restrict chord2)
+      {
+        // The chords turn about their normal, so the plane is whichever of XY, XZ and YZ is most square to it, and the
+        // handedness is which way along that plane's axis it points. Going by the normal rather than the chords
+        // themselves keeps a helix in XY however its direction lines up with the axes.
+        const vector3<> normal = chord1.get_vector().cross(chord2.get_vector());
+        const vector3<> normal_abs = normal.abs();
+
+        if (normal_abs.z >= normal_abs.x && normal_abs.z >= normal_abs.y)
+        {
+          // XY
+          plane_ = plane::xy;
+          handedness_ = (normal.z >= 0.0);
+        }
+        else if (normal_abs.y >= normal_abs.x)
+        {
+          // XZ
+          plane_ = plane::xz;
+          handedness_ = (normal.y >= 0.0);
+        }
+        else
+        {
+          // YZ
+          plane_ = plane::yz;
+          handedness_ = (normal.x >= 0.0);
+        }
+      }
+
+      bool operator == (const direction & __restrict dir) const __restrict
+      {
+        return plane_ == dir.plane_ && handedness_ == dir.handedness_;
+      }
+
+      bool operator != (const direction & __restrict dir) const __restrict
+      {
+        return plane_ != dir.plane_ || handedness_ != dir.handedness_;
+      }
+    };
+
+    std::vector<movement *> m_Segments;
+    real                   m_AccumAngle = 0.0;
+    real                   m_MeanAngle = 0.0;
+    real                   m_AngleSum = 0.0; // Sum of the angles between consecutive chords, for the mean.
+    size_t                 m_AngleCount = 0;
+    real                   m_Turn = 0.0; // How far the segments' directions have turned, in degrees.
+    real                   m_Rise = 0.0; // Z climbed,
+    real                   m_Run = 0.0; // over this much distance on X and Y.
+    direction              m_Direction;
+
+    // The fitted circle, set by fit. The sweep is in radians, positive counter-clockwise.
+    vector3<>              origin_;
+    real                   radius_ = 0.0;
+    real                   sweep_ = 0.0;
+    real                   extrude_ = 0.0;
+    // Also set by fit, so that a fitted arc no longer needs its segments.
+    bool                   travel_arc_ = false; // Fitted to travels, so it's accelerated as a travel.
+    vector3<>              start_direction_;
+    vector3<>              end_direction_;
+
+  public:
+    static constexpr const uint64 type = hash("arc_accumulator");
+
+  protected:
+  public:
+    arc_accumulator() : movement(type) {}
+    arc_accumulator(arc_accumulator && __restrict accum) :
+      movement(accum),
+      m_Segments(std::move(accum.m_Segments)),
+      m_AccumAngle(accum.m_AccumAngle),
+      m_Direction(accum.m_Direction),
+      m_MeanAngle(accum.m_MeanAngle),
+      m_AngleSum(accum.m_AngleSum),
+      m_AngleCount(accum.m_AngleCount),
+      m_Turn(accum.m_Turn),
+      m_Rise(accum.m_Rise),
+      m_Run(accum.m_Run),
+      origin_(accum.origin_),
+      radius_(accum.radius_),
+      sweep_(accum.sweep_),
+      extrude_(accum.extrude_),
+      travel_arc_(accum.travel_arc_),
+      start_direction_(accum.start_direction_),
+      end_direction_(accum.end_direction_)
+    {}
+    arc_accumulator(cache::deserializer & __restrict in) : movement(type, in),
+      origin_(in.read<vector3<>>()),
+      radius_(in.read<real>()),
+      sweep_(in.read<real>()),
+      extrude_(in.read<real>()),
+      travel_arc_(in.read<uint8>() != 0),
+      start_direction_(in.read<vector3<>>()),
+      end_direction_(in.read<vector3<>>())
+    {}
+
+    // The segments in the accumulator belong to the arena they were made in, like everything else.
+    virtual ~arc_accumulator() {}
+
+    arc_accumulator & operator = (arc_accumulator && __restrict accum) __restrict
+    {
+      movement::operator = (accum);
+      m_Segments = std::move(accum.m_Segments);
+      m_AccumAngle = accum.m_AccumAngle;
+      m_Direction = accum.m_Direction;
+      m_MeanAngle = accum.m_MeanAngle;
+      m_AngleSum = accum.m_AngleSum;
+      m_AngleCount = accum.m_AngleCount;
+      m_Turn = accum.m_Turn;
+      m_Rise = accum.m_Rise;
+      m_Run = accum.m_Run;
+      origin_ = accum.origin_;
+      radius_ = accum.radius_;
+      sweep_ = accum.sweep_;
+      extrude_ = accum.extrude_;
+      travel_arc_ = accum.travel_arc_;
+      start_direction_ = accum.start_direction_;
+      end_direction_ = accum.end_direction_;
+
+      return *this;
+    }
+
+    virtual std::string dump() const __restrict override final
+    {
+      std::string out;
+      out += "arc_accumulator";
+
+      out += movement::dump();
+
+      return out;
+    }
+
+    const auto & get_segments() const __restrict
+    {
+      return m_Segments;
+    }
+
+    size_t get_segment_count() const __restrict
+    {
+      return m_Segments.size();
+    }
+
+    void reset() __restrict
+    {
+      m_Segments.clear();
+      m_AccumAngle = 0.0;
+      m_MeanAngle = 0.0;
+      m_AngleSum = 0.0;
+      m_AngleCount = 0;
+      m_Turn = 0.0;
+      m_Rise = 0.0;
+      m_Run = 0.0;
+    }
+
+    bool conditional_reset() __restrict
+    {
+      if (m_Segments.size() < min_segment_count)
+      {
+        reset();
+        return true;
+      }
+      return false;
+    }
+
+    bool consume_segment(movement & __restrict seg, const config & __restrict cfg) __restrict
+    {
+      // TODO needs more validation, mainly about acceleration, jerk, extrude _rate_ (extrusion amount over distance)...
+
+      const bool result = [&]() {
+        // Working on presently:
+        // At four segments, we can calculate the direction and such. We want to avoid some calculations until then
+        // as two segments represents a chord, not one.
+
+        if (seg.get_vector().length() >= cfg.reg_arc_gen.max_segment_length)
+        {
+          return false;
+        }
+
+        if (!cfg.output.arcs_support_Z && seg.get_vector().z != 0.0)
+        {
+          return false;
+        }
+
+        if (m_Segments.size() == 0)
+        {
+          const vector3<> seg_vector = seg.get_vector();
+          m_Segments.push_back(&seg);
+          m_Rise = seg_vector.z;
+          m_Run = std::sqrt((seg_vector.x * seg_vector.x) + (seg_vector.y * seg_vector.y));
+          return true;
+        }
+
+        const segment * __restrict back_seg = m_Segments.back();
+        if (back_seg->get_type() != seg.get_type())
+        {
+          // Only accept the same type, ever.
+          return false;
+        }
+
+        vector3<> cur_vec = seg.get_vector().normalized();
+        real angle;
+        // If we have more than two points, we should calculate the test angle by chord rather than by segment. Two segments = one chord (segment.center -> segment.center).
+        if (m_Segments.size() >= 2)
+        {
+          const movement * __restrict chord_segments[2] = {
+            m_Segments[m_Segments.size() - 2],
+            m_Segments[m_Segments.size() - 1]
+          };
+          const vector3<> chord_points[2] = {
+            chord_segments[0]->get_mean_position(),
+            chord_segments[1]->get_mean_position()
+          };
+          const vector3<> back_vec = chord_points[0].vector_to(chord_points[1]);
+          angle = back_vec.angle_between(cur_vec);
+        }
+        else
+        {
+          const vector3<> back_vec = back_seg->get_vector().normalized();
+          angle = back_vec.angle_between(cur_vec);
+        }
+        if (angle >= cfg.reg_arc_gen.max_angle)
+        {
+          return false;
+        }
+
+        // We shoudl scale this based upon segment size. Tiny segments will have much larger angles.
+        if (m_Segments.size() >= min_segment_count)
+        {
+          // Is the angle within allowable limits?
+          const real angle_diff = abs(m_MeanAngle - angle);
+          if (angle_diff >= cfg.reg_arc_gen.max_angle_divergence)
+          {
+            return false;
+          }
+        }
+
+        // An arc can go around at most once, so stop short of sweeping all the way around. n segments only turn n - 1
+        // times, so their directions turn one step less than they sweep about the centre: add that step back, and leave
+        // half a step more so that rounding in the coordinates can't let the run past a full turn.
+        const real turn_cos = clamp(m_Segments.back()->get_direction().dot(seg.get_direction()), -1.0, 1.0);
+        const real turn = std::acos(turn_cos) * constants<real>::rad_to_angle;
+        const real step = (m_Turn + turn) / real(m_Segments.size());
+        if ((m_Turn + turn + (1.5 * step)) >= 360.0)
+        {
+          return false;
+        }
+
+        // A helix has to climb at a constant rate: this segment's rise can't stray from the rate so far by more than the
+        // arc may deviate. fit checks the arc as a whole.
+        const vector3<> seg_vector = seg.get_vector();
+        const real seg_run = std::sqrt((seg_vector.x * seg_vector.x) + (seg_vector.y * seg_vector.y));
+        if (m_Run > 0.0 && std::abs(seg_vector.z - (seg_run * (m_Rise / m_Run))) > cfg.reg_arc_gen.max_deviation)
+        {
+          return false;
+        }
+
+        if (m_Segments.size() >= min_segment_count)
+        {
+          // calculate the canonical direction value.
+          // TODO recalculate potentially using segment pairs. Cannot necessarily use one segment to determine this.
+          const chord chords[2] = {
+            { m_Segments[m_Segments.size() - (1 + 2)], m_Segments[m_Segments.size() - (1 + 1)] },
+            { m_Segments[m_Segments.size() - (1 + 0)], &seg }
+          };
+          const direction seg_direction = direction{ chords[0], chords[1] };
+
+          if (m_Segments.size() == min_segment_count)
+          {
+            m_Direction = direction{ chords[0], chords[1] };
+          }
+          else
+          {
+            if (m_Direction != seg_direction)
+            {
+              return false;
+            }
+          }
+        }
+
+        m_Segments.push_back(&seg);
+        m_Turn += turn;
+        m_Rise += seg_vector.z;
+        m_Run += seg_run;
+
+        // Chords are consecutive pairs of segments, so only an even segment count completes a new one, and only the angle
+        // it makes with the chord before it is new. The mean angle takes every such angle; the accumulated angle only
+        // every other one, as it doesn't blend the chords.
+        const size_t segment_count = m_Segments.size();
+        if (segment_count >= min_segment_count && (segment_count % 2) == 0)
+        {
+          const chord chords[2] = {
+            { m_Segments[segment_count - 4], m_Segments[segment_count - 3] },
+            { m_Segments[segment_count - 2], m_Segments[segment_count - 1] }
+          };
+          const vector3<> chord_vectors[2] = {
+            chords[0].get_vector().normalized(),
+            chords[1].get_vector().normalized()
+          };
+
+          const real cur_angle = chord_vectors[0].angle_between(chord_vectors[1]);
+
+          if ((segment_count % 4) == 0)
+          {
+            m_AccumAngle += cur_angle;
+          }
+
+          m_AngleSum += cur_angle;
+          ++m_AngleCount;
+          m_MeanAngle = m_AngleSum / real(m_AngleCount);
+        }
+
+        return true;
+      }();
+
+      if (result == false)
+      {
+        // flush the accumulator.
+        conditional_reset();
+      }
+
+      return result;
+    }
+
+    // Fits a circle to the vertices of the accumulated segments, on X and Y, and checks that it comes within
+    // cfg.reg_arc_gen.max_deviation of every vertex and of the middle of every segment, and that the segments all turn
+    // the same way around it. If it does, the accumulator takes on the segments' motion as an arc and true is returned;
+    // if not, the segments are best left alone, and why is put in rejection (if given).
+    bool fit(const config & __restrict cfg, stats::fit_rejection * __restrict rejection = nullptr) __restrict
+    {
+      if (m_Segments.size() < min_segment_count)
+      {
+        return false;
+      }
+
+      const auto reject = [rejection](stats::fit_rejection reason) -> bool
+      {
+        if (rejection)
+        {
+          *rejection = reason;
+        }
+        return false;
+      };
+
+      // Kasa's algebraic fit: the least-squares solution of u^2 + v^2 = a*u + b*v + c over the vertices, which only takes
+      // a few running sums. Coordinates are taken relative to the first vertex, so that the sums stay well conditioned
+      // however far the arc is from the machine's origin.
+      const vector3<> base = m_Segments.front()->get_start_position();
+
+      real n = 0.0;
+      real su = 0.0, sv = 0.0;
+      real suu = 0.0, svv = 0.0, suv = 0.0;
+      real sw = 0.0, suw = 0.0, svw = 0.0;
+      const auto add_vertex = [&](const vector3<> & __restrict vertex)
+      {
+        const real u = vertex.x - base.x;
+        const real v = vertex.y - base.y;
+        const real w = (u * u) + (v * v);
+        n += 1.0;
+        su += u;
+        sv += v;
+        suu += u * u;
+        svv += v * v;
+        suv += u * v;
+        sw += w;
+        suw += u * w;
+        svw += v * w;
+      };
+
+      add_vertex(base);
+      for (const movement * __restrict seg : m_Segments)
+      {
+        add_vertex(seg->get_end_position());
+      }
+
+      // The normal equations, solved by Cramer's rule.
+      const auto determinant = [](
+        real m00, real m01, real m02,
+        real m10, real m11, real m12,
+        real m20, real m21, real m22
+      ) -> real
+      {
+        return (m00 * ((m11 * m22) - (m12 * m21))) - (m01 * ((m10 * m22) - (m12 * m20))) + (m02 * ((m10 * m21) - (m11 * m20)));
+      };
+
+      const real det = determinant(
+        suu, suv, su,
+        suv, svv, sv,
+        su, sv, n
+      );
+      if (det == 0.0)
+      {
+        // The vertices are in a straight line.
+        return reject(stats::fit_rejection::straight);
+      }
+
+      const real a = determinant(
+        suw, suv, su,
+        svw, svv, sv,
+        sw, sv, n
+      ) / det;
+      const real b = determinant(
+        suu, suw, su,
+        suv, svw, sv,
+        su, sw, n
+      ) / det;
+      const real c = determinant(
+        suu, suv, suw,
+        suv, svv, svw,
+        su, sv, sw
+      ) / det;
+
+      const vector3<> origin = { base.x + (a * 0.5), base.y + (b * 0.5), base.z };
+      const real radius = std::sqrt(c + (a * a * 0.25) + (b * b * 0.25));
+      if (!(radius > 0.0 && radius <= cfg.reg_arc_gen.max_radius))
+      {
+        return reject(stats::fit_rejection::radius);
+      }
+
+      // Distance from the circle, on X and Y.
+      const auto deviation = [&](const vector3<> & __restrict point) -> real
+      {
+        const real x = point.x - origin.x;
+        const real y = point.y - origin.y;
+        return std::abs(std::sqrt((x * x) + (y * y)) - radius);
+      };
+
+      if (deviation(base) > cfg.reg_arc_gen.max_deviation)
+      {
+        return reject(stats::fit_rejection::deviation);
+      }
+
+      real sweep = 0.0;
+      for (const movement * __restrict seg : m_Segments)
+      {
+        const vector3<> & __restrict start = seg->get_start_position();
+        const vector3<> & __restrict end = seg->get_end_position();
+
+        // The middle of the segment is where a chord strays furthest from its arc.
+        if (deviation(end) > cfg.reg_arc_gen.max_deviation || deviation(mean(start, end)) > cfg.reg_arc_gen.max_deviation)
+        {
+          return reject(stats::fit_rejection::deviation);
+        }
+
+        const real start_x = start.x - origin.x;
+        const real start_y = start.y - origin.y;
+        const real end_x = end.x - origin.x;
+        const real end_y = end.y - origin.y;
+        const real angle = std::atan2((start_x * end_y) - (start_y * end_x), (start_x * end_x) + (start_y * end_y));
+        if (sweep != 0.0 && (angle < 0.0) != (sweep < 0.0))
+        {
+          // Doubles back.
+          return reject(stats::fit_rejection::doubles_back);
+        }
+        sweep += angle;
+      }
+
+      // G2/G3 can go around at most once.
+      if (std::abs(sweep) > (2.0 * constants<real>::pi) + constants<real>::epsilon)
+      {
+        return reject(stats::fit_rejection::sweep);
+      }
+
+      // On a helix, Z climbs in step with the angle around, and G2/G3 move it that way. Every vertex has to be close to
+      // where that puts it.
+      const real start_z = base.z;
+      const real rise = m_Segments.back()->get_end_position().z - start_z;
+      bool flat = true;
+      for (const movement * __restrict seg : m_Segments)
+      {
+        flat = flat && (seg->get_end_position().z == start_z);
+      }
+      if (!flat)
+      {
+        real angle = 0.0;
+        for (const movement * __restrict seg : m_Segments)
+        {
+          const vector3<> & __restrict start = seg->get_start_position();
+          const vector3<> & __restrict end = seg->get_end_position();
+          angle += std::atan2(
+            ((start.x - origin.x) * (end.y - origin.y)) - ((start.y - origin.y) * (end.x - origin.x)),
+            ((start.x - origin.x) * (end.x - origin.x)) + ((start.y - origin.y) * (end.y - origin.y))
+          );
+
+          const real z = start_z + (rise * (angle / sweep));
+          if (std::abs(end.z - z) > cfg.reg_arc_gen.max_deviation)
+          {
+            return reject(stats::fit_rejection::helix);
+          }
+        }
+      }
+
+      origin_ = origin;
+      radius_ = radius;
+      sweep_ = sweep;
+
+      // Take on the motion of the segments.
+      const movement * __restrict first = m_Segments.front();
+      start_position_ = first->get_start_position();
+      end_position_ = m_Segments.back()->get_end_position();
+      acceleration_ = first->acceleration_;
+      acceleration_hint_ = first->acceleration_hint_;
+      jerk_hint_ = first->jerk_hint_;
+      jerk_extrude_hint_ = first->jerk_extrude_hint_;
+      is_travel_ = first->is_travel_;
+      travel_arc_ = first->get_type() == travel::type;
+      start_direction_ = first->get_direction();
+      end_direction_ = m_Segments.back()->get_direction();
+
+      // The feedrate that takes as long over the arc as the segments took over themselves.
+      real length = 0.0;
+      real time = 0.0;
+      extrude_ = 0.0;
+      for (const movement * __restrict seg : m_Segments)
+      {
+        const real seg_length = seg->get_length();
+        length += seg_length;
+        if (seg->get_feedrate() > 0.0)
+        {
+          time += seg_length / seg->get_feedrate();
+        }
+        extrude_ += seg->get_extrusion();
+      }
+      feedrate_ = (time > 0.0) ? (length / time) : first->get_feedrate();
+
+      return true;
+    }
+
+    virtual real get_extrusion() const __restrict override final
+    {
+      return extrude_;
+    }
+
+    // Set by fit: radians about the centre, positive counter-clockwise.
+    real get_sweep() const __restrict
+    {
+      return sweep_;
+    }
+
+    virtual real get_length() const __restrict override final
+    {
+      // A helix is the hypotenuse of its arc and its rise.
+      const real arc_length = radius_ * std::abs(sweep_);
+      const real rise = end_position_.z - start_position_.z;
+      return std::sqrt((arc_length * arc_length) + (rise * rise));
+    }
+
+    virtual vector3<> get_start_direction() const __restrict override final
+    {
+      return start_direction_;
+    }
+
+    virtual vector3<> get_end_direction() const __restrict override final
+    {
+      return end_direction_;
+    }
+
+    virtual void serialize(cache::serializer & __restrict out) const __restrict override final
+    {
+      movement::serialize(out);
+      out.write(origin_);
+      out.write(radius_);
+      out.write(sweep_);
+      out.write(extrude_);
+      out.write(uint8(travel_arc_));
+      out.write(start_direction_);
+      out.write(end_direction_);
+    }
+
+    virtual void out_gcode(output::emitter & __restrict out, output::state & __restrict state, const config & __restrict cfg) const __restrict
+    {
+      // An arc of travels is accelerated as a travel.
+      const bool travel_arc = travel_arc_;
+      real & __restrict state_accel = travel_arc ? state.travel_accel : state.print_accel;
+      if (acceleration_hint_ != state_accel && acceleration_hint_ != 0)
+      {
+        state_accel = acceleration_hint_;
+
+        out += "M204";
+
+        out.word(travel_arc ? 'T' : 'P', acceleration_hint_, cfg.output.precision.hint);
+        out += "\n";
+      }
+
+      // An arc always moves on both X and Y, even when it ends where it started.
+      const bool moves_z = start_position_.z != end_position_.z;
+      bool emit_jerk_hint = false;
+      if (jerk_hint_.x != state.jerk.x && jerk_hint_.x != 0)
+      {
+        emit_jerk_hint = true;
+      }
+      if (jerk_hint_.y != state.jerk.y && jerk_hint_.y != 0)
+      {
+        emit_jerk_hint = true;
+      }
+      if (moves_z && jerk_hint_.z != state.jerk.z && jerk_hint_.z != 0)
+      {
+        emit_jerk_hint = true;
+      }
+
+      if (emit_jerk_hint)
+      {
+        out += "M205";
+        if (jerk_hint_.x != state.jerk.x && jerk_hint_.x != 0)
+        {
+          state.jerk.x = jerk_hint_.x;
+          out.word('X', jerk_hint_.x, cfg.output.precision.hint);
+        }
+        if (jerk_hint_.y != state.jerk.y && jerk_hint_.y != 0)
+        {
+          state.jerk.y = jerk_hint_.y;
+          out.word('Y', jerk_hint_.y, cfg.output.precision.hint);
+        }
+        if (moves_z && jerk_hint_.z != state.jerk.z && jerk_hint_.z != 0)
+        {
+          state.jerk.z = jerk_hint_.z;
+          out.word('Z', jerk_hint_.z, cfg.output.precision.hint);
+        }
+        out += "\n";
+      }
+
+      if (extrude_ != 0.0 && jerk_extrude_hint_ != state.extrude_jerk && jerk_extrude_hint_ != 0)
+      {
+        state.extrude_jerk = jerk_extrude_hint_;
+
+        out += "M205";
+        out.word('E', jerk_extrude_hint_, cfg.output.precision.hint);
+        out += "\n";
+      }
+
+      // Counter-clockwise is G3.
+      out += (sweep_ > 0.0) ? "G3" : "G2";
+
+      // The centre is given rather than the radius, as it's exact for any sweep, even a full circle.
+      state.prev_position.x = state.position.x;
+      state.position.x = end_position_.x;
+      out.word('X', state.position.x, cfg.output.precision.x);
+
+      state.prev_position.y = state.position.y;
+      state.position.y = end_position_.y;
+      out.word('Y', state.position.y, cfg.output.precision.y);
+
+      if (moves_z)
+      {
+        state.prev_position.z = state.position.z;
+        state.position.z = end_position_.z;
+        out.word('Z', state.position.z, cfg.output.precision.z);
+      }
+
+      out.word('I', origin_.x - start_position_.x, cfg.output.precision.x);
+      out.word('J', origin_.y - start_position_.y, cfg.output.precision.y);
+
+      if (extrude_ != 0.0)
+      {
+        out.word('E', extrude_, cfg.output.precision.e);
+      }
+
+      if (cfg.output.format == config::format::gcode)
+      {
+        if (feedrate_ != state.feedrate)
+        {
+          state.feedrate = feedrate_;
+
+          out.word('F', feedrate_, cfg.output.precision.f);
+        }
+      }
+      else
+      {
+        if (motion_data_.plateau_feedrate_ != state.feedrate)
+        {
+          state.feedrate = motion_data_.plateau_feedrate_;
+
+          out.word('F', motion_data_.plateau_feedrate_, cfg.output.precision.f);
+        }
+
+        if (motion_data_.exit_feedrate_ != state.feedrate)
+        {
+          out.word('A', motion_data_.exit_feedrate_, cfg.output.precision.f);
+        }
+      }
+
+      out += "\n";
+    }
+
+    virtual void out_gg(output::emitter & __restrict out, output::state & __restrict state, const config & __restrict cfg) const __restrict override final
+    {
+      // An arc of travels is accelerated as a travel.
+      const bool travel_arc = travel_arc_;
+      if (travel_arc)
+      {
+        output::gg::write_acceleration(out, state.travel_accel, output::gg::opcode::travel_acceleration, acceleration_hint_);
+      }
+      else
+      {
+        output::gg::write_acceleration(out, state.print_accel, output::gg::opcode::print_acceleration, acceleration_hint_);
+      }
+
+      output::gg::write_arc(
+        out, state,
+        start_position_, end_position_, origin_,
+        sweep_ < 0.0, // Positive is counter-clockwise.
+        extrude_,
+        motion_data_.entry_feedrate_, motion_data_.plateau_feedrate_, motion_data_.exit_feedrate_
+      );
+    }
+  };
+}
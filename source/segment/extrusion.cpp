@@ -1,2 +1,2 @@
-#include "gcgg.hpp"
-#include "extrusion.hpp"
+#include "gcgg.hpp"
+#include "extrusion.hpp"
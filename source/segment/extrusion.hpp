@@ -1,122 +1,138 @@
-#pragma once
-
-#include "movement.hpp"
-
-namespace gcgg::segments
-{
-  // Extrusion-only move with no XYZ movement
-  // It inherits from movement so it can use accel/jerk hints.
-  class extrusion final : public movement
-  {
-  public:
-    static constexpr const uint64 type = hash("extrusion");
-  protected:
-
-    real extrude_ = 0.0;
-    real feedrate_ = 0.0;
-
-  public:
-    extrusion() : movement(type)
-    {
-      delay_ = true;
-    }
-    virtual ~extrusion() {}
-
-    void set_extrude(real extrude) __restrict
-    {
-      extrude_ = extrude;
-    }
-
-    void set_feedrate(real feedrate) __restrict
-    {
-      feedrate_ = feedrate;
-    }
-
-    virtual std::string dump() const __restrict override final
-    {
-      std::string out;
-      out += "extrusion";
-      char buffer[512];
-      sprintf(buffer, "%f", extrude_);
-      out += " E";
-      out += trim_float(buffer);
-      sprintf(buffer, "%f", feedrate_);
-      out += " F";
-      out += trim_float(buffer);
-
-      return out;
-    }
-
-    virtual void out_gcode(std::string & __restrict out, output::state & __restrict state, const config & __restrict cfg) const __restrict
-    {
-      const bool run_M205 =
-        (acceleration_hint_ != state.retract_accel && acceleration_hint_ != 0) ||
-        (jerk_extrude_hint_ != state.extrude_jerk && jerk_extrude_hint_ != 0);
-
-      if (run_M205)
-      {
-        out += "M205";
-        char buffer[512];
-
-        if (acceleration_hint_ != state.retract_accel && acceleration_hint_ != 0)
-        {
-          state.retract_accel = acceleration_hint_;
-
-          sprintf(buffer, "%.8f", acceleration_hint_);
-          out += " R";
-          out += trim_float(buffer);
-        }
-
-        if (jerk_extrude_hint_ != state.extrude_jerk && jerk_extrude_hint_ != 0)
-        {
-          state.extrude_jerk = jerk_extrude_hint_;
-
-          char buffer[512];
-          sprintf(buffer, "%.8f", jerk_extrude_hint_);
-          out += " E";
-          out += trim_float(buffer);
-        }
-        out += "\n";
-      }
-
-      out += "G1";
-
-      char buffer[512];
-      sprintf(buffer, "%.8f", extrude_);
-      out += " E";
-      out += trim_float(buffer);
-
-      if (cfg.output.format == config::format::gcode)
-      {
-        if (feedrate_ != state.feedrate)
-        {
-          state.feedrate = feedrate_;
-
-          sprintf(buffer, "%.8f", feedrate_);
-          out += " F";
-          out += trim_float(buffer);
-        }
-      }
-      else
-      {
-        if (motion_data_.plateau_feedrate_ != state.feedrate)
-        {
-          state.feedrate = motion_data_.plateau_feedrate_;
-
-          sprintf(buffer, "%.8f", motion_data_.plateau_feedrate_);
-          out += " F";
-          out += trim_float(buffer);
-        }
-
-        if (motion_data_.exit_feedrate_ != state.feedrate)
-        {
-          sprintf(buffer, "%.8f", motion_data_.exit_feedrate_);
-          out += " A";
-          out += trim_float(buffer);
-        }
-      }
-
-      out += "\n";
-    }
-  };
-}
+#pragma once
+
+#include "movement.hpp"
+
+namespace gcgg::segments
+{
+  // Extrusion-only move with no XYZ movement
+  // It inherits from movement so it can use accel/jerk hints.
+  class extrusion final : public movement
+  {
+  public:
+    static constexpr const uint64 type = hash("extrusion");
+  protected:
+
+    real extrude_ = 0.0;
+    real feedrate_ = 0.0;
+
+  public:
+    extrusion() : movement(type)
+    {
+      delay_ = true;
+    }
+    extrusion(cache::deserializer & __restrict in) : movement(type, in),
+      extrude_(in.read<real>()),
+      feedrate_(in.read<real>())
+    {
+      delay_ = true;
+    }
+    virtual ~extrusion() {}
+
+    void set_extrude(real extrude) __restrict
+    {
+      extrude_ = extrude;
+    }
+
+    void set_feedrate(real feedrate) __restrict
+    {
+      feedrate_ = feedrate;
+    }
+
+    virtual real get_extrusion() const __restrict override final
+    {
+      return extrude_;
+    }
+
+    // The head doesn't move, so there's no trapezoid: it's just the filament at the extruder's feedrate.
+    virtual real get_time() const __restrict override final
+    {
+      return (feedrate_ > 0) ? (std::abs(extrude_) / (feedrate_ / 60.0)) : 0.0;
+    }
+
+    virtual void serialize(cache::serializer & __restrict out) const __restrict override final
+    {
+      movement::serialize(out);
+      out.write(extrude_);
+      out.write(feedrate_);
+    }
+
+    virtual std::string dump() const __restrict override final
+    {
+      std::string out;
+      out += "extrusion";
+      char buffer[512];
+      sprintf(buffer, "%f", extrude_);
+      out += " E";
+      out += trim_float(buffer);
+      sprintf(buffer, "%f", feedrate_);
+      out += " F";
+      out += trim_float(buffer);
+
+      return out;
+    }
+
+    virtual void out_gcode(output::emitter & __restrict out, output::state & __restrict state, const config & __restrict cfg) const __restrict
+    {
+      const bool run_M205 =
+        (acceleration_hint_ != state.retract_accel && acceleration_hint_ != 0) ||
+        (jerk_extrude_hint_ != state.extrude_jerk && jerk_extrude_hint_ != 0);
+
+      if (run_M205)
+      {
+        out += "M205";
+        if (acceleration_hint_ != state.retract_accel && acceleration_hint_ != 0)
+        {
+          state.retract_accel = acceleration_hint_;
+
+          out.word('R', acceleration_hint_, cfg.output.precision.hint);
+        }
+
+        if (jerk_extrude_hint_ != state.extrude_jerk && jerk_extrude_hint_ != 0)
+        {
+          state.extrude_jerk = jerk_extrude_hint_;
+
+          out.word('E', jerk_extrude_hint_, cfg.output.precision.hint);
+        }
+        out += "\n";
+      }
+
+      out += "G1";
+
+      out.word('E', extrude_, cfg.output.precision.e);
+
+      if (cfg.output.format == config::format::gcode)
+      {
+        if (feedrate_ != state.feedrate)
+        {
+          state.feedrate = feedrate_;
+
+          out.word('F', feedrate_, cfg.output.precision.f);
+        }
+      }
+      else
+      {
+        if (motion_data_.plateau_feedrate_ != state.feedrate)
+        {
+          state.feedrate = motion_data_.plateau_feedrate_;
+
+          out.word('F', motion_data_.plateau_feedrate_, cfg.output.precision.f);
+        }
+
+        if (motion_data_.exit_feedrate_ != state.feedrate)
+        {
+          out.word('A', motion_data_.exit_feedrate_, cfg.output.precision.f);
+        }
+      }
+
+      out += "\n";
+    }
+
+    virtual void out_gg(output::emitter & __restrict out, output::state & __restrict state, const config & __restrict cfg) const __restrict override final
+    {
+      output::gg::write_acceleration(out, state.retract_accel, output::gg::opcode::retract_acceleration, acceleration_hint_);
+
+      // The head stays where it is, and the extruder starts and ends at rest.
+      output::gg::write_move(out, state, state.position, state.position, extrude_, 0.0, feedrate_, 0.0);
+    }
+  };
+}
@@ -1,2 +1,2 @@
-#include "gcgg.hpp"
-#include "extrusion_move.hpp"
+#include "gcgg.hpp"
+#include "extrusion_move.hpp"
@@ -1,2 +1,2 @@
-#include "gcgg.hpp"
-#include "hop.hpp"
+#include "gcgg.hpp"
+#include "hop.hpp"
@@ -1,2 +1,2 @@
-#include "gcgg.hpp"
-#include "linear.hpp"
+#include "gcgg.hpp"
+#include "linear.hpp"
@@ -1,259 +1,205 @@
-#include "gcgg.hpp"
-#include "movement.hpp"
-
-void segments::movement::compute_motion(const config & __restrict cfg, bool require_jerk) __restrict
-{
-  motion::trapezoid::data trap_data;
-  trap_data.acceleration_ = acceleration_;
-  trap_data.end_position_ = end_position_;
-  trap_data.start_position_ = start_position_;
-  trap_data.jerk_ = jerk_hint_;
-  trap_data.speed_ = feedrate_;
-  trap_data.end_speed_ = (next_segment_) ? (next_segment_->get_velocity().length()) : 0;
-  trap_data.start_speed_ = (prev_segment_) ? prev_segment_->motion_data_.exit_feedrate_ : 0;
-  
-  trapezoid_ = new motion::trapezoid{ trap_data };
-
-  // Calculate feedrates and trapezoidal motion data.
-  const vector3<> in_velocity = (prev_segment_) ? (prev_segment_->get_vector().normalized(prev_segment_->motion_data_.exit_feedrate_)) : vector3<>::zero;
-  const vector3<> velocity = get_velocity();
-  const vector3<> direction = get_vector().normalized();
-  const vector3<> out_velocity = (next_segment_) ? (next_segment_->get_velocity()) : vector3<>::zero;
-  const vector3<> out_direction = (next_segment_) ? (next_segment_->get_vector().normalized()) : direction;
-
-  const vector3<> jerk = jerk_hint_;
-  const vector3<> acceleration = acceleration_;
-
-  real in_feedrate;
-  real out_feedrate;
-
-  // TODO do we need to detect and handle if _extrusion_ axis-inverts? I don't know if that really happens along segments, but
-  // I imagine it would cause problems otherwise.
-
-  // in velocity is not controlled by this segment, and is just the out velocity of the previous segment, adjusted for our vector.
-  if (prev_segment_)
-  {
-    // We need to compute a linear feedrate from the input velocity, relative to our direction.
-    // Because a velocity is independent of direction, we should just be able to get the vector length.
-    in_feedrate = in_velocity.length();
-  }
-  else
-  {
-    // TODO apply jerk only
-    in_feedrate = 0;
-  }
-
-  // Out velocity is more difficult. We need to calculate an out velocity that is scaled in terms of the next segment.
-  if (next_segment_)
-  {
-    // Jerk is used to make up for scaling differences since the dot product of the two segments is unlikely to be the same.
-    // We can check anyways, though.
-    if (direction.dot(out_direction) == 1.0)
-    {
-      // If they're the same direction, we can just use the out velocity, jerk-adjusted of course.
-      // TODO jerk adjust
-      out_feedrate = out_velocity.length();
-    }
-    else
-    {
-      const auto calculate_divisor = [](real from, real to) -> real
-      {
-        if (from && !to)
-        {
-          return 0.0;
-        }
-        if ((from > 0 && to < 0) || (from < 0 && to > 0))
-        {
-          return 0.0;
-        }
-        if (from && to)
-        {
-          return from / to;
-        }
-        return -1.0;
-      };
-
-      vector3<> divisors = {
-        calculate_divisor(velocity.x, out_velocity.x),
-        calculate_divisor(velocity.y, out_velocity.y),
-        calculate_divisor(velocity.z, out_velocity.z)
-      };
-
-      // Otherwise we need to scale by component.
-      if (
-        direction.is_inverted(out_direction) ||
-        (divisors.x == 0.0 && divisors.y == 0.0 && divisors.z == 0.0) ||
-        (divisors.x == -1.0 && divisors.y == -1.0 && divisors.z == -1.0)
-        )
-      {
-        // If there is a direction change on an axis, scaling will never work.
-        // Instead, we technically have to drop speed to zero, but we jerk adjust
-        // to try to limit the speed loss.
-        out_feedrate = 0.0;
-        // TODO jerk adjust
-      }
-      else
-      {
-        static constexpr const bool brute_force_integrate = true;
-
-        vector3<> new_velocity;
-        bool jerkable = false;
-
-        // Calculate divisors for each axis. Then we will divide by the mean.
-        // We need to handle elements that are zero, otherwise we will get ungood behavior.
-
-        // Ignore divisors which are zero.
-        real mean_div = 3.0;
-        if (divisors.x == -1.0)
-        {
-          divisors.x = 0.0;
-          mean_div -= 1.0;
-        }
-        if (divisors.y == -1.0)
-        {
-          divisors.y = 0.0;
-          mean_div -= 1.0;
-        }
-        if (divisors.z == -1.0)
-        {
-          divisors.z = 0.0;
-          mean_div -= 1.0;
-        }
-
-        const real mean_divisor = divisors.linear_sum() / mean_div;
-
-        enum class integrate_step
-        {
-          base = 0,
-          up,
-          down
-        };
-
-        integrate_step step = integrate_step::base;
-        vector3<> last_difference;
-        real divisor = mean_divisor;
-
-        do
-        {
-
-          // Divide all elements by the mean_divisor. This should get us a centroid velocity that can be jerked in either direction to accomodate
-          // the differences.
-
-          // If brute force integration is on, we will keep trying to change the divisor until we find something that works well.
-
-          real prev_divisor = divisor;
-          if (step == integrate_step::up)
-          {
-            divisor *= 1.001; // 1.0000001;
-          }
-          else if (step == integrate_step::down)
-          {
-            divisor *= 0.999; // 0.9999999;
-            if (is_equal(divisor, 0.0))
-            {
-              break;
-            }
-          }
-
-          vector3<> prev_new_velocity = new_velocity;
-          new_velocity = velocity / divisor;
-
-          const vector3<> difference = (new_velocity - out_velocity);
-          // Sanity check to make sure we can accomodate the difference with jerk.
-          // TODO try to handle this more gracefully.
-          bool was_jerkable = jerkable;
-          jerkable = (difference.abs().x <= jerk.x) && (difference.abs().y <= jerk.y) && (difference.abs().z <= jerk.z);
-          
-          bool jerk_valid = jerkable || !was_jerkable;
-
-          if (step == integrate_step::base)
-          {
-            step = integrate_step::up;
-          }
-          else if (step == integrate_step::up)
-          {
-            // Has the result improved?
-            if (!jerk_valid || last_difference.length() < difference.length())
-            {
-              // The previous result was better. Revert to it.
-              divisor = prev_divisor;
-              new_velocity = prev_new_velocity;
-              jerkable = was_jerkable;
-              step = integrate_step::down;
-              continue;
-            }
-          }
-          else if (step == integrate_step::down)
-          {
-            // Has the result improved?
-            if (!jerk_valid || last_difference.length() < difference.length())
-            {
-              // The previous result was better. Revert to it.
-              divisor = prev_divisor;
-              new_velocity = prev_new_velocity;
-              jerkable = was_jerkable;
-              break;
-            }
-          }
-
-          last_difference = difference;
-        } while (cfg.options.brute_force_feedrate && require_jerk);
-
-        if (jerkable)
-        {
-          out_feedrate = new_velocity.length();
-        }
-        else
-        {
-          out_feedrate = 0;
-          if (require_jerk)
-          {
-            //++failed_jerk_tests;
-          }
-        }
-      }
-    }
-  }
-  else
-  {
-    out_feedrate = 0.0;
-    // TODO apply jerk only
-  }
-
-  // Apply jerk to in/out.
-  const auto calculate_jerked_feedrate = [&direction](const vector3<> & __restrict jerk) -> real
-  {
-    vector3<> jerk_velocity = (direction / direction.max_element()) * jerk.max_element();
-    real divisor = 1.0;
-    if (jerk_velocity.x > jerk.x)
-    {
-      divisor = min(divisor, jerk_velocity.x / jerk.x);
-    }
-    if (jerk_velocity.y > jerk.y)
-    {
-      divisor = min(divisor, jerk_velocity.y / jerk.y);
-    }
-    if (jerk_velocity.z > jerk.z)
-    {
-      divisor = min(divisor, jerk_velocity.z / jerk.z);
-    }
-
-    jerk_velocity /= divisor;
-
-    return jerk_velocity.length();
-  };
-  if (in_feedrate == 0)
-  {
-    in_feedrate = calculate_jerked_feedrate(jerk);
-  }
-  if (out_feedrate == 0)
-  {
-    vector3<> half_jerk = jerk * 0.5;
-    out_feedrate = calculate_jerked_feedrate(half_jerk);
-  }
-
-  motion_data_.calculated_ = true;
-  motion_data_.entry_feedrate_ = in_feedrate;
-  motion_data_.plateau_feedrate_ = feedrate_;
-  motion_data_.exit_feedrate_ = out_feedrate;
-}
+#include "gcgg.hpp"
+#include "movement.hpp"
+#include "extrusion_move.hpp"
+#include "hop.hpp"
+#include "linear.hpp"
+#include "travel.hpp"
+
+#include <limits>
+
+namespace
+{
+  // What the leading byte of a serialized movement says about the rest of it.
+  namespace serial_flags
+  {
+    static constexpr const uint8 continues = 1 << 0; // Starts where the last movement ended, so the start isn't written.
+    static constexpr const uint8 same_feedrate = 1 << 1; // Has the last movement's feedrate.
+    static constexpr const uint8 travel = 1 << 2;
+    static constexpr const uint8 from_arc = 1 << 3;
+    static constexpr const uint8 planned = 1 << 4; // Has motion data.
+    static constexpr const uint8 same_entry = 1 << 5; // Enters at the speed the last movement left at.
+  }
+
+  // Feedrates are in mm/min; jerk (mm/s) and acceleration (mm/s^2) are per second.
+  static constexpr const real seconds_per_minute = 60.0;
+
+  // Junction deviation: the fastest speed at which the corner could be taken as an arc, tangent to both moves, that strays
+  // no more than deviation from the corner, at the given centripetal acceleration.
+  static real deviation_junction_speed(const vector3<> & __restrict from, const vector3<> & __restrict to, real acceleration, real deviation)
+  {
+    // A move that doesn't move the head (a retraction) has to be met at rest.
+    if (from == vector3<>::zero || to == vector3<>::zero)
+    {
+      return 0.0;
+    }
+
+    const real cos_theta = -from.dot(to);
+    if (cos_theta >= 1.0 - constants<real>::epsilon)
+    {
+      // Full reversal.
+      return 0.0;
+    }
+    if (cos_theta <= -1.0 + constants<real>::epsilon)
+    {
+      // Straight through.
+      return std::numeric_limits<real>::infinity();
+    }
+
+    const real sin_half_theta = std::sqrt(0.5 * (1.0 - cos_theta));
+    return std::sqrt(acceleration * deviation * sin_half_theta / (1.0 - sin_half_theta));
+  }
+}
+
+real segments::movement::get_linear_acceleration(const config & __restrict cfg) const __restrict
+{
+  // Curved moves go by where they set off, as their chord can be anything (even nothing, for a full circle).
+  const vector3<> direction = get_start_direction();
+
+  real acceleration = motion::trapezoid::linear_acceleration(direction, acceleration_);
+  // The M204 hint is a limit on the move as a whole, on top of the per-axis ones.
+  if (acceleration_hint_ > 0 && (acceleration <= 0 || acceleration_hint_ < acceleration))
+  {
+    acceleration = acceleration_hint_;
+  }
+  if (acceleration <= 0)
+  {
+    acceleration = motion::trapezoid::linear_acceleration(direction, cfg.defaults.acceleration);
+  }
+  return acceleration;
+}
+
+void segments::movement::compute_motion(const config & __restrict cfg) __restrict
+{
+  // Calculate the junction feedrate limits. These are only limits: motion::plan settles the actual speeds (and the
+  // trapezoid) across the whole chain afterwards.
+
+  // TODO do we need to detect and handle if _extrusion_ axis-inverts? I don't know if that really happens along segments, but
+  // I imagine it would cause problems otherwise.
+
+  // Every segment type is a movement.
+  const movement * __restrict prev_move = static_cast<const movement *>(prev_segment_);
+  const movement * __restrict next_move = static_cast<const movement *>(next_segment_);
+
+  const vector3<> start_direction = get_start_direction();
+  const vector3<> end_direction = get_end_direction();
+  // With no neighbour, the machine is at rest on that side.
+  const vector3<> in_direction = (prev_move) ? prev_move->get_end_direction() : vector3<>::zero;
+  const vector3<> out_direction = (next_move) ? next_move->get_start_direction() : vector3<>::zero;
+
+  vector3<> jerk = jerk_hint_;
+  if (jerk.x <= 0) { jerk.x = cfg.defaults.jerk.x; }
+  if (jerk.y <= 0) { jerk.y = cfg.defaults.jerk.y; }
+  if (jerk.z <= 0) { jerk.z = cfg.defaults.jerk.z; }
+
+  real in_speed = motion::trapezoid::jerk_junction_speed(in_direction, start_direction, jerk);
+  real out_speed = motion::trapezoid::jerk_junction_speed(end_direction, out_direction, jerk);
+
+  if (cfg.options.junction_deviation > 0)
+  {
+    // Junction deviation replaces jerk at corners between two moves; starting from and stopping to rest stay jerk-limited.
+    // Either move has to be able to take the corner, so use the lower of their accelerations.
+    const real acceleration = get_linear_acceleration(cfg);
+    if (prev_move)
+    {
+      const real prev_acceleration = prev_move->get_linear_acceleration(cfg);
+      in_speed = deviation_junction_speed(in_direction, start_direction, min(acceleration, prev_acceleration), cfg.options.junction_deviation);
+    }
+    if (next_move)
+    {
+      const real next_acceleration = next_move->get_linear_acceleration(cfg);
+      out_speed = deviation_junction_speed(end_direction, out_direction, min(acceleration, next_acceleration), cfg.options.junction_deviation);
+    }
+  }
+
+  // Neither side of a junction can be taken faster than the move itself.
+  const real in_feedrate = min(in_speed * seconds_per_minute, feedrate_, (prev_move) ? prev_move->get_feedrate() : feedrate_);
+  const real out_feedrate = min(out_speed * seconds_per_minute, feedrate_, (next_move) ? next_move->get_feedrate() : feedrate_);
+
+  motion_data_.calculated_ = true;
+  motion_data_.entry_feedrate_ = in_feedrate;
+  motion_data_.plateau_feedrate_ = feedrate_;
+  motion_data_.exit_feedrate_ = out_feedrate;
+}
+
+gcgg::segments::movement::movement(uint64 type, cache::deserializer & __restrict in) : segment(type)
+{
+  const uint8 flags = in.read<uint8>();
+
+  start_position_ = (flags & serial_flags::continues) ? in.position : in.read<vector3<>>();
+  end_position_ = in.read<vector3<>>();
+  feedrate_ = (flags & serial_flags::same_feedrate) ? in.feedrate : in.read<real>();
+
+  const cache::hints hints = in.read_hints();
+  acceleration_ = hints.acceleration;
+  acceleration_hint_ = hints.acceleration_hint;
+  jerk_hint_ = hints.jerk;
+  jerk_extrude_hint_ = hints.extrude_jerk;
+
+  is_travel_ = (flags & serial_flags::travel) != 0;
+  from_arc_ = (flags & serial_flags::from_arc) != 0;
+
+  if (flags & serial_flags::planned)
+  {
+    motion_data_.calculated_ = true;
+    motion_data_.entry_feedrate_ = (flags & serial_flags::same_entry) ? in.exit_feedrate : in.read<real>();
+    motion_data_.plateau_feedrate_ = in.read<real>();
+    motion_data_.exit_feedrate_ = in.read<real>();
+    in.exit_feedrate = motion_data_.exit_feedrate_;
+  }
+
+  in.position = end_position_;
+  in.feedrate = feedrate_;
+}
+
+void gcgg::segments::movement::serialize(cache::serializer & __restrict out) const __restrict
+{
+  const cache::hints hints = { acceleration_, acceleration_hint_, jerk_hint_, jerk_extrude_hint_ };
+
+  uint8 flags = 0;
+  flags |= (start_position_ == out.position) ? serial_flags::continues : 0;
+  flags |= (feedrate_ == out.feedrate) ? serial_flags::same_feedrate : 0;
+  flags |= is_travel_ ? serial_flags::travel : 0;
+  flags |= from_arc_ ? serial_flags::from_arc : 0;
+  flags |= motion_data_.calculated_ ? serial_flags::planned : 0;
+  flags |= (motion_data_.calculated_ && motion_data_.entry_feedrate_ == out.exit_feedrate) ? serial_flags::same_entry : 0;
+  out.write(flags);
+
+  if (!(flags & serial_flags::continues))
+  {
+    out.write(start_position_);
+  }
+  out.write(end_position_);
+  if (!(flags & serial_flags::same_feedrate))
+  {
+    out.write(feedrate_);
+  }
+
+  out.write_hints(hints);
+
+  if (flags & serial_flags::planned)
+  {
+    if (!(flags & serial_flags::same_entry))
+    {
+      out.write(motion_data_.entry_feedrate_);
+    }
+    out.write(motion_data_.plateau_feedrate_);
+    out.write(motion_data_.exit_feedrate_);
+    out.exit_feedrate = motion_data_.exit_feedrate_;
+  }
+
+  out.position = end_position_;
+  out.feedrate = feedrate_;
+}
+
+bool gcgg::segments::is_move(const gcgg::command & __restrict cmd)
+{
+  switch (cmd.get_type())
+  {
+  case extrusion_move::type:
+  case hop::type:
+  case linear::type:
+  case travel::type:
+    return true;
+  }
+  return false;
+}
@@ -1,98 +1,129 @@
-#pragma once
-
-#include "segment.hpp"
-#include "motion/trapezoid.hpp"
-
-namespace gcgg::segments
-{
-  // Segment that has movement on X, Y, or Z
-  class movement : public segment
-  {
-  protected:
-    vector3<> start_position_;
-    vector3<> end_position_;
-    real feedrate_ = 0.0;
-  public:
-    movement(uint64 type) : segment(type) {}
-    virtual ~movement() {
-      if (trapezoid_)
-      {
-        delete trapezoid_;
-      }
-    }
-
-    void set_positions(const vector3<> & __restrict start, const vector3<> & __restrict end) __restrict
-    {
-      start_position_ = start;
-      end_position_ = end;
-    }
-
-    void set_feedrate(real feedrate) __restrict
-    {
-      feedrate_ = feedrate;
-    }
-
-    virtual std::string dump() const __restrict override
-    {
-      char buffer[512];
-      std::string out;
-
-      if (start_position_.x != end_position_.x)
-      {
-        sprintf(buffer, "%f", end_position_.x);
-        out += " X";
-        out += buffer;
-      }
-
-      if (start_position_.y != end_position_.y)
-      {
-        sprintf(buffer, "%f", end_position_.y);
-        out += " Y";
-        out += buffer;
-      }
-
-      if (start_position_.z != end_position_.z)
-      {
-        sprintf(buffer, "%f", end_position_.z);
-        out += " Z";
-        out += buffer;
-      }
-
-      sprintf(buffer, "%f", feedrate_);
-      out += " F";
-      out += buffer;
-
-      return out;
-    }
-
-    real get_feedrate() const __restrict { return feedrate_; }
-    const vector3<> & __restrict get_start_position() const __restrict { return start_position_; }
-    const vector3<> & __restrict get_end_position() const __restrict { return end_position_; }
-    vector3<> get_mean_position() const __restrict { return mean(start_position_, end_position_); }
-    virtual vector3<> get_vector() const __restrict override final { return end_position_ - start_position_; }
-
-    void set_end_position(const vector3<> & __restrict position) __restrict
-    {
-      end_position_ = position;
-    }
-
-    void set_start_position(const vector3<> & __restrict position) __restrict
-    {
-      start_position_ = position;
-    }
-
-    virtual void compute_motion(const config & __restrict cfg, bool require_jerk) __restrict override;
-
-    virtual vector3<> get_velocity() const __restrict { return (end_position_ - start_position_).normalized(feedrate_); }
-
-  public:
-    // Lazy so making this public.
-    // These are printer hints that are being kept around.
-    vector3<> acceleration_;
-    real acceleration_hint_ = 0.0;
-    vector3<> jerk_hint_;
-    real jerk_extrude_hint_ = 0.0;
-    bool is_travel_ = false;
-    motion::trapezoid *trapezoid_ = nullptr;
-  };
-}
+#pragma once
+
+#include "segment.hpp"
+#include "motion/trapezoid.hpp"
+#include "output/gg/gg_out.hpp"
+
+namespace gcgg::segments
+{
+  // Segment that has movement on X, Y, or Z
+  class movement : public segment
+  {
+  protected:
+    vector3<> start_position_;
+    vector3<> end_position_;
+    real feedrate_ = 0.0;
+  public:
+    movement(uint64 type) : segment(type) {}
+    // Reads back what serialize wrote.
+    movement(uint64 type, cache::deserializer & __restrict in);
+    virtual ~movement() {}
+
+    void set_positions(const vector3<> & __restrict start, const vector3<> & __restrict end) __restrict
+    {
+      start_position_ = start;
+      end_position_ = end;
+    }
+
+    void set_feedrate(real feedrate) __restrict
+    {
+      feedrate_ = feedrate;
+    }
+
+    virtual std::string dump() const __restrict override
+    {
+      char buffer[512];
+      std::string out;
+
+      if (start_position_.x != end_position_.x)
+      {
+        sprintf(buffer, "%f", end_position_.x);
+        out += " X";
+        out += buffer;
+      }
+
+      if (start_position_.y != end_position_.y)
+      {
+        sprintf(buffer, "%f", end_position_.y);
+        out += " Y";
+        out += buffer;
+      }
+
+      if (start_position_.z != end_position_.z)
+      {
+        sprintf(buffer, "%f", end_position_.z);
+        out += " Z";
+        out += buffer;
+      }
+
+      sprintf(buffer, "%f", feedrate_);
+      out += " F";
+      out += buffer;
+
+      return out;
+    }
+
+    real get_feedrate() const __restrict { return feedrate_; }
+    const vector3<> & __restrict get_start_position() const __restrict { return start_position_; }
+    const vector3<> & __restrict get_end_position() const __restrict { return end_position_; }
+    vector3<> get_mean_position() const __restrict { return mean(start_position_, end_position_); }
+    virtual vector3<> get_vector() const __restrict override final { return end_position_ - start_position_; }
+
+    void set_end_position(const vector3<> & __restrict position) __restrict
+    {
+      end_position_ = position;
+    }
+
+    void set_start_position(const vector3<> & __restrict position) __restrict
+    {
+      start_position_ = position;
+    }
+
+    // Unit vector along the move, or zero if it doesn't move.
+    vector3<> get_direction() const __restrict
+    {
+      const vector3<> vector = end_position_ - start_position_;
+      const real length = vector.length();
+      return (length > 0) ? (vector / length) : vector3<>::zero;
+    }
+
+    // Directions the move sets off and arrives in, for junctions. The same as get_direction unless the move is curved.
+    virtual vector3<> get_start_direction() const __restrict { return get_direction(); }
+    virtual vector3<> get_end_direction() const __restrict { return get_direction(); }
+
+    // Length of the path the move takes.
+    virtual real get_length() const __restrict { return get_vector().length(); }
+
+    // Acceleration along the move (mm/s^2), within both the per-axis limits and the M204 hint.
+    real get_linear_acceleration(const config & __restrict cfg) const __restrict;
+
+    virtual void compute_motion(const config & __restrict cfg) __restrict override;
+
+    // Filament fed by the move (negative when retracting).
+    virtual real get_extrusion() const __restrict { return 0.0; }
+
+    // How long the move takes, in seconds. Only meaningful once motion has been planned.
+    virtual real get_time() const __restrict
+    {
+      return trapezoid_.ramp_time_[0] + trapezoid_.plateau_time_ + trapezoid_.ramp_time_[1];
+    }
+
+    virtual vector3<> get_velocity() const __restrict { return (end_position_ - start_position_).normalized(feedrate_); }
+
+    virtual void serialize(cache::serializer & __restrict out) const __restrict override;
+
+  public:
+    // Lazy so making this public.
+    // These are printer hints that are being kept around.
+    vector3<> acceleration_;
+    real acceleration_hint_ = 0.0;
+    vector3<> jerk_hint_;
+    real jerk_extrude_hint_ = 0.0;
+    bool is_travel_ = false;
+    motion::trapezoid trapezoid_;
+  };
+
+  // Whether cmd is a plain move: an extrusion move, hop, linear move or travel. These are what the passes work on, and
+  // anything else (an arc, an instruction) ends a run of them.
+  extern bool is_move(const gcgg::command & __restrict cmd);
+}
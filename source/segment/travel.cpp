@@ -1,2 +1,2 @@
-#include "gcgg.hpp"
-#include "travel.hpp"
+#include "gcgg.hpp"
+#include "travel.hpp"
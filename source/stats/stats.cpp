@@ -0,0 +1,145 @@
+#include "gcgg.hpp"
+#include "stats.hpp"
+
+#include <cstring>
+
+namespace
+{
+  static const char * const corner_rejection_names[uint(stats::corner_rejection::count)] = {
+    "shallow",
+    "short_segments",
+    "degenerate",
+  };
+
+  static const char * const fit_rejection_names[uint(stats::fit_rejection::count)] = {
+    "straight",
+    "radius",
+    "deviation",
+    "doubles_back",
+    "sweep",
+    "helix",
+  };
+
+  static real get_seconds(const stats::sample & __restrict start, const stats::sample & __restrict end)
+  {
+    return std::chrono::duration<real>(end.time - start.time).count();
+  }
+
+  static void write_reasons(FILE * __restrict file, const uint64 * __restrict counts, const char * const * __restrict names, uint count)
+  {
+    fprintf(file, "{");
+    for (uint i = 0; i < count; ++i)
+    {
+      fprintf(file, "%s\"%s\": %llu", (i == 0) ? " " : ", ", names[i], counts[i]);
+    }
+    fprintf(file, " }");
+  }
+}
+
+void gcgg::stats::counts::add(const counts & __restrict other) __restrict
+{
+  merged_segments += other.merged_segments;
+  simplified_extrusions += other.simplified_extrusions;
+  corner_arcs += other.corner_arcs;
+  for (uint i = 0; i < uint(corner_rejection::count); ++i)
+  {
+    corner_rejections[i] += other.corner_rejections[i];
+  }
+  fitted_arcs += other.fitted_arcs;
+  fitted_segments += other.fitted_segments;
+  for (uint i = 0; i < uint(fit_rejection::count); ++i)
+  {
+    fit_rejections[i] += other.fit_rejections[i];
+  }
+  subdivided_arcs += other.subdivided_arcs;
+  cached_layers += other.cached_layers;
+  reprocessed_layers += other.reprocessed_layers;
+}
+
+void gcgg::stats::report::add_stage(const char * __restrict name, const sample & __restrict start, const sample & __restrict end, usize commands_in, usize commands_out, usize bytes_in) __restrict
+{
+  stage_totals * __restrict totals = nullptr;
+  for (auto & __restrict stage : stages_)
+  {
+    if (std::strcmp(stage.name, name) == 0)
+    {
+      totals = &stage;
+      break;
+    }
+  }
+  if (!totals)
+  {
+    stages_.push_back({ name, 0, 0.0, 0.0, 0, 0, 0, 0, 0 });
+    totals = &stages_.back();
+  }
+
+  ++totals->runs;
+  totals->wall_time += get_seconds(start, end);
+  totals->cpu_time += end.cpu_time - start.cpu_time;
+  totals->allocations += end.allocations.count - start.allocations.count;
+  totals->allocated_bytes += end.allocations.bytes - start.allocations.bytes;
+  totals->commands_in += commands_in;
+  totals->commands_out += commands_out;
+  totals->bytes_in += bytes_in;
+}
+
+bool gcgg::stats::report::write(const std::string & __restrict filename) const __restrict
+{
+  const sample end = sample::now();
+
+  FILE * __restrict file = fopen(filename.c_str(), "w");
+  if (!file)
+  {
+    printf("Failed to write stats: %s\n", filename.c_str());
+    return false;
+  }
+
+  fprintf(file, "{\n");
+  fprintf(file, "  \"wall_time\": %.6f,\n", get_seconds(start_, end));
+  fprintf(file, "  \"cpu_time\": %.6f,\n", end.cpu_time - start_.cpu_time);
+  fprintf(file, "  \"allocations\": %llu,\n", end.allocations.count - start_.allocations.count);
+  fprintf(file, "  \"allocated_bytes\": %llu,\n", end.allocations.bytes - start_.allocations.bytes);
+  fprintf(file, "  \"peak_memory\": %llu,\n", uint64(platform::process::get_peak_memory()));
+
+  fprintf(file, "  \"stages\": [");
+  for (usize i = 0; i < stages_.size(); ++i)
+  {
+    const stage_totals & __restrict stage = stages_[i];
+    fprintf(file, "%s\n    {", (i == 0) ? "" : ",");
+    fprintf(file, " \"name\": \"%s\", \"runs\": %llu,", stage.name, stage.runs);
+    fprintf(file, " \"wall_time\": %.6f, \"cpu_time\": %.6f,", stage.wall_time, stage.cpu_time);
+    fprintf(file, " \"allocations\": %llu, \"allocated_bytes\": %llu,", stage.allocations, stage.allocated_bytes);
+    fprintf(file, " \"commands_in\": %llu, \"commands_out\": %llu", stage.commands_in, stage.commands_out);
+    if (stage.bytes_in != 0)
+    {
+      // Throughput over the input, in MiB/s.
+      const real mebibytes = real(stage.bytes_in) / (1024.0 * 1024.0);
+      fprintf(file, ", \"bytes_in\": %llu, \"mib_per_second\": %.2f", stage.bytes_in, (stage.wall_time > 0.0) ? (mebibytes / stage.wall_time) : 0.0);
+    }
+    fprintf(file, " }");
+  }
+  fprintf(file, "%s],\n", stages_.empty() ? "" : "\n  ");
+
+  fprintf(file, "  \"counts\": {\n");
+  fprintf(file, "    \"merged_segments\": %llu,\n", counts.merged_segments);
+  fprintf(file, "    \"simplified_extrusions\": %llu,\n", counts.simplified_extrusions);
+  fprintf(file, "    \"corner_arcs\": { \"generated\": %llu, \"rejected\": ", counts.corner_arcs);
+  write_reasons(file, counts.corner_rejections, corner_rejection_names, uint(corner_rejection::count));
+  fprintf(file, " },\n");
+  fprintf(file, "    \"fitted_arcs\": { \"generated\": %llu, \"segments\": %llu, \"rejected\": ", counts.fitted_arcs, counts.fitted_segments);
+  write_reasons(file, counts.fit_rejections, fit_rejection_names, uint(fit_rejection::count));
+  fprintf(file, " },\n");
+  fprintf(file, "    \"subdivided_arcs\": %llu,\n", counts.subdivided_arcs);
+  fprintf(file, "    \"layers\": { \"cached\": %llu, \"reprocessed\": %llu }\n", counts.cached_layers, counts.reprocessed_layers);
+  fprintf(file, "  }\n");
+  fprintf(file, "}\n");
+
+  const bool result = (ferror(file) == 0);
+  fclose(file);
+
+  if (result)
+  {
+    printf("Wrote stats to %s\n", filename.c_str());
+  }
+  return result;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "gcgg.hpp"
+#include "platform/process.hpp"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace gcgg::stats
+{
+  // Why a corner wasn't rounded with an arc.
+  enum class corner_rejection : uint
+  {
+    shallow = 0, // The corner is within arc.min_angle.
+    short_segments, // The segments either side are too short for an arc over arc.min_radius.
+    degenerate, // The arc would start where it ends.
+    count
+  };
+
+  // Why a run of segments that looked like an arc didn't fit one.
+  enum class fit_rejection : uint
+  {
+    straight = 0, // The vertices are in a straight line.
+    radius, // The circle is larger than reg_arc_gen.max_radius.
+    deviation, // A vertex or the middle of a segment strays too far from the circle.
+    doubles_back, // The segments don't all turn the same way around it.
+    sweep, // It goes around more than once.
+    helix, // Z doesn't climb in step with the angle around.
+    count
+  };
+
+  // What the passes did to a job. Passes that run over spans at once gather their counts on their own and add them here
+  // once they're done.
+  struct counts final
+  {
+    uint64 merged_segments = 0;
+    uint64 simplified_extrusions = 0;
+    uint64 corner_arcs = 0;
+    uint64 corner_rejections[uint(corner_rejection::count)] = {};
+    uint64 fitted_arcs = 0;
+    uint64 fitted_segments = 0; // Segments replaced by fitted arcs.
+    uint64 fit_rejections[uint(fit_rejection::count)] = {};
+    uint64 subdivided_arcs = 0;
+    uint64 cached_layers = 0;
+    uint64 reprocessed_layers = 0;
+
+    void add(const counts & __restrict other) __restrict;
+  };
+
+  // Where the process was at some point: the time, and what it had used.
+  struct sample final
+  {
+    std::chrono::steady_clock::time_point time;
+    real cpu_time;
+    platform::process::allocations allocations;
+
+    static sample now()
+    {
+      return { std::chrono::steady_clock::now(), platform::process::get_cpu_time(), platform::process::get_allocations() };
+    }
+  };
+
+  // Instrumentation for a job (see config.stats): the time taken and allocations made by each stage, and the commands (or,
+  // for parsing, the bytes) that went into and came out of it, along with counts of what the passes did. Stages that run more than once, as they do
+  // when streaming or when motion is planned between passes, are summed.
+  //
+  // CPU time and allocations are the whole process's, so a stage has to be timed from the thread that runs it, and not
+  // while anything else is running. Work that's spread over the thread pool (like the layers of cache.layers) is timed
+  // as one stage.
+  class report final
+  {
+    struct stage_totals final
+    {
+      const char * name;
+      uint64 runs;
+      real wall_time;
+      real cpu_time;
+      uint64 allocations;
+      uint64 allocated_bytes;
+      uint64 commands_in;
+      uint64 commands_out;
+      uint64 bytes_in;
+    };
+
+    sample start_ = sample::now();
+    std::vector<stage_totals> stages_;
+
+  public:
+    stats::counts counts;
+
+    void add_stage(const char * __restrict name, const sample & __restrict start, const sample & __restrict end, usize commands_in, usize commands_out, usize bytes_in) __restrict;
+
+    // Writes everything as JSON, along with the totals since the report was made and the process's peak memory.
+    // Returns false if the file couldn't be written.
+    bool write(const std::string & __restrict filename) const __restrict;
+  };
+
+  // Times a stage from construction until finish. Does nothing without a report, so that callers can pass one along
+  // only when it's wanted.
+  class stage final
+  {
+    report * __restrict report_;
+    const char * name_;
+    usize commands_in_;
+    usize bytes_in_;
+    sample start_;
+
+  public:
+    stage(report * __restrict report, const char * __restrict name, usize commands_in = 0, usize bytes_in = 0) :
+      report_(report),
+      name_(name),
+      commands_in_(commands_in),
+      bytes_in_(bytes_in)
+    {
+      if (report_)
+      {
+        start_ = sample::now();
+      }
+    }
+
+    stage(const stage &) = delete;
+    stage & operator = (const stage &) = delete;
+
+    void finish(usize commands_out = 0) __restrict
+    {
+      if (report_)
+      {
+        report_->add_stage(name_, start_, sample::now(), commands_in_, commands_out, bytes_in_);
+        report_ = nullptr;
+      }
+    }
+  };
+}
@@ -0,0 +1,137 @@
+#include "gcgg.hpp"
+#include "segment/arc_accumulator.hpp"
+#include "segment/extrusion_move.hpp"
+#include "tests/tests.hpp"
+
+#include <memory>
+
+// Runs circles that go around more than once through segments::arc_accumulator the way generate_arcs does, and checks
+// that every segment ends up in an arc, that no run is rejected, and that no arc sweeps more than a full turn (which
+// G2/G3 can't express).
+
+namespace
+{
+  struct loops final
+  {
+    const char * name;
+    uint count;
+    uint segments; // Per loop.
+    real rise; // Per loop, in mm. Zero for a flat circle gone around again and again.
+  };
+
+  // The moves of a circle of 30 mm radius, rounded to 4 decimals as a slicer would write them.
+  static std::vector<std::unique_ptr<segments::extrusion_move>> make_moves(const loops & __restrict shape)
+  {
+    static constexpr const real radius = 30.0;
+    const auto round = [](real value) -> real
+    {
+      return std::round(value * 10000.0) / 10000.0;
+    };
+
+    std::vector<std::unique_ptr<segments::extrusion_move>> moves;
+    vector3<> position = { 100.0 + radius, 100.0, 0.2 };
+    for (uint i = 1; i <= shape.count * shape.segments; ++i)
+    {
+      const real angle = 2.0 * constants<real>::pi * real(i) / real(shape.segments);
+      const vector3<> next = {
+        round(100.0 + (radius * std::cos(angle))),
+        round(100.0 + (radius * std::sin(angle))),
+        round(0.2 + (shape.rise * real(i) / real(shape.segments)))
+      };
+
+      auto move = std::make_unique<segments::extrusion_move>();
+      move->set_positions(position, next);
+      move->set_extrude(0.05 * (next - position).length());
+      move->set_feedrate(1800.0);
+      moves.push_back(std::move(move));
+      position = next;
+    }
+    return moves;
+  }
+
+  // Returns false if the case fails.
+  static bool check(const loops & __restrict shape, const config & __restrict cfg)
+  {
+    const auto moves = make_moves(shape);
+
+    std::vector<std::unique_ptr<segments::arc_accumulator>> arcs;
+    usize fitted = 0;
+    usize rejected = 0;
+    segments::arc_accumulator accumulator;
+
+    const auto flush_accumulator = [&]() -> bool
+    {
+      if (accumulator.conditional_reset())
+      {
+        return false;
+      }
+      if (accumulator.fit(cfg))
+      {
+        fitted += accumulator.get_segment_count();
+        arcs.push_back(std::make_unique<segments::arc_accumulator>(std::move(accumulator)));
+        accumulator.reset();
+        return true;
+      }
+      ++rejected;
+      accumulator.reset();
+      return false;
+    };
+
+    for (const auto & move : moves)
+    {
+      if (!accumulator.consume_segment(*move, cfg) && flush_accumulator() && !accumulator.consume_segment(*move, cfg))
+      {
+        flush_accumulator();
+      }
+    }
+    flush_accumulator();
+
+    real max_sweep = 0.0;
+    for (const auto & arc : arcs)
+    {
+      max_sweep = max(max_sweep, std::abs(arc->get_sweep()));
+    }
+
+    // A few segments may be left over at the end, too few to make an arc of their own.
+    const bool passed =
+      rejected == 0 &&
+      fitted + segments::arc_accumulator::min_segment_count > moves.size() &&
+      max_sweep <= 2.0 * constants<real>::pi;
+
+    printf(
+      "%s %s: %llu moves, %llu arcs covering %llu of them, %llu rejected, widest sweep %.3f degrees\n",
+      passed ? "ok" : "FAIL",
+      shape.name,
+      uint64(moves.size()),
+      uint64(arcs.size()),
+      uint64(fitted),
+      uint64(rejected),
+      max_sweep * constants<real>::rad_to_angle
+    );
+    return passed;
+  }
+}
+
+bool gcgg::tests::arc_fitting()
+{
+  config cfg;
+  cfg.output.arcs_support_Z = true;
+
+  static const loops cases[] = {
+    { "spiral vase, 10 loops of 120", 10, 120, 0.2 },
+    { "spiral vase, 10 loops of 600", 10, 600, 0.2 },
+    { "flat circle, 3 loops of 120", 3, 120, 0.0 },
+    { "flat circle, 2 loops of 1000", 2, 1000, 0.0 },
+  };
+
+  uint failures = 0;
+  for (const loops & shape : cases)
+  {
+    if (!check(shape, cfg))
+    {
+      ++failures;
+    }
+  }
+
+  return failures == 0;
+}
@@ -0,0 +1,82 @@
+#include "gcgg.hpp"
+#include "segment/arc.hpp"
+#include "tests/tests.hpp"
+
+// Subdivides corner arcs between an extrusion and a travel, into odd and even counts of segments, and checks that they
+// feed exactly the filament that the extruding side gives the arc: the rate of its move over its half of the arc.
+
+namespace
+{
+  // Returns false if the case fails.
+  static bool check(usize count, bool extrude_first, const config & __restrict cfg)
+  {
+    static constexpr const real radius = 0.4;
+    static constexpr const real extrude_rate = 0.05; // mm of filament per mm moved.
+
+    // Along X into a corner at (100, 100), and out of it along Y.
+    const vector3<> corner = { 100.0, 100.0, 0.2 };
+    const vector3<> start = corner - vector3<>{ radius, 0.0, 0.0 };
+    const vector3<> end = corner + vector3<>{ 0.0, radius, 0.0 };
+
+    const real extrude[2] = { extrude_first ? (extrude_rate * radius) : 0.0, extrude_first ? 0.0 : (extrude_rate * radius) };
+    const real feedrate[2] = { 30.0, 30.0 };
+    const real acceleration[2] = { 1000.0, 1000.0 };
+    const vector3<> jerk[2] = { { 10.0, 10.0, 0.4 }, { 10.0, 10.0, 0.4 } };
+    const real extrude_jerk[2] = { 5.0, 5.0 };
+    const segments::arc corner_arc = { extrude, feedrate, acceleration, jerk, extrude_jerk, corner, start, end, radius, 90.0 };
+
+    config arc_cfg = cfg;
+    arc_cfg.arc.max_segments = count;
+
+    platform::arena arena;
+    std::vector<vector3<>> points;
+    std::vector<gcgg::command *> out;
+    corner_arc.generate_segments(arc_cfg, arena, points, out);
+
+    real length = 0.0;
+    real extrusion = 0.0;
+    for (const gcgg::command * cmd : out)
+    {
+      const auto * __restrict seg = static_cast<const segments::movement *>(cmd);
+      length += seg->get_start_position().distance(seg->get_end_position());
+      if (cmd->get_type() == segments::extrusion_move::type)
+      {
+        extrusion += static_cast<const segments::extrusion_move *>(cmd)->get_extrusion();
+      }
+    }
+
+    const real expected = extrude_rate * (length * 0.5);
+    const bool passed = out.size() == count && std::abs(extrusion - expected) <= (expected * 1.0e-9);
+
+    printf(
+      "%s %s, %llu segments: fed %.9f mm, expected %.9f mm\n",
+      passed ? "ok" : "FAIL",
+      extrude_first ? "extrusion to travel" : "travel to extrusion",
+      uint64(out.size()),
+      extrusion,
+      expected
+    );
+    return passed;
+  }
+}
+
+bool gcgg::tests::corner_arc()
+{
+  config cfg;
+  // Finer than any count checked, so that max_segments sets the count.
+  cfg.arc.max_chord_error = 1.0e-9;
+
+  uint failures = 0;
+  for (usize count = 1; count <= 8; ++count)
+  {
+    for (const bool extrude_first : { true, false })
+    {
+      if (!check(count, extrude_first, cfg))
+      {
+        ++failures;
+      }
+    }
+  }
+
+  return failures == 0;
+}
@@ -0,0 +1,30 @@
+#include "gcgg.hpp"
+#include "tests/tests.hpp"
+
+int main()
+{
+  struct test final
+  {
+    const char * name;
+    bool (*run)();
+  };
+  static const test all_tests[] = {
+    { "junction_speed", tests::junction_speed },
+    { "arc_fitting", tests::arc_fitting },
+    { "corner_arc", tests::corner_arc },
+  };
+
+  uint failures = 0;
+  for (const test & t : all_tests)
+  {
+    printf("%s:\n", t.name);
+    if (!t.run())
+    {
+      printf("%s FAILED\n", t.name);
+      ++failures;
+    }
+  }
+
+  printf("%u of %u tests failed\n", failures, uint(std::size(all_tests)));
+  return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+namespace gcgg::tests
+{
+  // Each test prints what it checked, and returns false if anything failed. main runs them all.
+
+  // motion::trapezoid::jerk_junction_speed against the divisor search it replaced.
+  extern bool junction_speed();
+
+  // arc_accumulator on circles that go around more than once.
+  extern bool arc_fitting();
+
+  // segments::arc::generate_segments, on corners between an extrusion and a travel.
+  extern bool corner_arc();
+}